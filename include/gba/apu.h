@@ -126,6 +126,7 @@ struct apu {
 };
 
 /* gba/apu/apu.c */
+void apu_rbuffer_push(struct apu_rbuffer *rbuffer, int16_t val_l, int16_t val_r);
 uint32_t apu_rbuffer_pop(struct apu_rbuffer *rbuffer);
 void apu_resample(struct gba *gba, struct event_args args);
 
@@ -0,0 +1,122 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Recording of the published frames and of the audio samples to disk.
+**
+** Each published frame, along with the samples produced since the previous one, is copied into
+** one of a few blocks allocated when the capture starts. A background thread converts the blocks
+** and writes them with a few large `writev()` calls, so the emulator never waits for the disk
+** unless `CAPTURE_POLICY_WAIT` is used.
+**
+** With `CAPTURE_POLICY_DROP`, frames and samples published while all the blocks are in flight
+** are dropped and counted. The writer then fills the holes with the last frame and with silence,
+** so that the video and the audio stay in sync.
+*/
+
+#define CAPTURE_MAGIC           "HSCV"
+#define CAPTURE_VERSION         1u
+
+// Default number of blocks, if `launch_config.capture.blocks` is 0.
+#define CAPTURE_DEFAULT_BLOCKS  8
+
+struct gba;
+struct launch_config;
+
+enum capture_video_format {
+    // `struct capture_video_header` followed by a `struct capture_video_record` per frame, each
+    // followed by its pixels in the framebuffer's format unless the frame is the same as the previous one.
+    CAPTURE_VIDEO_RGB555,
+
+    // YUV4MPEG2 with 4:4:4 chroma, readable by most encoders.
+    CAPTURE_VIDEO_Y4M,
+};
+
+enum capture_policy {
+    CAPTURE_POLICY_DROP,        // Drop what can't be buffered, never stall the emulation.
+    CAPTURE_POLICY_WAIT,        // Wait for the writer, for lossless recordings.
+};
+
+/*
+** The RGB555 stream, in the host's byte order.
+*/
+struct capture_video_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps_num;               // The frame rate is `fps_num / fps_den`.
+    uint32_t fps_den;
+};
+
+struct capture_video_record {
+    uint32_t frame;                 // Number of frames published since the capture started. Dropped frames leave holes.
+    uint32_t size;                  // Size of the pixels following the record, 0 if the previous frame is repeated.
+};
+
+struct capture_block {
+    bool has_frame;                 // Unset if the block was sent because `samples` was full.
+    bool changed;                   // Set if `pixels` differs from the previous frame.
+    uint32_t frame;
+
+    // What was dropped right before this block.
+    uint32_t dropped_frames;
+    uint64_t dropped_samples;
+
+    uint16_t *pixels;
+    int16_t (*samples)[2];
+    size_t samples_len;
+};
+
+struct capture {
+    bool enabled;
+
+    enum capture_video_format video_format;
+    enum capture_policy policy;
+    int video_fd;                   // Owned by the frontend. -1 if not recorded.
+    int audio_fd;                   // Owned by the frontend. -1 if not recorded.
+    uint32_t audio_rate;            // In Hz.
+
+    // Only accessed by the emulator's thread.
+    struct capture_block *current;  // The block being filled, NULL if none is free.
+    uint32_t frame;
+    uint32_t dropped_frames;
+    uint64_t dropped_samples;
+    bool frame_dropped;             // Set if the last frame was dropped, so the next one is sent whole.
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // A ring of blocks. `len` of them, starting at `head`, are waiting for the writer. Under `lock`.
+    struct capture_block *blocks;
+    size_t blocks_len;
+    size_t samples_size;            // Capacity of `capture_block.samples`.
+    size_t head;
+    size_t len;
+    bool exit;
+};
+
+/* source/gba/capture.c */
+void capture_start(struct gba *gba, struct launch_config const *config);
+void capture_stop(struct gba *gba);
+void capture_frame(struct gba *gba, bool changed);
+void capture_audio(struct gba *gba, int16_t left, int16_t right);
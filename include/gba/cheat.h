@@ -0,0 +1,97 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Cheat codes.
+**
+** `cheat_set()` compiles the codes into a flat list of operations, run by the emulator at the
+** start of each VBlank. ROM patches are applied once, to private copies of the patched pages
+** of the ROM (see `cheat_frame()`), and reverted when the list changes.
+*/
+
+struct gba;
+
+enum cheat_formats {
+    CHEAT_GAMESHARK = 0,            // GameShark / Action Replay v1 and v2, decrypted ("XXXXXXXX YYYYYYYY").
+    CHEAT_CODEBREAKER,              // CodeBreaker, unencrypted ("XXXXXXXX YYYY").
+};
+
+struct cheat {
+    enum cheat_formats format;
+
+    // One or more lines of the code, separated by any whitespace.
+    char const *code;
+};
+
+enum cheat_op_kinds {
+    CHEAT_OP_WRITE8 = 0,
+    CHEAT_OP_WRITE16,
+    CHEAT_OP_WRITE32,
+    CHEAT_OP_OR16,
+    CHEAT_OP_AND16,
+    CHEAT_OP_ADD16,
+    CHEAT_OP_IF_EQ16,               // Skip the next operation unless equal.
+    CHEAT_OP_IF_NE16,               // Skip the next operation unless not equal.
+};
+
+struct cheat_op {
+    enum cheat_op_kinds kind;
+    uint32_t addr;
+    int32_t offset;                 // Offset of `addr` in `struct memory`, or -1 to go through `mem_*_raw()`.
+    uint32_t value;
+};
+
+struct cheat_rom_patch {
+    uint32_t offset;                // Offset in the ROM.
+    uint16_t value;
+    uint16_t original;
+};
+
+struct cheat_list {
+    struct cheat_op *ops;
+    size_t ops_len;
+    struct cheat_rom_patch *patches;
+    size_t patches_len;
+};
+
+struct cheat_engine {
+    pthread_mutex_t lock;
+
+    // Set while there are cheats to run or a new list to pick up, so the emulator doesn't
+    // take the lock otherwise.
+    atomic_bool enabled;
+
+    // Set by `cheat_set()` when `pending` replaces `active`. `pending` is under `lock`.
+    atomic_bool changed;
+    struct cheat_list pending;
+
+    // The list run by the emulator.
+    struct cheat_list active;
+    bool patched;                   // The ROM patches of `active` are applied.
+};
+
+/* source/gba/cheat.c */
+bool cheat_set(struct gba *gba, struct cheat const *cheats, size_t len);
+void cheat_init(struct gba *gba);
+void cheat_release(struct gba *gba);
+void cheat_reset(struct gba *gba);
+void cheat_frame(struct gba *gba);
@@ -214,6 +214,7 @@ static char const * const arm_modes_name[] = {
 
 /* gba/core/core.c */
 void core_run(struct gba *gba);
+void core_select_variant(struct gba *gba);
 void core_next(struct gba *gba);
 void core_idle(struct gba *gba);
 void core_idle_for(struct gba *gba, uint32_t cycles);
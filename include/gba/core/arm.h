@@ -19,19 +19,9 @@
 
 struct gba;
 
-struct hs_arm_insn {
-    char const *name;
-    char const *mask;
-    void (*op)(struct gba *gba, uint32_t op);
-};
-
-struct hs_arm_decoded_insn {
-    uint32_t mask;
-    uint32_t value;
-};
-
-extern void (*arm_lut[4096])(struct gba *gba, uint32_t op);
-extern bool cond_lut[256];
+/* Generated at build time by tools/gen_luts.c */
+extern void (* const arm_lut[4096])(struct gba *gba, uint32_t op);
+extern bool const cond_lut[256];
 
 /* core/arm/alu.c */
 void core_arm_alu(struct gba *gba, uint32_t op);
@@ -43,9 +33,6 @@ void core_arm_bdt(struct gba *gba, uint32_t op);
 void core_arm_branch(struct gba *gba, uint32_t op);
 void core_arm_branch_xchg(struct gba *gba, uint32_t op);
 
-/* core/arm/core.c */
-void core_arm_decode_insns(void);
-
 /* core/arm/mul.c */
 void core_arm_mul(struct gba *gba, uint32_t op);
 void core_arm_mull(struct gba *gba, uint32_t op);
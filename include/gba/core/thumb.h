@@ -19,18 +19,8 @@
 
 struct gba;
 
-struct hs_thumb_insn {
-    char const *name;
-    char const *mask;
-    void (*op)(struct gba *gba, uint16_t op);
-};
-
-struct hs_thumb_decoded_insn {
-    uint16_t mask;
-    uint16_t value;
-};
-
-extern void (*thumb_lut[256])(struct gba *gba, uint16_t op);
+/* Generated at build time by tools/gen_luts.c */
+extern void (* const thumb_lut[256])(struct gba *gba, uint16_t op);
 
 /* gba/thumb/alu.c */
 void core_thumb_lo_add(struct gba *gba, uint16_t op);
@@ -53,9 +43,6 @@ void core_thumb_branch_link(struct gba *gba, uint16_t op);
 void core_thumb_branch_xchg(struct gba *gba, uint16_t op);
 void core_thumb_branch_cond(struct gba *gba, uint16_t op);
 
-/* gba/thumb/gba.c */
-void core_thumb_decode_insns(void);
-
 /* gba/thumb/logical.c */
 void core_thumb_lsl(struct gba *gba, uint16_t op);
 void core_thumb_lsr(struct gba *gba, uint16_t op);
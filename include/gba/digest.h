@@ -0,0 +1,124 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+/*
+** This header only depends on the standard library so that `tools/digest_diff.c`
+** can read the digest logs without linking against the emulator.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DIGEST_MAGIC            "HSDG"
+#define DIGEST_VERSION          2u
+
+// Granularity of the dirty tracking of the large memory regions.
+#define DIGEST_PAGE_SHIFT       12
+#define DIGEST_PAGE_SIZE        (1u << DIGEST_PAGE_SHIFT)
+
+#define DIGEST_EWRAM_PAGES      ((256u * 1024u) >> DIGEST_PAGE_SHIFT)
+#define DIGEST_IWRAM_PAGES      ((32u * 1024u) >> DIGEST_PAGE_SHIFT)
+#define DIGEST_VRAM_PAGES       ((96u * 1024u) >> DIGEST_PAGE_SHIFT)
+
+// Number of records buffered before they are written to the log.
+#define DIGEST_BUFFER_LEN       64
+
+struct gba;
+struct launch_config;
+
+/*
+** The components of the emulator covered by the digest, in the order their hash
+** appears in a record.
+**
+** New components must be appended at the end and `DIGEST_VERSION` bumped.
+*/
+enum digest_components {
+    DIGEST_CORE = 0,
+    DIGEST_IO,
+    DIGEST_SCHEDULER,
+    DIGEST_EWRAM,
+    DIGEST_IWRAM,
+    DIGEST_VRAM,
+    DIGEST_PALRAM,
+    DIGEST_OAM,
+    DIGEST_BACKUP_STORAGE,
+    DIGEST_FRAMEBUFFER,
+
+    DIGEST_COMPONENT_LEN,
+};
+
+static char const * const digest_component_names[DIGEST_COMPONENT_LEN] = {
+    [DIGEST_CORE] = "core",
+    [DIGEST_IO] = "io",
+    [DIGEST_SCHEDULER] = "scheduler",
+    [DIGEST_EWRAM] = "ewram",
+    [DIGEST_IWRAM] = "iwram",
+    [DIGEST_VRAM] = "vram",
+    [DIGEST_PALRAM] = "palram",
+    [DIGEST_OAM] = "oam",
+    [DIGEST_BACKUP_STORAGE] = "backup storage",
+    [DIGEST_FRAMEBUFFER] = "framebuffer",
+};
+
+/*
+** A digest log is a `struct digest_log_header` followed by one `struct digest_record`
+** per frame, in the host's byte order.
+*/
+struct digest_log_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t components;            // Number of hashes in each record
+    uint32_t record_size;           // Size of a record, in bytes
+};
+
+struct digest_record {
+    uint32_t frame;                 // Number of frames since the last reset
+    uint32_t reserved;
+    uint64_t cycles;                // Value of the scheduler's cycle counter
+    uint64_t hashes[DIGEST_COMPONENT_LEN];
+};
+
+struct digest {
+    bool enabled;
+    int fd;                         // Where the log is written. Owned by the frontend.
+
+    uint32_t frame;
+
+    // Pages written to since their hash was last computed.
+    // Set unconditionally by `template_write()` so the fast path stays branchless.
+    struct {
+        bool ewram[DIGEST_EWRAM_PAGES];
+        bool iwram[DIGEST_IWRAM_PAGES];
+        bool vram[DIGEST_VRAM_PAGES];
+    } dirty;
+
+    // Cached hashes of each page.
+    struct {
+        uint64_t ewram[DIGEST_EWRAM_PAGES];
+        uint64_t iwram[DIGEST_IWRAM_PAGES];
+        uint64_t vram[DIGEST_VRAM_PAGES];
+    } pages;
+
+    struct digest_record buffer[DIGEST_BUFFER_LEN];
+    size_t buffer_len;
+};
+
+/* source/gba/digest.c */
+void digest_reset(struct gba *gba, struct launch_config const *config);
+void digest_invalidate(struct gba *gba);
+void digest_frame(struct gba *gba);
+void digest_flush(struct gba *gba);
@@ -30,6 +30,7 @@ enum message_kind {
     MESSAGE_QUICKSAVE,
     MESSAGE_QUICKLOAD,
     MESSAGE_SETTINGS,
+    MESSAGE_INPUT,
 
 #ifdef WITH_DEBUGGER
     MESSAGE_FRAME,
@@ -65,6 +66,16 @@ struct message_key {
     bool pressed;
 };
 
+/*
+** The keys pressed during the given frame (see `gba_shared_rollback_frame()`), as a bitfield
+** of `enum keys`. Applied right away unless rollback is enabled.
+*/
+struct message_input {
+    struct event_header header;
+    uint64_t frame;
+    uint32_t keys;
+};
+
 struct message_quickload {
     struct event_header header;
     uint8_t *data;
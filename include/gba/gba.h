@@ -18,6 +18,8 @@
 #define GBA_SCREEN_HEIGHT               160
 #define GBA_SCREEN_REAL_WIDTH           308
 #define GBA_SCREEN_REAL_HEIGHT          228
+#define GBA_SCREEN_TILE_WIDTH           8
+#define GBA_SCREEN_TILES                (GBA_SCREEN_WIDTH / GBA_SCREEN_TILE_WIDTH)
 #define GBA_CYCLES_PER_PIXEL            4
 #define GBA_CYCLES_PER_FRAME            (CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH * GBA_SCREEN_REAL_HEIGHT)
 #define GBA_CYCLES_PER_SECOND           ((uint64_t)(16 * 1024 * 1024))
@@ -32,6 +34,16 @@
 #include "gba/io.h"
 #include "gba/gpio.h"
 #include "gba/debugger.h"
+#include "gba/digest.h"
+#include "gba/isa.h"
+#include "gba/runahead.h"
+#include "gba/rollback.h"
+#include "gba/snapshot.h"
+#include "gba/watch.h"
+#include "gba/search.h"
+#include "gba/cheat.h"
+#include "gba/capture.h"
+#include "gba/link.h"
 
 enum gba_states {
     GBA_STATE_STOP = 0,
@@ -55,6 +67,18 @@ enum keys {
     KEY_MIN = KEY_A,
 };
 
+/*
+** Reasons for the event file descriptor (see `gba_shared_event_fd()`) to
+** become readable. They are ORed together until the frontend drains them.
+*/
+enum gba_events {
+    GBA_EVENT_NOTIFICATION  = (1 << 0),     // A new notification was pushed in `channels.notifications`.
+    GBA_EVENT_FRAME         = (1 << 1),     // A new frame was published in `shared_data.framebuffer`.
+    GBA_EVENT_AUDIO         = (1 << 2),     // At least `GBA_EVENT_AUDIO_BLOCK` samples are in the audio ring buffer.
+};
+
+#define GBA_EVENT_AUDIO_BLOCK           512
+
 struct shared_data {
     // The emulator's screen, as built by the PPU each frame.
     struct {
@@ -62,10 +86,20 @@ struct shared_data {
         atomic_uint version;
         atomic_bool dirty;
         pthread_mutex_t lock;
+
+        // Parts of the screen that changed since the frontend last cleared this array, updated
+        // under `lock` when a frame is published.
+        // Bit `x` of `dirty_tiles[y]` is set if pixels `[8x; 8x + 8)` of line `y` changed, so
+        // unchanged lines are 0. Encoders can use it to skip the unchanged areas without diffing `data`.
+        uint32_t dirty_tiles[GBA_SCREEN_HEIGHT];
+
+        // Same as `dirty_tiles`, for the frame being drawn.
+        uint32_t drawn_tiles[GBA_SCREEN_HEIGHT];
     } framebuffer;
 
     // The game's backup storage.
-    // There's no lock behind this data because
+    // There's no lock behind this data: the emulator writes to it at any time. Frontends needing a
+    // consistent copy should use `launch_config.backup_storage.persist` instead of reading it directly.
     struct {
         uint8_t *data;
         size_t size;
@@ -73,12 +107,50 @@ struct shared_data {
         atomic_bool dirty; // Set to true when `data` is modified.
     } backup_storage;
 
+    // Parts of the memory gathered at each VBlank (see `include/gba/watch.h`).
+    struct memory_watch watch;
+
     // The frame counter, used for FPS calculations.
     atomic_uint frame_counter;
 
+    // Frame skipping statistics (see `gba_shared_reset_frame_skip_stats()`).
+    struct {
+        atomic_uint skipped;        // Frames emulated but not drawn.
+        atomic_uint late;           // Frames that ended behind the frame limiter's deadline.
+        atomic_uint max_streak;     // Longest run of consecutive skipped frames.
+    } frame_skip;
+
+    // Rollback (see `include/gba/rollback.h`).
+    struct {
+        atomic_ullong frame;        // The frame running, to timestamp `MESSAGE_INPUT`.
+
+        // Statistics (see `gba_shared_reset_rollback_stats()`).
+        atomic_uint rollbacks;      // Re-simulations.
+        atomic_uint frames;         // Frames re-simulated.
+        atomic_uint max_depth;      // Most frames re-simulated at once.
+        atomic_ullong time;         // Time spent re-simulating, in usec.
+        atomic_uint late;           // Inputs received too late to be applied to their frame.
+    } rollback;
+
+    // Capture statistics (see `gba_shared_reset_capture_stats()`).
+    struct {
+        atomic_uint frames;         // Frames recorded.
+        atomic_uint duplicates;     // Frames recorded as a repeat of the previous one.
+        atomic_uint dropped;        // Frames dropped because the writer was behind.
+        atomic_ullong bytes;        // Bytes written.
+    } capture;
+
     // Audio ring buffer.
     struct apu_rbuffer audio_rbuffer;
     pthread_mutex_t audio_rbuffer_mutex;
+
+    // A file descriptor the frontend can poll to know when there's something new to consume.
+    // `read_fd` and `write_fd` are the same when backed by an eventfd, and both are -1 if it couldn't be created.
+    struct {
+        int read_fd;
+        int write_fd;
+        atomic_uint pending; // Bitfield of `enum gba_events` that weren't drained yet.
+    } event;
 };
 
 /*
@@ -101,6 +173,35 @@ struct gba_settings {
     // How many frame to skip
     uint32_t frame_skip_counter;
 
+    // Only skip frames while the emulation is behind the frame limiter's deadline, drawing
+    // at least one frame out of `frame_skip_counter` (all of them if it is <= 1).
+    // Has no effect when `fast_forward` is set since there's no deadline to miss.
+    bool adaptive_frame_skipping;
+
+    // Run-ahead (see `include/gba/runahead.h`), disabled if `frames` is 0.
+    // Frame skipping is ignored while it is enabled.
+    struct {
+        uint32_t frames;
+
+        // Play the audio of the real timeline instead of the one of the published frames.
+        // It lags `frames` frames behind the video but never glitches when the input changes.
+        bool audio_from_real_timeline;
+
+        // Run ahead on a second instance instead of restoring the state of this one afterwards.
+        // Saves a copy of the state per frame at the cost of another instance in memory.
+        bool second_instance;
+    } run_ahead;
+
+    // Rollback (see `include/gba/rollback.h`), disabled if `frames` is 0.
+    struct {
+        // How many frames back an input can still be applied.
+        uint32_t frames;
+
+        // Hold the keys of `MESSAGE_KEY` back for `delay` frames, as if they came from a remote
+        // player, to test rollback locally.
+        uint32_t delay;
+    } rollback;
+
     struct {
         bool enable_bg_layers[4];
         bool enable_oam;
@@ -112,6 +213,27 @@ struct gba_settings {
     } apu;
 };
 
+struct frame_skip_stats {
+    uint32_t skipped;
+    uint32_t late;
+    uint32_t max_streak;
+};
+
+struct capture_stats {
+    uint32_t frames;
+    uint32_t duplicates;
+    uint32_t dropped;
+    uint64_t bytes;
+};
+
+struct rollback_stats {
+    uint32_t rollbacks;
+    uint32_t frames;
+    uint32_t max_depth;
+    uint64_t time;
+    uint32_t late;
+};
+
 struct game_entry {
     char *code;
     enum backup_storage_types storage;
@@ -143,6 +265,30 @@ struct gba {
     struct io io;
     struct gpio gpio;
 
+    // Per-frame hash of the emulator's state, used to compare two executions.
+    struct digest digest;
+
+    // Background persistence of the backup storage.
+    struct backup_persistence backup_persistence;
+
+    // Run-ahead state, kept out of the components above so restoring them doesn't touch it.
+    struct run_ahead run_ahead;
+
+    // Rollback state, also kept out of the components above.
+    struct rollback rollback;
+
+    // Cheat codes run at each VBlank.
+    struct cheat_engine cheats;
+
+    // The link cable the instance is plugged into, if any.
+    struct link_port link;
+
+    // Recording of the frames and audio to disk.
+    struct capture capture;
+
+    // The variant of `core_run()` specialised for the current configuration (see `core_select_variant()`).
+    void (*run_variant)(struct gba *gba);
+
 #ifdef WITH_DEBUGGER
     struct debugger debugger;
 #endif
@@ -178,10 +324,50 @@ struct launch_config {
         enum backup_storage_types type;
         uint8_t *data;
         size_t size;
+
+        // If `fd` isn't -1 and `data` is NULL, the backup storage is that file mapped in memory,
+        // so the game's writes reach the page cache directly. The file is grown if it is too small.
+        // It is msync'd once the game hasn't written to it for `sync_delay` frames.
+        int fd;
+        uint32_t sync_delay;
+
+        // Persistence of the backup storage, disabled if both `callback` and `path` are NULL.
+        // Changes are persisted once the game hasn't written to the backup storage for `flush_delay`
+        // frames, and when the emulation is paused, stopped or reset.
+        struct {
+            // Called from a background thread with a consistent copy of the whole backup storage
+            // and the coalesced ranges modified since the previous call.
+            void (*callback)(void *arg, uint8_t const *data, size_t size, struct backup_range const *ranges, size_t ranges_len);
+            void *arg;
+
+            // If not NULL, the backup storage is written to this file through a temporary
+            // file renamed over it.
+            char const *path;
+
+            uint32_t flush_delay;
+        } persist;
     } backup_storage;
 
     // Initial value for all runtime-settings (speed, etc.)
     struct gba_settings settings;
+
+    // Log a digest of the emulator's state to `fd` at the end of each frame (see `include/gba/digest.h`).
+    // Frame skipping must be disabled for two logs to be comparable.
+    struct {
+        bool enable;
+        int fd;
+    } digest;
+
+    // Record the published frames and the audio to `video_fd` and `audio_fd`, both owned by the
+    // frontend (see `include/gba/capture.h`). Either can be -1 to leave it out, and the audio
+    // is only recorded if `audio_frequency` isn't 0. Frame skipping shows as repeated frames.
+    struct {
+        int video_fd;
+        int audio_fd;
+        enum capture_video_format video_format;
+        enum capture_policy policy;
+        uint32_t blocks;            // Frames buffered for the writer. 0 for `CAPTURE_DEFAULT_BLOCKS`.
+    } capture;
 };
 
 struct notification;
@@ -203,17 +389,33 @@ void gba_shared_audio_rbuffer_lock(struct gba *gba);
 void gba_shared_audio_rbuffer_release(struct gba *gba);
 uint32_t gba_shared_audio_rbuffer_pop_sample(struct gba *gba);
 uint32_t gba_shared_reset_frame_counter(struct gba *gba);
+void gba_shared_reset_frame_skip_stats(struct gba *gba, struct frame_skip_stats *stats);
+uint64_t gba_shared_rollback_frame(struct gba *gba);
+void gba_shared_reset_rollback_stats(struct gba *gba, struct rollback_stats *stats);
+void gba_shared_reset_capture_stats(struct gba *gba, struct capture_stats *stats);
+int gba_shared_event_fd(struct gba *gba);
+uint32_t gba_shared_drain_events(struct gba *gba);
 void gba_delete_notification(struct notification const *notif);
 
 /* source/gba/db.c */
 struct game_entry *db_lookup_game(uint8_t const *code);
 struct game_entry *db_autodetect_game_features(uint8_t const *rom, size_t rom_size);
+struct game_entry *db_identify_game(uint8_t const *rom, size_t rom_size);
+uint64_t db_rom_hash(uint8_t const *rom, size_t rom_size);
+void db_cache_save(struct game_entry const *entry, uint64_t rom_hash, size_t rom_size, uint8_t **data, size_t *size);
+struct game_entry *db_cache_load(uint64_t rom_hash, size_t rom_size, uint8_t const *data, size_t size);
 
 /*
 ** The following functions are *NOT* part of the public API of libgba.
 */
 
 /* source/gba/gba.c */
+void gba_init(struct gba *gba);
+void gba_release(struct gba *gba);
+void gba_state_reset(struct gba *gba, struct launch_config const *config);
+void gba_set_keys(struct gba *gba, uint32_t mask, uint32_t pressed);
 void gba_send_notification(struct gba *gba, enum notification_kind notif);
 void gba_state_pause(struct gba *);
+void gba_state_run(struct gba *gba);
 void gba_send_notification_raw(struct gba *gba, struct event_header const *notif_header);
+void gba_shared_signal_event(struct gba *gba, enum gba_events event);
@@ -0,0 +1,40 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Hibernation releases an idle instance entirely, keeping only a compact image of its state
+** that the host stores wherever it wants, and brings it back later exactly where it stopped.
+**
+** The image holds a quicksave (whose memory regions are run-length encoded, so unused pages
+** cost a few bytes), the runtime settings and whether the game was running. The BIOS, the ROM
+** and the backup storage configuration come from the `struct launch_config` given on resume,
+** which must describe the same game.
+**
+** An image is only valid for the build of the emulator that wrote it.
+*/
+
+struct gba;
+struct launch_config;
+
+/* source/gba/hibernate.c */
+bool gba_hibernate(struct gba *gba, uint8_t **data, size_t *size);
+bool gba_hibernate_to_fd(struct gba *gba, int fd);
+struct gba *gba_resume(struct launch_config const *config, uint8_t const *data, size_t size);
+struct gba *gba_resume_from_fd(struct launch_config const *config, int fd);
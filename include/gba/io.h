@@ -155,8 +155,15 @@ enum io_regs {
     IO_REG_KEYINPUT     = 0x04000130,
     IO_REG_KEYCNT       = 0x04000132,
 
-    /* Serial Communication (2) */
+    /* Serial Communication (1) */
+    IO_REG_SIODATA32    = 0x04000120,
+    IO_REG_SIOMULTI0    = 0x04000120,
+    IO_REG_SIOMULTI1    = 0x04000122,
+    IO_REG_SIOMULTI2    = 0x04000124,
+    IO_REG_SIOMULTI3    = 0x04000126,
     IO_REG_SIOCNT       = 0x04000128,
+    IO_REG_SIOMLT_SEND  = 0x0400012A,
+    IO_REG_SIODATA8     = 0x0400012A,
     IO_REG_RCNT         = 0x04000134,
     IO_REG_IR           = 0x04000136,
     IO_REG_UNKNOWN_1    = 0x04000142,
@@ -728,6 +735,12 @@ struct io {
         uint8_t bytes[2];
     } keycnt;
 
+    // REG_SIOMULTI0-3 (REG_SIODATA32 in Normal mode)
+    union {
+        uint16_t raw;
+        uint8_t bytes[2];
+    } siomulti[4];
+
     // REG_SIOCNT
     union {
         struct {
@@ -738,15 +751,35 @@ struct io {
             uint16_t : 3;
             uint16_t start: 1;
             uint16_t : 4;
-            uint16_t transfer_length: 1;
-            uint16_t : 1;
+            uint16_t mode: 2;               // 0=Normal 8bit, 1=Normal 32bit, 2=Multiplayer, 3=UART
             uint16_t irq: 1;
             uint16_t : 1;
         } __packed;
+
+        // Multiplayer mode
+        struct {
+            uint16_t baud_rate: 2;          // 0=9600, 1=38400, 2=57600, 3=115200 bps
+            uint16_t si_terminal: 1;        // 0=Parent, 1=Child
+            uint16_t sd_terminal: 1;        // 1=All GBAs ready
+            uint16_t id: 2;
+            uint16_t error: 1;
+            uint16_t start: 1;
+            uint16_t : 4;
+            uint16_t mode: 2;
+            uint16_t irq: 1;
+            uint16_t : 1;
+        } __packed multi;
+
         uint16_t raw;
         uint8_t bytes[2];
     } siocnt;
 
+    // REG_SIOMLT_SEND (REG_SIODATA8 in Normal mode)
+    union {
+        uint16_t raw;
+        uint8_t bytes[2];
+    } siomlt_send;
+
     // REG_RCNT
     union {
         uint16_t raw;
@@ -860,6 +893,13 @@ struct io {
             uint16_t raw;
             uint8_t bytes[2];
         } ime;
+
+        // Only used by instances plugged into a link cable, to see the mode and the start bit
+        // of a 16-bit write together.
+        union {
+            uint16_t raw;
+            uint8_t bytes[2];
+        } siocnt;
     } pending;
 };
 
@@ -888,7 +928,9 @@ static_assert(sizeof(((struct io *)NULL)->soundbias) == sizeof(uint32_t));
 static_assert(sizeof(((struct io *)NULL)->waveram) == 2 * (16 * sizeof(uint8_t)));
 static_assert(sizeof(((struct io *)NULL)->keycnt) == sizeof(uint16_t));
 static_assert(sizeof(((struct io *)NULL)->keyinput) == sizeof(uint16_t));
+static_assert(sizeof(((struct io *)NULL)->siomulti) == 4 * sizeof(uint16_t));
 static_assert(sizeof(((struct io *)NULL)->siocnt) == sizeof(uint16_t));
+static_assert(sizeof(((struct io *)NULL)->siomlt_send) == sizeof(uint16_t));
 static_assert(sizeof(((struct io *)NULL)->int_enabled) == sizeof(uint16_t));
 static_assert(sizeof(((struct io *)NULL)->int_flag) == sizeof(uint16_t));
 static_assert(sizeof(((struct io *)NULL)->waitcnt) == sizeof(uint16_t));
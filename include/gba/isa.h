@@ -0,0 +1,137 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct rich_color;
+
+/*
+** Instruction set extensions the hot kernels have a variant for, from the
+** least to the most capable on each architecture.
+*/
+enum isa_levels {
+    ISA_SCALAR = 0,
+    ISA_SSE4_1,
+    ISA_AVX2,
+    ISA_AVX512,
+    ISA_NEON,
+
+    ISA_LEN,
+};
+
+static char const * const isa_names[ISA_LEN] = {
+    [ISA_SCALAR] = "scalar",
+    [ISA_SSE4_1] = "sse4.1",
+    [ISA_AVX2] = "avx2",
+    [ISA_AVX512] = "avx512",
+    [ISA_NEON] = "neon",
+};
+
+/*
+** Unsigned comparisons between the elements of two buffers (see `isa_kernels.search_filter`).
+*/
+enum isa_compare {
+    ISA_CMP_EQ = 0,
+    ISA_CMP_NE,
+    ISA_CMP_GT,
+    ISA_CMP_LT,
+};
+
+// Number of bytes `search_filter` processes at once, one bitmap word for 8-bit elements.
+#define ISA_SEARCH_CHUNK                64
+
+// Maximum number of buffers given to `hash64_batch` at once.
+#define ISA_HASH_BATCH                  8
+
+/*
+** The kernels selected at runtime.
+**
+** Each variant must produce exactly the same output as the scalar one: the
+** choice of ISA is never allowed to change the emulation.
+*/
+struct isa_kernels {
+    // Convert `len` pixels of a composed scanline to the RGB555 framebuffer format.
+    void (*scanline_to_rgb555)(uint16_t *dst, struct rich_color const *src, size_t len);
+
+    // Count how many of the first `size` bytes of `data` are equal to `data[0]`, up to `max`.
+    size_t (*run_length)(uint8_t const *data, size_t size, size_t max);
+
+    // Clear the bit of `bitmap` of each little-endian element of `width` (1, 2 or 4) bytes of `cur`
+    // that doesn't compare to the matching element of `ref` according to `cmp`.
+    // Bit `n` of `bitmap[i]` stands for element `64 * i + n`. `size` is a multiple of `ISA_SEARCH_CHUNK`
+    // and `ref` moves forward by `ref_step` (`ISA_SEARCH_CHUNK` or 0) bytes per chunk.
+    void (*search_filter)(uint64_t *bitmap, uint8_t const *cur, uint8_t const *ref, size_t ref_step, size_t size, size_t width, enum isa_compare cmp);
+
+    // Set `hashes[i]` to `hs_hash64(data[i], size, seeds[i])` for each of the `count` buffers, with
+    // `count` at most `ISA_HASH_BATCH`. Each lane of a hash depends on the previous stripe, so only
+    // hashing several buffers side by side keeps the vector units busy.
+    void (*hash64_batch)(uint64_t *hashes, uint8_t const * const *data, uint64_t const *seeds, size_t count, size_t size);
+};
+
+extern struct isa_kernels isa;
+
+/*
+** Return the bits of a `search_filter` bitmap standing for the elements of the given chunk.
+*/
+static inline
+uint64_t
+isa_search_chunk_bits(
+    uint64_t const *bitmap,
+    size_t chunk,
+    size_t width
+) {
+    size_t per_chunk;
+    size_t bit;
+
+    per_chunk = ISA_SEARCH_CHUNK / width;
+    bit = chunk * per_chunk;
+    return ((bitmap[bit / 64] >> (bit % 64)) & (per_chunk == 64 ? UINT64_MAX : ((1ull << per_chunk) - 1)));
+}
+
+/*
+** Replace the bits of a `search_filter` bitmap standing for the elements of the given chunk.
+*/
+static inline
+void
+isa_search_chunk_store(
+    uint64_t *bitmap,
+    size_t chunk,
+    size_t width,
+    uint64_t bits
+) {
+    size_t per_chunk;
+    uint64_t mask;
+    size_t bit;
+
+    per_chunk = ISA_SEARCH_CHUNK / width;
+    bit = chunk * per_chunk;
+    mask = (per_chunk == 64 ? UINT64_MAX : ((1ull << per_chunk) - 1)) << (bit % 64);
+    bitmap[bit / 64] = (bitmap[bit / 64] & ~mask) | ((bits << (bit % 64)) & mask);
+}
+
+/* gba/isa/isa.c */
+void isa_init(void);
+enum isa_levels isa_level(void);
+struct isa_kernels const *isa_level_kernels(enum isa_levels level);
+
+/* gba/isa/neon.c */
+extern struct isa_kernels const isa_kernels_neon;
+
+/* gba/isa/x86.c */
+extern struct isa_kernels const isa_kernels_sse4_1;
+extern struct isa_kernels const isa_kernels_avx2;
+extern struct isa_kernels const isa_kernels_avx512;
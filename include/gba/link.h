@@ -0,0 +1,65 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+/*
+** A link cable between up to four instances of the same process, each run by its own
+** `gba_run()` thread.
+**
+** The instances share a timeline and none of them may run more than a given number of cycles
+** ahead of the slowest one. That bound is coarse (a scanline by default) while the cable is
+** idle, and fine while a transfer is in flight, so that its end is seen at about the same time
+** by all the players. Instances only wait for each other between two runs of the scheduler,
+** never within one.
+**
+** The Normal (8 and 32 bits) and Multiplayer modes are emulated. In Normal mode, the players
+** of slots 0 and 1, and those of slots 2 and 3, are connected to each other. In Multiplayer
+** mode, slot 0 is the parent.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gba/scheduler.h"
+
+#define LINK_MAX_PLAYERS            4
+
+struct gba;
+struct link_hub;
+
+/*
+** The end of the cable an instance is plugged into. Only accessed by the thread running that instance.
+*/
+struct link_port {
+    struct link_hub *hub;           // NULL if the instance isn't connected.
+    uint32_t slot;
+
+    // `scheduler.cycles` when the hub's timeline was at 0.
+    uint64_t base;
+
+    // The last transfer whose end was scheduled on this instance.
+    uint32_t transfer;
+};
+
+/* source/gba/link.c */
+struct link_hub *link_hub_create(uint32_t coarse_cycles, uint32_t fine_cycles);
+void link_hub_delete(struct link_hub *hub);
+bool link_hub_attach(struct link_hub *hub, struct gba *gba, uint32_t slot);
+void link_hub_detach(struct gba *gba);
+void link_run(struct gba *gba);
+void link_reset(struct gba *gba);
+void link_stop(struct gba *gba);
+void link_write_data(struct gba *gba);
+bool link_write_siocnt(struct gba *gba);
+void link_transfer_end(struct gba *gba, struct event_args args);
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <stdint.h>
 #include "hs.h"
 #include "gba/scheduler.h"
@@ -197,6 +198,63 @@ struct eeprom {
     uint32_t transfer_len;
 };
 
+/*
+** Granularity at which writes to the backup storage are tracked for persistence.
+*/
+#define BACKUP_SECTOR_SHIFT     8
+#define BACKUP_SECTOR_SIZE      (1u << BACKUP_SECTOR_SHIFT)
+#define BACKUP_SECTOR_LEN       (FLASH128_SIZE >> BACKUP_SECTOR_SHIFT)
+#define BACKUP_DIRTY_WORDS      (BACKUP_SECTOR_LEN / 64)
+
+/*
+** A range of the backup storage that was modified.
+*/
+struct backup_range {
+    uint32_t offset;
+    uint32_t size;
+};
+
+/*
+** Persistence of the backup storage.
+**
+** Writes made by the game mark the sectors they touch as dirty. Once the game
+** hasn't written anything for `flush_delay` frames, the dirty sectors are copied
+** to `snapshot` at the next VBlank and a background thread hands them to the
+** frontend and/or writes them to `path`.
+**
+** If the backup storage is a file mapped in memory (`mapped`), it is also msync'd
+** once the game hasn't written anything for `sync_delay` frames.
+**
+** `dirty`, `written`, `unsynced` and `quiet_frames` belong to the emulator's thread,
+** the rest is protected by `lock`.
+*/
+struct backup_persistence {
+    bool enabled;
+
+    uint64_t dirty[BACKUP_DIRTY_WORDS];
+    bool written;                   // Set if the backup storage was written to since the last VBlank
+    uint32_t quiet_frames;          // Number of frames since the last write
+    uint32_t flush_delay;
+
+    bool mapped;
+    bool unsynced;                  // Set if the mapping was written to since the last msync
+    uint32_t sync_delay;
+
+    void (*callback)(void *arg, uint8_t const *data, size_t size, struct backup_range const *ranges, size_t ranges_len);
+    void *arg;
+    char *path;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    uint8_t *snapshot;              // Copy of the backup storage as of the last snapshot
+    size_t size;
+    uint64_t pending[BACKUP_DIRTY_WORDS]; // Sectors of `snapshot` that weren't persisted yet
+    bool busy;                      // Set while the thread is persisting a snapshot
+    bool exit;
+};
+
 struct prefetch_buffer {
     uint32_t head;
     uint32_t tail;
@@ -260,6 +318,10 @@ struct memory {
 
     // Set when the cartridge memory bus is in used
     bool gamepak_bus_in_use;
+
+    // Cycles taken by a 16 or 32-bit access to each region, derived from REG_WAITCNT (see `mem_update_waitstates()`).
+    uint32_t access_time16[2][16];
+    uint32_t access_time32[2][16];
 };
 
 /*
@@ -274,6 +336,7 @@ enum dma_timings {
 
 struct core;
 struct gba;
+struct launch_config;
 struct dma_channel;
 
 /* gba/memory/dma.c */
@@ -290,7 +353,10 @@ void mem_io_write8(struct gba *gba, uint32_t addr, uint8_t val);
 
 /* gba/memory/memory.c */
 void mem_access(struct gba *gba, uint32_t addr, uint32_t size, enum access_types access_type);
-void mem_update_waitstates(struct gba const *gba);
+void mem_update_waitstates(struct gba *gba);
+uint32_t mem_access_cycles(struct gba const *gba, uint32_t addr, uint32_t size, enum access_types access_type);
+void *mem_ram_span(struct gba *gba, uint32_t addr, size_t size, bool write);
+uint32_t *mem_ram_bulk_access32(struct gba *gba, uint32_t addr, uint32_t count, uint32_t extra_cycles, bool write);
 void mem_prefetch_buffer_step(struct gba *gba, uint32_t cycles);
 uint32_t mem_openbus_read(struct gba const *gba, uint32_t addr);
 uint8_t mem_read8(struct gba *gba, uint32_t addr, enum access_types access_type);
@@ -301,6 +367,14 @@ uint32_t mem_read16_ror(struct gba *gba, uint32_t addr, enum access_types access
 uint32_t mem_read32(struct gba *gba, uint32_t addr, enum access_types access_type);
 uint32_t mem_read32_raw(struct gba *gba, uint32_t addr);
 uint32_t mem_read32_ror(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint16_t mem_fetch16_prefetch_eeprom(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint16_t mem_fetch16_prefetch(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint16_t mem_fetch16_eeprom(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint16_t mem_fetch16(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint32_t mem_fetch32_prefetch_eeprom(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint32_t mem_fetch32_prefetch(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint32_t mem_fetch32_eeprom(struct gba *gba, uint32_t addr, enum access_types access_type);
+uint32_t mem_fetch32(struct gba *gba, uint32_t addr, enum access_types access_type);
 void mem_write8(struct gba *gba, uint32_t addr, uint8_t val, enum access_types access_type);
 void mem_write8_raw(struct gba *gba, uint32_t addr, uint8_t val);
 void mem_write16(struct gba *gba, uint32_t addr, uint16_t val, enum access_types access_type);
@@ -311,15 +385,26 @@ void mem_write32_raw(struct gba *gba, uint32_t addr, uint32_t val);
 /* gba/memory/storage/eeprom.c */
 uint8_t mem_eeprom_read8(struct gba *gba);
 void mem_eeprom_write8(struct gba *gba, bool val);
+void mem_eeprom_read_stream(struct gba *gba, uint16_t *stream, size_t len);
+void mem_eeprom_write_stream(struct gba *gba, uint16_t const *stream, size_t len);
 
 /* gba/memory/storage/flash.c */
 uint8_t mem_flash_read8(struct gba const *gba, uint32_t addr);
 void mem_flash_write8(struct gba *gba, uint32_t addr, uint8_t val);
 
+/* gba/memory/storage/persist.c */
+void mem_backup_storage_attach(struct gba *gba, struct launch_config const *config);
+void mem_backup_storage_resize(struct gba *gba, size_t size);
+void mem_backup_storage_release(struct gba *gba);
+void mem_backup_storage_persist_start(struct gba *gba, struct launch_config const *config);
+void mem_backup_storage_persist_stop(struct gba *gba);
+void mem_backup_storage_mark_dirty(struct gba *gba, size_t offset, size_t size);
+void mem_backup_storage_frame(struct gba *gba);
+void mem_backup_storage_write_to_disk(struct gba *gba);
+
 /* gba/memory/storage/storage.c */
 uint8_t mem_backup_storage_read8(struct gba const *gba, uint32_t addr);
 void mem_backup_storage_write8(struct gba *gba, uint32_t addr, uint8_t value);
-void mem_backup_storage_write_to_disk(struct gba *gba);
 
 /* gba/quicksave.c */
 void quicksave(struct gba const *gba, uint8_t **data, size_t *size);
@@ -17,6 +17,18 @@
 #include "hs.h"
 #include "gba/gba.h"
 
+// Cycles spent in HDraw (and the few cycles after it) before HBlank starts, then in HBlank.
+#define PPU_HDRAW_CYCLES        (GBA_CYCLES_PER_PIXEL * GBA_SCREEN_WIDTH + 46)
+#define PPU_HBLANK_CYCLES       (GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH - PPU_HDRAW_CYCLES)
+
+/*
+** The phase a scanline enters when `SCHED_EVENT_PPU_SCANLINE` fires, given as its argument.
+*/
+enum ppu_phase {
+    PPU_PHASE_HDRAW,
+    PPU_PHASE_HBLANK,
+};
+
 enum oam_mode {
     OAM_MODE_NORMAL,
     OAM_MODE_BLEND,
@@ -127,6 +139,17 @@ struct ppu {
 
     bool video_capture_enabled;             // Set when the DMA video capture is enabled
 
+    /*
+    ** The result of the color effects for each value of a 5-bit channel, for the current
+    ** BLDALPHA and BLDY. Kept to avoid the multiplications in `ppu_merge_layer()`, and only rebuilt
+    ** when their coefficients change.
+    */
+    uint8_t blend_alpha[32][32];            // Indexed by the top and bottom channels
+    uint8_t blend_light[32];
+    uint8_t blend_dark[32];
+    uint32_t blend_alpha_hash;
+    uint32_t blend_bright_hash;
+
     bool skip_current_frame;
     uint32_t current_frame_skip_counter;
 };
@@ -148,8 +171,7 @@ void ppu_prerender_oam(struct gba *gba, struct scanline *scanline, int32_t line)
 
 /* gba/ppu/ppu.c */
 void ppu_render_black_screen(struct gba *gba);
-void ppu_hblank(struct gba *gba, struct event_args args);
-void ppu_hdraw(struct gba *gba, struct event_args args);
+void ppu_scanline(struct gba *gba, struct event_args args);
 
 /* gba/ppu/window.c */
 void ppu_window_build_masks(struct gba *gba, uint32_t y);
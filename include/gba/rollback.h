@@ -0,0 +1,99 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+** Rollback hides the latency of inputs that reach the emulator late, like those of a remote player.
+**
+** Frames are numbered from the last reset, and a frame starts at the VBlank ending the previous one.
+** The inputs only change at the start of a frame, where the state is also saved in a ring of
+** `frames` snapshots. Frames whose input isn't known yet run with the last input known.
+** When an input arrives for a past frame and differs from what was predicted, the snapshot of that
+** frame is restored and the emulation runs again up to where it was, with the corrected inputs.
+** Only the last frame of the re-simulation is drawn and published, and none of it is heard.
+*/
+
+struct gba;
+struct snapshot;
+
+struct rollback_frame {
+    struct snapshot *snapshot;      // The state at the start of the frame.
+    uint64_t frame;
+    uint32_t keys;
+    bool confirmed;                 // Set if `keys` was received rather than predicted.
+};
+
+struct rollback_input {
+    uint64_t frame;
+    uint32_t keys;
+    uint64_t deliver;               // The frame at the start of which it is applied.
+};
+
+struct rollback {
+    // Latched from `gba_settings.rollback` at the start of each frame.
+    bool enabled;
+    uint32_t delay;
+
+    uint64_t frame;                 // The frame running.
+    bool frame_ready;               // Set when a frame ends, for `gba_run()` to start the next one.
+
+    struct rollback_frame *ring;
+    uint32_t ring_len;
+
+    // The last input known and the frame it is for, used for the frames that have none yet.
+    uint32_t keys;
+    uint64_t keys_frame;
+
+    // The local keys pressed (see `rollback_local_keys()`).
+    uint32_t local_keys;
+
+    // The oldest frame whose input was corrected since the last re-simulation, if `dirty` is set.
+    bool dirty;
+    uint64_t dirty_frame;
+
+    // Set while re-simulating, until `present` is reached again.
+    bool resimulating;
+    uint64_t present;
+
+    // The last frame during which the backup storage was written to.
+    uint64_t backup_frame;
+
+    // The inputs held back by `gba_settings.rollback.delay`, or received before their frame.
+    struct rollback_input *delayed;
+    uint32_t delayed_len;
+    uint32_t delayed_size;
+};
+
+/*
+** True if the frame being drawn is published to the frontend.
+*/
+static inline
+bool
+rollback_publishes(
+    struct rollback const *rollback
+) {
+    return (!rollback->resimulating || rollback->frame + 1 >= rollback->present);
+}
+
+/* source/gba/rollback.c */
+void rollback_reset(struct gba *gba);
+void rollback_release(struct gba *gba);
+void rollback_frame(struct gba *gba);
+void rollback_input(struct gba *gba, uint64_t frame, uint32_t keys);
+void rollback_local_keys(struct gba *gba, uint32_t mask, uint32_t pressed);
+void rollback_resimulate(struct gba *gba);
@@ -0,0 +1,87 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+** Run-ahead hides the latency between an input and its effect on screen.
+**
+** Each time the real timeline completes a frame, its state is saved and the emulation runs
+** `frames` frames ahead with the current input. The last of them is published, then the
+** state saved beforehand is restored. The frames of the real timeline aren't drawn.
+*/
+
+struct gba;
+struct snapshot;
+
+struct run_ahead {
+    // Latched from `gba_settings.run_ahead` when the real timeline starts a new frame.
+    bool enabled;
+    uint32_t frames;
+    bool audio_from_real_timeline;
+    bool second_instance;
+
+    bool speculating;               // Set while running ahead of the real timeline.
+    uint32_t frames_done;           // Frames completed since the speculation started.
+    bool frame_ready;               // Set when the real timeline completes a frame, for `gba_run()` to run ahead of it.
+    bool backup_written;            // Set if the backup storage was written to while speculating.
+
+    struct snapshot *snapshot;
+    struct gba *shadow;             // The instance running ahead, when `second_instance` is set.
+    uint32_t shadow_version;        // `shared_data.framebuffer.version` after the shadow instance last published a frame.
+
+    // Time spent running ahead since the last reset, in usec.
+    struct {
+        uint64_t frames;
+        uint64_t save_time;
+        uint64_t restore_time;
+        uint64_t speculation_time;
+    } stats;
+};
+
+/*
+** True if the frame being drawn is the one published to the frontend.
+*/
+static inline
+bool
+run_ahead_publishes(
+    struct run_ahead const *run_ahead
+) {
+    return (!run_ahead->enabled || (run_ahead->speculating && run_ahead->frames_done + 1 >= run_ahead->frames));
+}
+
+/*
+** True if the samples produced now should be pushed to the audio ring buffer.
+*/
+static inline
+bool
+run_ahead_plays_audio(
+    struct run_ahead const *run_ahead
+) {
+    if (!run_ahead->enabled) {
+        return (true);
+    } else if (run_ahead->audio_from_real_timeline) {
+        return (!run_ahead->speculating);
+    }
+    return (run_ahead_publishes(run_ahead));
+}
+
+/* source/gba/runahead.c */
+void run_ahead_reset(struct gba *gba);
+void run_ahead_latch(struct gba *gba);
+void run_ahead_frame(struct gba *gba);
+void run_ahead_release(struct gba *gba);
@@ -21,9 +21,7 @@
 typedef size_t event_handler_t;
 
 enum sched_event_kind {
-    SCHED_EVENT_FRAME_LIMITER,
-    SCHED_EVENT_PPU_HDRAW,
-    SCHED_EVENT_PPU_HBLANK,
+    SCHED_EVENT_PPU_SCANLINE,
     SCHED_EVENT_TIMER_OVERFLOW,
     SCHED_EVENT_APU_RESAMPLE,
     SCHED_EVENT_APU_MODULES_STEP,
@@ -34,6 +32,8 @@ enum sched_event_kind {
     SCHED_EVENT_DMA_ADD_PENDING,
     SCHED_EVENT_IO_WRITE,
     SCHED_EVENT_CORE_UPDATE_IRQ_LINE,
+    SCHED_EVENT_LINK_TRANSFER,
+    SCHED_EVENT_MAX,
 };
 
 enum sched_event_type {
@@ -73,14 +73,21 @@ struct scheduler {
 
     uint64_t next_event;            // The next event should occure when cycles == next_event
 
+    uint64_t run_limit;             // `core_run()` stops once cycles reach it. Set to 0 by `sched_raise_attention()`.
+
     struct scheduler_event *events;
     size_t events_size;
 
     uint64_t time_per_frame;        // In usec
     uint64_t time_last_frame;       // In usec
     uint64_t accumulated_time;
+
+    bool late;                      // Set when the last frame ended behind the frame limiter's deadline
 };
 
+// A frame ending more than `time_per_frame / SCHED_LATE_THRESHOLD` after its deadline is late.
+#define SCHED_LATE_THRESHOLD                4
+
 #define NEW_FIX_EVENT(_kind, _at)           \
     (struct scheduler_event){               \
         .kind = (_kind),                    \
@@ -136,6 +143,7 @@ event_handler_t sched_add_event(struct gba *gba, struct scheduler_event event);
 void sched_cancel_event(struct gba *gba, event_handler_t handler);
 void sched_process_events(struct gba *gba);
 void sched_run_for(struct gba *gba, uint64_t cycles);
-void sched_frame_limiter(struct gba *gba,struct event_args args);
+void sched_raise_attention(struct gba *gba);
+void sched_frame_limiter(struct gba *gba);
 void sched_reset_frame_limiter(struct gba *gba);
 void sched_update_speed(struct gba *gba);
@@ -0,0 +1,49 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** RAM search, to find where a game keeps a value by narrowing down the candidates frame after frame.
+**
+** A search works on a copy of EWRAM followed by IWRAM, `RAM_SEARCH_SIZE` bytes, taken while the
+** emulator isn't running (`gba->memory.ewram` already has this layout) or gathered by the watch
+** list `{ EWRAM_START, EWRAM_SIZE }, { IWRAM_START, IWRAM_SIZE }` (see `include/gba/watch.h`).
+*/
+
+#define RAM_SEARCH_SIZE                 (EWRAM_SIZE + IWRAM_SIZE)
+
+struct ram_search;
+
+enum ram_search_conditions {
+    RAM_SEARCH_EQUAL = 0,           // Equal to `value`.
+    RAM_SEARCH_NOT_EQUAL,           // Not equal to `value`.
+    RAM_SEARCH_GREATER,             // Greater than `value`.
+    RAM_SEARCH_LESS,                // Less than `value`.
+    RAM_SEARCH_CHANGED,             // Changed since the previous step.
+    RAM_SEARCH_UNCHANGED,           // Unchanged since the previous step.
+    RAM_SEARCH_INCREASED,           // Greater than at the previous step.
+    RAM_SEARCH_DECREASED,           // Less than at the previous step.
+};
+
+/* source/gba/search.c */
+struct ram_search *ram_search_create(uint32_t width, uint8_t const *ram);
+void ram_search_delete(struct ram_search *search);
+void ram_search_reset(struct ram_search *search, uint8_t const *ram);
+size_t ram_search_step(struct ram_search *search, uint8_t const *ram, enum ram_search_conditions cond, uint32_t value);
+size_t ram_search_count(struct ram_search const *search);
+size_t ram_search_results(struct ram_search const *search, size_t start, uint32_t *addrs, size_t max);
@@ -0,0 +1,32 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+
+/*
+** Raw in-memory copies of the emulator's state, much cheaper than a quicksave but only valid
+** within the process and for the game they were taken from.
+*/
+
+struct gba;
+struct snapshot;
+
+/* source/gba/snapshot.c */
+struct snapshot *snapshot_create(void);
+void snapshot_delete(struct snapshot *snapshot);
+void snapshot_save(struct gba const *gba, struct snapshot *snapshot);
+void snapshot_restore(struct gba *gba, struct snapshot const *snapshot, bool backup_storage);
+void snapshot_clone(struct gba *dst, struct gba const *src);
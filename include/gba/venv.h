@@ -0,0 +1,69 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+/*
+** A batch of emulators stepped together, for reinforcement learning.
+**
+** The instances are driven directly by a thread pool: there's no `gba_run()` thread, no
+** message and no lock involved, and observations are written straight to a buffer owned
+** by the caller.
+*/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct gba;
+struct launch_config;
+struct venv;
+
+enum venv_frame_formats {
+    VENV_FRAME_NONE = 0,            // No frame in the observations. The PPU doesn't draw anything.
+    VENV_FRAME_GRAY8,               // One byte of luminance per pixel.
+    VENV_FRAME_RGB24,               // Three bytes (red, green, blue) per pixel.
+};
+
+struct venv_config {
+    // Number of environments.
+    uint32_t len;
+
+    // Number of threads stepping the environments, including the caller of `venv_step()`.
+    // 0 uses one per CPU.
+    uint32_t threads;
+
+    // The observation of an environment is its last frame in `frame_format`, downscaled by
+    // `downscale` (1, 2, 4 or 8) on both axes, followed by the byte at each of the `ram_len`
+    // addresses of `ram`. See `venv_observation_size()`.
+    enum venv_frame_formats frame_format;
+    uint32_t downscale;
+    uint32_t const *ram;
+    size_t ram_len;
+
+    // An environment goes back to its initial state once it ran `episode_frames` frames (0 for
+    // no limit), or if `done` returns true at the end of a step.
+    // `done` is called from the thread pool, concurrently for different environments.
+    uint64_t episode_frames;
+    bool (*done)(void *arg, struct gba *gba, uint32_t env);
+    void *arg;
+};
+
+/* source/gba/venv.c */
+struct venv *venv_create(struct launch_config const *launch, struct venv_config const *config);
+void venv_delete(struct venv *venv);
+size_t venv_observation_size(struct venv const *venv);
+struct gba *venv_env(struct venv *venv, uint32_t idx);
+void venv_reset(struct venv *venv, uint8_t *obs);
+void venv_step(struct venv *venv, uint32_t const *actions, uint32_t frames, uint8_t *obs, bool *dones);
@@ -0,0 +1,91 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+** Frame-consistent views of parts of the guest's memory.
+**
+** The frontend registers a watch list of address ranges in EWRAM, IWRAM, PALRAM, VRAM or OAM.
+** At the start of each VBlank of the real timeline, the emulator gathers their content into a
+** compact buffer, and `watch_acquire()` hands out the latest complete one without copying it.
+**
+** Three buffers rotate between the emulator and the frontend, so neither ever waits for the
+** other to be done with a frame.
+*/
+
+struct gba;
+
+struct watch_range {
+    uint32_t addr;
+    uint32_t size;
+};
+
+/*
+** The content of the watched ranges at the start of a VBlank, as returned by `watch_acquire()`.
+** The content of range `i` starts at `data + offsets[i]`.
+*/
+struct watch_view {
+    uint64_t frame;                     // Number of frames gathered since the watch list was set, starting at 1.
+    struct watch_range const *ranges;
+    uint32_t const *offsets;
+    size_t len;
+    uint8_t const *data;
+    size_t size;
+};
+
+struct watch_buffer {
+    uint64_t frame;
+    uint64_t generation;                // Value of `memory_watch.generation` the ranges were copied from.
+    struct watch_range *ranges;
+    uint32_t *offsets;
+    size_t len;
+    uint8_t *data;
+    size_t size;
+};
+
+struct memory_watch {
+    pthread_mutex_t lock;
+
+    // Set by `watch_set()`, so the emulator doesn't take the lock when nothing is watched.
+    atomic_bool enabled;
+
+    // The watch list, under `lock`.
+    struct watch_range *ranges;
+    size_t len;
+    uint64_t generation;                // Incremented each time the watch list changes.
+    uint64_t frame;
+
+    // `back` is filled by the emulator, `front` is read by the frontend, and `ready` is the latest
+    // complete buffer not acquired yet if `fresh` is set. They are swapped under `lock`.
+    struct watch_buffer buffers[3];
+    uint32_t back;
+    uint32_t ready;
+    uint32_t front;
+    bool fresh;
+};
+
+/* source/gba/watch.c */
+bool watch_set(struct gba *gba, struct watch_range const *ranges, size_t len);
+bool watch_acquire(struct gba *gba, struct watch_view *view);
+void const *watch_view_ptr(struct watch_view const *view, uint32_t addr, uint32_t size);
+void watch_init(struct gba *gba);
+void watch_release(struct gba *gba);
+void watch_gather(struct gba *gba);
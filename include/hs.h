@@ -54,6 +54,9 @@
 #ifndef FLATTEN
 #define FLATTEN __attribute__((flatten))
 #endif
+#ifndef ALWAYS_INLINE
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
 #ifndef likely
 #define likely(x) __builtin_expect(!!(x), 1)
 #endif
@@ -131,6 +134,148 @@ hs_mask_for_width(
 #define align_on(x, y) ((x) & ~((y) - 1))
 #define align(T, x) ((__typeof__(x))(align_on((x), sizeof(T))))
 
+/*
+** A 64-bit non-cryptographic hash of `size` bytes (the XXH64 algorithm).
+**
+** Used to identify ROMs and emulator states, so it must stay stable across releases.
+*/
+#define HS_HASH64_PRIME1        UINT64_C(0x9E3779B185EBCA87)
+#define HS_HASH64_PRIME2        UINT64_C(0xC2B2AE3D27D4EB4F)
+#define HS_HASH64_PRIME3        UINT64_C(0x165667B19E3779F9)
+#define HS_HASH64_PRIME4        UINT64_C(0x85EBCA77C2B2AE63)
+#define HS_HASH64_PRIME5        UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t
+hs_rotl64(
+    uint64_t x,
+    unsigned r
+) {
+    return ((x << r) | (x >> (64 - r)));
+}
+
+static inline uint64_t
+hs_hash64_round(
+    uint64_t acc,
+    uint64_t input
+) {
+    acc += input * HS_HASH64_PRIME2;
+    acc = hs_rotl64(acc, 31);
+    return (acc * HS_HASH64_PRIME1);
+}
+
+static inline uint64_t
+hs_hash64_merge(
+    uint64_t acc,
+    uint64_t val
+) {
+    acc ^= hs_hash64_round(0, val);
+    return (acc * HS_HASH64_PRIME1 + HS_HASH64_PRIME4);
+}
+
+/*
+** Fold the four lanes of `hs_hash64()` into one value, once all the 32-byte stripes went through them.
+*/
+static inline uint64_t
+hs_hash64_converge(
+    uint64_t const *v
+) {
+    uint64_t h;
+
+    h = hs_rotl64(v[0], 1) + hs_rotl64(v[1], 7) + hs_rotl64(v[2], 12) + hs_rotl64(v[3], 18);
+    h = hs_hash64_merge(h, v[0]);
+    h = hs_hash64_merge(h, v[1]);
+    h = hs_hash64_merge(h, v[2]);
+    h = hs_hash64_merge(h, v[3]);
+    return (h);
+}
+
+/*
+** Hash the last `end - p` bytes (less than 32) of a buffer of `size` bytes and mix the result.
+**
+** Shared with the vector variants of `hs_hash64()` (see `isa_kernels.hash64_batch`), which only
+** compute the lanes differently.
+*/
+static inline uint64_t
+hs_hash64_finish(
+    uint64_t h,
+    uint8_t const *p,
+    uint8_t const *end,
+    size_t size
+) {
+    h += (uint64_t)size;
+
+    while (end - p >= 8) {
+        uint64_t k;
+
+        __builtin_memcpy(&k, p, sizeof(k));
+        h ^= hs_hash64_round(0, k);
+        h = hs_rotl64(h, 27) * HS_HASH64_PRIME1 + HS_HASH64_PRIME4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        uint32_t k;
+
+        __builtin_memcpy(&k, p, sizeof(k));
+        h ^= (uint64_t)k * HS_HASH64_PRIME1;
+        h = hs_rotl64(h, 23) * HS_HASH64_PRIME2 + HS_HASH64_PRIME3;
+        p += 4;
+    }
+
+    while (p < end) {
+        h ^= (uint64_t)*p * HS_HASH64_PRIME5;
+        h = hs_rotl64(h, 11) * HS_HASH64_PRIME1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= HS_HASH64_PRIME2;
+    h ^= h >> 29;
+    h *= HS_HASH64_PRIME3;
+    h ^= h >> 32;
+    return (h);
+}
+
+static inline uint64_t
+hs_hash64(
+    void const *data,
+    size_t size,
+    uint64_t seed
+) {
+    uint8_t const *p;
+    uint8_t const *end;
+    uint64_t h;
+
+    p = data;
+    end = p + size;
+
+    if (size >= 32) {
+        uint64_t v[4];
+
+        v[0] = seed + HS_HASH64_PRIME1 + HS_HASH64_PRIME2;
+        v[1] = seed + HS_HASH64_PRIME2;
+        v[2] = seed;
+        v[3] = seed - HS_HASH64_PRIME1;
+
+        do {
+            uint64_t lanes[4];
+
+            __builtin_memcpy(lanes, p, sizeof(lanes));
+            v[0] = hs_hash64_round(v[0], lanes[0]);
+            v[1] = hs_hash64_round(v[1], lanes[1]);
+            v[2] = hs_hash64_round(v[2], lanes[2]);
+            v[3] = hs_hash64_round(v[3], lanes[3]);
+            p += 32;
+        } while (end - p >= 32);
+
+        h = hs_hash64_converge(v);
+    } else {
+        h = seed + HS_HASH64_PRIME5;
+    }
+
+    return (hs_hash64_finish(h, p, end, size));
+}
+
 enum hs_module {
     HS_INFO = 0,
 
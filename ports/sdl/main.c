@@ -379,6 +379,9 @@ main(
     config.rom.size = rom.size;
     config.rom.fd = -1;
     config.rom.fd_offset = 0;
+    config.backup_storage.fd = -1;
+    config.capture.video_fd = -1;
+    config.capture.audio_fd = -1;
     config.bios.data = bios.data;
     config.bios.size = bios.size;
     config.skip_bios = skip_bios;
@@ -26,7 +26,6 @@
 static int32_t fifo_volume[2] = {2, 4};
 static int32_t psg_volume[4] = {1, 2, 4, 0};
 
-static
 void
 apu_rbuffer_push(
     struct apu_rbuffer *rbuffer,
@@ -70,6 +69,12 @@ apu_resample(
 ) {
     int32_t sample_l;
     int32_t sample_r;
+    size_t size;
+
+    // When running ahead, only one of the two timelines is heard. Re-simulated frames were heard already.
+    if (!run_ahead_plays_audio(&gba->run_ahead) || gba->rollback.resimulating) {
+        return;
+    }
 
     sample_l = 0;
     sample_r = 0;
@@ -115,5 +120,14 @@ apu_resample(
 
     pthread_mutex_lock(&gba->shared_data.audio_rbuffer_mutex);
     apu_rbuffer_push(&gba->shared_data.audio_rbuffer, (int16_t)sample_l, (int16_t)sample_r);
+    size = gba->shared_data.audio_rbuffer.size;
     pthread_mutex_unlock(&gba->shared_data.audio_rbuffer_mutex);
+
+    if (gba->capture.enabled) {
+        capture_audio(gba, (int16_t)sample_l, (int16_t)sample_r);
+    }
+
+    if (size >= GBA_EVENT_AUDIO_BLOCK) {
+        gba_shared_signal_event(gba, GBA_EVENT_AUDIO);
+    }
 }
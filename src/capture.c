@@ -0,0 +1,623 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "gba/gba.h"
+
+// The refresh rate of the GBA, 16777216 / 280896 Hz, reduced.
+#define CAPTURE_FPS_NUM         262144u
+#define CAPTURE_FPS_DEN         4389u
+
+#define CAPTURE_PIXELS          (GBA_SCREEN_WIDTH * GBA_SCREEN_HEIGHT)
+#define CAPTURE_Y4M_FRAME_TAG   "FRAME\n"
+#define CAPTURE_Y4M_FRAME_SIZE  (sizeof(CAPTURE_Y4M_FRAME_TAG) - 1 + CAPTURE_PIXELS * 3)
+
+// Maximum number of buffers gathered in a single `writev()`.
+#define CAPTURE_IOV_LEN         64
+
+#define CAPTURE_WAV_HEADER_SIZE 44
+
+static uint8_t const capture_silence[4096];
+
+/*
+** Buffers waiting to be written to a file descriptor with a single `writev()`.
+*/
+struct capture_iov {
+    int fd;
+    struct iovec iov[CAPTURE_IOV_LEN];
+    size_t len;
+    uint64_t written;               // Bytes written to `fd` so far.
+};
+
+/*
+** Write the buffers gathered in `out` and empty it.
+**
+** On error, the stream is abandoned (`fd` is set to -1) rather than retried, so a full disk
+** doesn't make the writer spin.
+*/
+static
+void
+capture_iov_flush(
+    struct gba *gba,
+    struct capture_iov *out
+) {
+    struct iovec *iov;
+    size_t len;
+
+    iov = out->iov;
+    len = out->len;
+    out->len = 0;
+
+    while (len && out->fd >= 0) {
+        ssize_t ret;
+
+        ret = writev(out->fd, iov, (int)len);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            logln(HS_ERROR, "Failed to write the capture: %s.", strerror(errno));
+            out->fd = -1;
+            break;
+        }
+
+        out->written += (size_t)ret;
+        atomic_fetch_add(&gba->shared_data.capture.bytes, (size_t)ret);
+
+        // Skip what was written, which may end in the middle of a buffer.
+        while (len && (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            ++iov;
+            --len;
+        }
+
+        if (len) {
+            iov->iov_base = (uint8_t *)iov->iov_base + ret;
+            iov->iov_len -= (size_t)ret;
+        }
+    }
+}
+
+static
+void
+capture_iov_push(
+    struct gba *gba,
+    struct capture_iov *out,
+    void const *data,
+    size_t size
+) {
+    if (out->fd < 0 || !size) {
+        return;
+    }
+
+    if (out->len == CAPTURE_IOV_LEN) {
+        capture_iov_flush(gba, out);
+    }
+
+    out->iov[out->len].iov_base = (void *)data;
+    out->iov[out->len].iov_len = size;
+    ++out->len;
+}
+
+static
+void
+capture_iov_push_silence(
+    struct gba *gba,
+    struct capture_iov *out,
+    uint64_t size
+) {
+    while (size) {
+        size_t chunk;
+
+        chunk = min(size, sizeof(capture_silence));
+        capture_iov_push(gba, out, capture_silence, chunk);
+        size -= chunk;
+    }
+}
+
+/*
+** Write a whole buffer, used for the headers.
+*/
+static
+void
+capture_write_all(
+    int fd,
+    void const *data,
+    size_t size
+) {
+    while (size) {
+        ssize_t ret;
+
+        ret = write(fd, data, size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            logln(HS_ERROR, "Failed to write the capture: %s.", strerror(errno));
+            return;
+        }
+        data = (uint8_t const *)data + ret;
+        size -= (size_t)ret;
+    }
+}
+
+/*
+** Convert a frame to a Y4M frame, with BT.601 limited-range 4:4:4 YCbCr.
+*/
+static
+void
+capture_convert_y4m(
+    uint8_t *out,
+    uint16_t const *pixels
+) {
+    uint8_t *y;
+    uint8_t *u;
+    uint8_t *v;
+    size_t i;
+
+    memcpy(out, CAPTURE_Y4M_FRAME_TAG, sizeof(CAPTURE_Y4M_FRAME_TAG) - 1);
+    y = out + sizeof(CAPTURE_Y4M_FRAME_TAG) - 1;
+    u = y + CAPTURE_PIXELS;
+    v = u + CAPTURE_PIXELS;
+
+    for (i = 0; i < CAPTURE_PIXELS; ++i) {
+        int32_t r;
+        int32_t g;
+        int32_t b;
+
+        r = (pixels[i] >> 0) & 0x1F;
+        g = (pixels[i] >> 5) & 0x1F;
+        b = (pixels[i] >> 10) & 0x1F;
+
+        // 5 to 8 bits
+        r = (r << 3) | (r >> 2);
+        g = (g << 3) | (g >> 2);
+        b = (b << 3) | (b >> 2);
+
+        y[i] = (uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+        u[i] = (uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+        v[i] = (uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+    }
+}
+
+/*
+** Body of the thread writing the blocks sent by the emulator.
+**
+** Blocks are taken in batches: everything sent since the last batch is written with as few
+** `writev()` as possible, and the blocks are only given back once the whole batch is on disk.
+*/
+static
+void *
+capture_thread(
+    void *arg
+) {
+    struct gba *gba;
+    struct capture *capture;
+    struct capture_iov video;
+    struct capture_iov audio;
+    struct capture_video_record *records;
+    uint8_t *y4m;
+    size_t y4m_last;
+    bool y4m_any;
+
+    gba = arg;
+    capture = &gba->capture;
+
+    memset(&video, 0, sizeof(video));
+    memset(&audio, 0, sizeof(audio));
+    video.fd = capture->video_fd;
+    audio.fd = capture->audio_fd;
+    audio.written = (audio.fd >= 0) ? CAPTURE_WAV_HEADER_SIZE : 0;
+
+    records = calloc(capture->blocks_len, sizeof(*records));
+    hs_assert(records);
+
+    // One converted frame per block, plus a copy of the last frame of the previous batch at the end.
+    y4m = NULL;
+    y4m_any = false;
+    if (capture->video_format == CAPTURE_VIDEO_Y4M) {
+        y4m = calloc(capture->blocks_len + 1, CAPTURE_Y4M_FRAME_SIZE);
+        hs_assert(y4m);
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    while (true) {
+        size_t head;
+        size_t len;
+        size_t i;
+
+        while (!capture->exit && !capture->len) {
+            pthread_cond_wait(&capture->cond, &capture->lock);
+        }
+
+        if (!capture->len) {
+            break;
+        }
+
+        head = capture->head;
+        len = capture->len;
+        pthread_mutex_unlock(&capture->lock);
+
+        y4m_last = capture->blocks_len;
+
+        for (i = 0; i < len; ++i) {
+            struct capture_block *block;
+            size_t idx;
+            uint32_t j;
+
+            idx = (head + i) % capture->blocks_len;
+            block = &capture->blocks[idx];
+
+            if (video.fd < 0) {
+                // Nothing to do, the video isn't recorded or can't be written anymore.
+            } else if (capture->video_format == CAPTURE_VIDEO_Y4M) {
+                // Repeat the last frame in place of the dropped ones, to keep the audio in sync.
+                for (j = 0; j < block->dropped_frames && y4m_any; ++j) {
+                    capture_iov_push(gba, &video, y4m + y4m_last * CAPTURE_Y4M_FRAME_SIZE, CAPTURE_Y4M_FRAME_SIZE);
+                }
+
+                if (block->has_frame) {
+                    if (block->changed || !y4m_any) {
+                        capture_convert_y4m(y4m + idx * CAPTURE_Y4M_FRAME_SIZE, block->pixels);
+                        y4m_last = idx;
+                        y4m_any = true;
+                    }
+                    capture_iov_push(gba, &video, y4m + y4m_last * CAPTURE_Y4M_FRAME_SIZE, CAPTURE_Y4M_FRAME_SIZE);
+                }
+            } else if (block->has_frame) {
+                records[idx].frame = block->frame;
+                records[idx].size = block->changed ? CAPTURE_PIXELS * sizeof(uint16_t) : 0;
+                capture_iov_push(gba, &video, &records[idx], sizeof(records[idx]));
+                if (block->changed) {
+                    capture_iov_push(gba, &video, block->pixels, CAPTURE_PIXELS * sizeof(uint16_t));
+                }
+            }
+
+            capture_iov_push_silence(gba, &audio, block->dropped_samples * sizeof(*block->samples));
+            capture_iov_push(gba, &audio, block->samples, block->samples_len * sizeof(*block->samples));
+        }
+
+        capture_iov_flush(gba, &video);
+        capture_iov_flush(gba, &audio);
+
+        // The buffers of this batch are about to be reused.
+        if (y4m && y4m_last != capture->blocks_len) {
+            memcpy(y4m + capture->blocks_len * CAPTURE_Y4M_FRAME_SIZE, y4m + y4m_last * CAPTURE_Y4M_FRAME_SIZE, CAPTURE_Y4M_FRAME_SIZE);
+        }
+
+        pthread_mutex_lock(&capture->lock);
+        capture->head = (head + len) % capture->blocks_len;
+        capture->len -= len;
+        pthread_cond_broadcast(&capture->cond);
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    free(records);
+    free(y4m);
+
+    // Patch the sizes of the WAV header, if the file can be seeked through.
+    if (audio.fd >= 0 && audio.written >= CAPTURE_WAV_HEADER_SIZE) {
+        uint32_t riff_size;
+        uint32_t data_size;
+
+        data_size = (uint32_t)min(audio.written - CAPTURE_WAV_HEADER_SIZE, (uint64_t)UINT32_MAX - 36);
+        riff_size = data_size + 36;
+        if (
+               pwrite(audio.fd, &riff_size, sizeof(riff_size), 4) != sizeof(riff_size)
+            || pwrite(audio.fd, &data_size, sizeof(data_size), 40) != sizeof(data_size)
+        ) {
+            logln(HS_INFO, "The sizes of the WAV header couldn't be updated: %s.", strerror(errno));
+        }
+    }
+
+    return (NULL);
+}
+
+/*
+** Write the headers of the streams. The sizes of the WAV header are unknown until the capture
+** stops, and are left to their maximum in case the file can't be seeked through.
+*/
+static
+void
+capture_write_headers(
+    struct capture *capture
+) {
+    if (capture->video_fd >= 0) {
+        if (capture->video_format == CAPTURE_VIDEO_Y4M) {
+            char header[128];
+            int len;
+
+            len = snprintf(
+                header,
+                sizeof(header),
+                "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n",
+                GBA_SCREEN_WIDTH,
+                GBA_SCREEN_HEIGHT,
+                CAPTURE_FPS_NUM,
+                CAPTURE_FPS_DEN
+            );
+            capture_write_all(capture->video_fd, header, (size_t)len);
+        } else {
+            struct capture_video_header header;
+
+            memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+            header.version = CAPTURE_VERSION;
+            header.width = GBA_SCREEN_WIDTH;
+            header.height = GBA_SCREEN_HEIGHT;
+            header.fps_num = CAPTURE_FPS_NUM;
+            header.fps_den = CAPTURE_FPS_DEN;
+            capture_write_all(capture->video_fd, &header, sizeof(header));
+        }
+    }
+
+    if (capture->audio_fd >= 0) {
+        uint8_t header[CAPTURE_WAV_HEADER_SIZE];
+        uint32_t u32;
+        uint16_t u16;
+
+        memcpy(header + 0, "RIFF", 4);
+        u32 = UINT32_MAX;                   memcpy(header + 4, &u32, 4);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        u32 = 16;                           memcpy(header + 16, &u32, 4);
+        u16 = 1;                            memcpy(header + 20, &u16, 2);   // PCM
+        u16 = 2;                            memcpy(header + 22, &u16, 2);   // Channels
+        u32 = capture->audio_rate;          memcpy(header + 24, &u32, 4);
+        u32 = capture->audio_rate * 4;      memcpy(header + 28, &u32, 4);   // Bytes per second
+        u16 = 4;                            memcpy(header + 32, &u16, 2);   // Bytes per sample
+        u16 = 16;                           memcpy(header + 34, &u16, 2);   // Bits per channel
+        memcpy(header + 36, "data", 4);
+        u32 = UINT32_MAX;                   memcpy(header + 40, &u32, 4);
+
+        capture_write_all(capture->audio_fd, header, sizeof(header));
+    }
+}
+
+/*
+** Take the next free block for the emulator to fill, waiting for one if the policy says so.
+*/
+static
+void
+capture_acquire(
+    struct capture *capture
+) {
+    struct capture_block *block;
+
+    pthread_mutex_lock(&capture->lock);
+    if (capture->policy == CAPTURE_POLICY_WAIT) {
+        while (capture->len == capture->blocks_len) {
+            pthread_cond_wait(&capture->cond, &capture->lock);
+        }
+    }
+
+    if (capture->len == capture->blocks_len) {
+        capture->current = NULL;
+    } else {
+        block = &capture->blocks[(capture->head + capture->len) % capture->blocks_len];
+        block->has_frame = false;
+        block->changed = false;
+        block->samples_len = 0;
+        block->dropped_frames = capture->dropped_frames;
+        block->dropped_samples = capture->dropped_samples;
+        capture->dropped_frames = 0;
+        capture->dropped_samples = 0;
+        capture->current = block;
+    }
+    pthread_mutex_unlock(&capture->lock);
+}
+
+/*
+** Send the block being filled to the writer and take the next one.
+*/
+static
+void
+capture_submit(
+    struct capture *capture
+) {
+    pthread_mutex_lock(&capture->lock);
+    ++capture->len;
+    pthread_cond_broadcast(&capture->cond);
+    pthread_mutex_unlock(&capture->lock);
+
+    capture_acquire(capture);
+}
+
+/*
+** Start recording to the file descriptors given in `config`, if any.
+**
+** A capture spans a single `gba_state_reset()`: resetting the emulation ends it, and starts a
+** new one with the new configuration.
+*/
+void
+capture_start(
+    struct gba *gba,
+    struct launch_config const *config
+) {
+    struct capture *capture;
+    size_t i;
+
+    capture = &gba->capture;
+
+    capture_stop(gba);
+
+    capture->video_fd = config->capture.video_fd;
+    capture->audio_fd = config->audio_frequency ? config->capture.audio_fd : -1;
+
+    if (capture->video_fd < 0 && capture->audio_fd < 0) {
+        return;
+    }
+
+    capture->video_format = config->capture.video_format;
+    capture->policy = config->capture.policy;
+    // `audio_frequency` is the number of cycles between two samples.
+    capture->audio_rate = (GBA_CYCLES_PER_SECOND + config->audio_frequency / 2) / max(config->audio_frequency, 1u);
+    capture->frame = 0;
+    capture->dropped_frames = 0;
+    capture->dropped_samples = 0;
+    capture->frame_dropped = false;
+    capture->head = 0;
+    capture->len = 0;
+    capture->exit = false;
+
+    // Twice the samples of a frame, so that a block is only sent early if the frames stop coming.
+    capture->samples_size = (size_t)GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH * GBA_SCREEN_REAL_HEIGHT / max(config->audio_frequency, 1u) * 2 + 64;
+    capture->blocks_len = config->capture.blocks ? config->capture.blocks : CAPTURE_DEFAULT_BLOCKS;
+    capture->blocks = calloc(capture->blocks_len, sizeof(struct capture_block));
+    hs_assert(capture->blocks);
+
+    for (i = 0; i < capture->blocks_len; ++i) {
+        capture->blocks[i].pixels = malloc(CAPTURE_PIXELS * sizeof(uint16_t));
+        capture->blocks[i].samples = malloc(capture->samples_size * sizeof(*capture->blocks[i].samples));
+        hs_assert(capture->blocks[i].pixels && capture->blocks[i].samples);
+    }
+
+    capture_write_headers(capture);
+
+    if (pthread_create(&capture->thread, NULL, capture_thread, gba)) {
+        logln(HS_ERROR, "Failed to start the capture thread.");
+        for (i = 0; i < capture->blocks_len; ++i) {
+            free(capture->blocks[i].pixels);
+            free(capture->blocks[i].samples);
+        }
+        free(capture->blocks);
+        capture->blocks = NULL;
+        return;
+    }
+
+    capture_acquire(capture);
+    capture->enabled = true;
+}
+
+/*
+** Write what was captured so far and stop the capture thread.
+*/
+void
+capture_stop(
+    struct gba *gba
+) {
+    struct capture *capture;
+    size_t i;
+
+    capture = &gba->capture;
+
+    if (!capture->enabled) {
+        return;
+    }
+
+    // Wait for a block to tell the writer about the samples produced since the last frame and
+    // about what was dropped.
+    if (!capture->current && (capture->dropped_frames || capture->dropped_samples)) {
+        capture->policy = CAPTURE_POLICY_WAIT;
+        capture_acquire(capture);
+    }
+
+    if (capture->current && (capture->current->samples_len || capture->current->dropped_frames || capture->current->dropped_samples)) {
+        capture_submit(capture);
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    capture->exit = true;
+    pthread_cond_broadcast(&capture->cond);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+
+    for (i = 0; i < capture->blocks_len; ++i) {
+        free(capture->blocks[i].pixels);
+        free(capture->blocks[i].samples);
+    }
+    free(capture->blocks);
+    capture->blocks = NULL;
+    capture->blocks_len = 0;
+    capture->current = NULL;
+    capture->enabled = false;
+}
+
+/*
+** Called when a frame is published, with `changed` unset if it is the same as the previous one.
+*/
+void
+capture_frame(
+    struct gba *gba,
+    bool changed
+) {
+    struct capture *capture;
+    struct capture_block *block;
+
+    capture = &gba->capture;
+    block = capture->current;
+
+    if (!block) {
+        ++capture->dropped_frames;
+        atomic_fetch_add(&gba->shared_data.capture.dropped, 1);
+
+        // Dropping a frame means the next one must be sent whole.
+        capture->frame_dropped = true;
+        ++capture->frame;
+        capture_acquire(capture);
+        return;
+    }
+
+    changed = changed || capture->frame_dropped || !capture->frame;
+    capture->frame_dropped = false;
+
+    block->has_frame = true;
+    block->frame = capture->frame++;
+    block->changed = changed;
+
+    if (changed && capture->video_fd >= 0) {
+        memcpy(block->pixels, gba->shared_data.framebuffer.data, CAPTURE_PIXELS * sizeof(uint16_t));
+    }
+
+    atomic_fetch_add(&gba->shared_data.capture.frames, 1);
+    if (!changed) {
+        atomic_fetch_add(&gba->shared_data.capture.duplicates, 1);
+    }
+
+    capture_submit(capture);
+}
+
+/*
+** Called for each sample sent to the frontend.
+*/
+void
+capture_audio(
+    struct gba *gba,
+    int16_t left,
+    int16_t right
+) {
+    struct capture *capture;
+    struct capture_block *block;
+
+    capture = &gba->capture;
+    block = capture->current;
+
+    if (capture->audio_fd < 0) {
+        return;
+    }
+
+    if (!block) {
+        ++capture->dropped_samples;
+        return;
+    }
+
+    block->samples[block->samples_len][0] = left;
+    block->samples[block->samples_len][1] = right;
+    ++block->samples_len;
+
+    if (block->samples_len == capture->samples_size) {
+        capture_submit(capture);
+    }
+}
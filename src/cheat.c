@@ -0,0 +1,535 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "gba/gba.h"
+
+/*
+** Read a token of exactly `digits` hexadecimal digits at `*str`, skipping the whitespace before it.
+*/
+static
+bool
+cheat_parse_hex(
+    char const **str,
+    size_t digits,
+    uint32_t *value
+) {
+    char const *s;
+    size_t i;
+
+    s = *str;
+    while (isspace((unsigned char)*s)) {
+        ++s;
+    }
+
+    *value = 0;
+    for (i = 0; i < digits; ++i) {
+        if (!isxdigit((unsigned char)s[i])) {
+            return (false);
+        }
+        *value = (*value << 4) | (uint32_t)(isdigit((unsigned char)s[i]) ? s[i] - '0' : (tolower((unsigned char)s[i]) - 'a' + 10));
+    }
+
+    if (s[digits] && !isspace((unsigned char)s[digits])) {
+        return (false);
+    }
+
+    *str = s + digits;
+    return (true);
+}
+
+/*
+** Return the offset of `addr` in `struct memory` if it lies in EWRAM or IWRAM, where nearly all
+** cheats write, or -1.
+*/
+static
+int32_t
+cheat_memory_offset(
+    uint32_t addr
+) {
+    switch (addr >> 24) {
+        case EWRAM_REGION:      return ((int32_t)(offsetof(struct memory, ewram) + (addr & EWRAM_MASK)));
+        case IWRAM_REGION:      return ((int32_t)(offsetof(struct memory, iwram) + (addr & IWRAM_MASK)));
+        default:                return (-1);
+    }
+}
+
+static
+void
+cheat_list_push_op(
+    struct cheat_list *list,
+    enum cheat_op_kinds kind,
+    uint32_t addr,
+    uint32_t value
+) {
+    struct cheat_op *op;
+
+    // Align the address like the bus does.
+    switch (kind) {
+        case CHEAT_OP_WRITE8:   break;
+        case CHEAT_OP_WRITE32:  addr &= ~3u; break;
+        default:                addr &= ~1u; break;
+    }
+
+    list->ops = realloc(list->ops, (list->ops_len + 1) * sizeof(*list->ops));
+    hs_assert(list->ops);
+
+    op = &list->ops[list->ops_len++];
+    op->kind = kind;
+    op->addr = addr;
+    op->offset = cheat_memory_offset(addr);
+    op->value = value;
+}
+
+static
+void
+cheat_list_push_patch(
+    struct cheat_list *list,
+    uint32_t offset,
+    uint16_t value
+) {
+    list->patches = realloc(list->patches, (list->patches_len + 1) * sizeof(*list->patches));
+    hs_assert(list->patches);
+
+    list->patches[list->patches_len].offset = offset & ~1u;
+    list->patches[list->patches_len].value = value;
+    list->patches[list->patches_len].original = 0;
+    ++list->patches_len;
+}
+
+static
+void
+cheat_list_free(
+    struct cheat_list *list
+) {
+    free(list->ops);
+    free(list->patches);
+    memset(list, 0, sizeof(*list));
+}
+
+/*
+** Compile one line of a decrypted GameShark / Action Replay v1-v2 code.
+*/
+static
+bool
+cheat_compile_gameshark(
+    struct cheat_list *list,
+    uint32_t op1,
+    uint32_t op2
+) {
+    uint32_t addr;
+
+    // Changes the encryption seed of the following lines, which would otherwise be taken for a conditional.
+    if (op1 == 0xDEADFACE) {
+        logln(HS_ERROR, "Encrypted GameShark / Action Replay codes aren't supported, decrypt them first.");
+        return (false);
+    }
+
+    addr = op1 & 0x0FFFFFFF;
+    switch (op1 >> 28) {
+        case 0x0:   cheat_list_push_op(list, CHEAT_OP_WRITE8, addr, op2 & 0xFF); break;
+        case 0x1:   cheat_list_push_op(list, CHEAT_OP_WRITE16, addr, op2 & 0xFFFF); break;
+        case 0x2:   cheat_list_push_op(list, CHEAT_OP_WRITE32, addr, op2); break;
+        case 0x6:   cheat_list_push_patch(list, (op1 & 0x00FFFFFF) << 1, op2 & 0xFFFF); break;
+        case 0xD:   cheat_list_push_op(list, CHEAT_OP_IF_EQ16, addr, op2 & 0xFFFF); break;
+        case 0xF:   break; // Hook of the master code, only meaningful to the real device.
+        default:    return (false);
+    }
+    return (true);
+}
+
+/*
+** Compile one line of an unencrypted CodeBreaker code.
+*/
+static
+bool
+cheat_compile_codebreaker(
+    struct cheat_list *list,
+    uint32_t op1,
+    uint32_t op2
+) {
+    uint32_t addr;
+
+    addr = op1 & 0x0FFFFFFF;
+    switch (op1 >> 28) {
+        case 0x0:
+        case 0x1:   break; // Master code and ID, only meaningful to the real device.
+        case 0x2:   cheat_list_push_op(list, CHEAT_OP_OR16, addr, op2); break;
+        case 0x3:   cheat_list_push_op(list, CHEAT_OP_WRITE8, addr, op2 & 0xFF); break;
+        case 0x6:   cheat_list_push_op(list, CHEAT_OP_AND16, addr, op2); break;
+        case 0x7:   cheat_list_push_op(list, CHEAT_OP_IF_EQ16, addr, op2); break;
+        case 0x8:   cheat_list_push_op(list, CHEAT_OP_WRITE16, addr, op2); break;
+        case 0xA:   cheat_list_push_op(list, CHEAT_OP_IF_NE16, addr, op2); break;
+        case 0xE:   cheat_list_push_op(list, CHEAT_OP_ADD16, addr, op2); break;
+        default:    return (false); // Including 9, which turns on the encryption of the following lines.
+    }
+    return (true);
+}
+
+static inline
+bool
+cheat_op_is_conditional(
+    struct cheat_op const *op
+) {
+    return (op->kind == CHEAT_OP_IF_EQ16 || op->kind == CHEAT_OP_IF_NE16);
+}
+
+/*
+** Compile the lines of `cheat`.
+**
+** A conditional skips the next operation of `list->ops`, so the line following it must compile
+** to exactly one. ROM patches, which are applied once, and lines ignored by the emulator can't
+** be made conditional.
+*/
+static
+bool
+cheat_compile(
+    struct cheat_list *list,
+    struct cheat const *cheat
+) {
+    char const *s;
+    bool conditional;
+
+    s = cheat->code;
+    conditional = false;
+    while (true) {
+        uint32_t op1;
+        uint32_t op2;
+        size_t ops_len;
+        bool ok;
+
+        while (isspace((unsigned char)*s)) {
+            ++s;
+        }
+
+        if (!*s) {
+            if (conditional) {
+                logln(HS_ERROR, "Cheat code ending with a conditional.");
+                return (false);
+            }
+            return (true);
+        }
+
+        ops_len = list->ops_len;
+
+        switch (cheat->format) {
+            case CHEAT_GAMESHARK: {
+                ok = cheat_parse_hex(&s, 8, &op1)
+                    && cheat_parse_hex(&s, 8, &op2)
+                    && cheat_compile_gameshark(list, op1, op2)
+                ;
+                break;
+            };
+            case CHEAT_CODEBREAKER: {
+                ok = cheat_parse_hex(&s, 8, &op1)
+                    && cheat_parse_hex(&s, 4, &op2)
+                    && cheat_compile_codebreaker(list, op1, op2)
+                ;
+                break;
+            };
+            default: {
+                ok = false;
+                break;
+            };
+        }
+
+        if (!ok) {
+            logln(HS_ERROR, "Invalid or unsupported cheat code near \"%.16s\".", s);
+            return (false);
+        }
+
+        if (conditional && list->ops_len != ops_len + 1) {
+            logln(HS_ERROR, "A cheat code conditional must be followed by a RAM operation, near \"%.16s\".", s);
+            return (false);
+        }
+
+        conditional = (list->ops_len == ops_len + 1) && cheat_op_is_conditional(&list->ops[ops_len]);
+    }
+}
+
+/*
+** Replace the cheats with the given ones. The emulator picks them up at the next VBlank.
+**
+** The list survives resets, so clear it before loading another game.
+** Return false, leaving the cheats untouched, if one of them is invalid or uses an unsupported
+** type of code.
+*/
+bool
+cheat_set(
+    struct gba *gba,
+    struct cheat const *cheats,
+    size_t len
+) {
+    struct cheat_engine *engine;
+    struct cheat_list list;
+    size_t i;
+
+    memset(&list, 0, sizeof(list));
+    for (i = 0; i < len; ++i) {
+        if (!cheat_compile(&list, &cheats[i])) {
+            cheat_list_free(&list);
+            return (false);
+        }
+    }
+
+    engine = &gba->cheats;
+
+    pthread_mutex_lock(&engine->lock);
+    cheat_list_free(&engine->pending);
+    engine->pending = list;
+    atomic_store(&engine->changed, true);
+    atomic_store(&engine->enabled, true);
+    pthread_mutex_unlock(&engine->lock);
+
+    return (true);
+}
+
+void
+cheat_init(
+    struct gba *gba
+) {
+    pthread_mutex_init(&gba->cheats.lock, NULL);
+    atomic_init(&gba->cheats.enabled, false);
+    atomic_init(&gba->cheats.changed, false);
+}
+
+void
+cheat_release(
+    struct gba *gba
+) {
+    cheat_list_free(&gba->cheats.pending);
+    cheat_list_free(&gba->cheats.active);
+    atomic_store(&gba->cheats.enabled, false);
+}
+
+/*
+** Forget about the ROM patches applied to the previous ROM. They are applied again to the new one.
+*/
+void
+cheat_reset(
+    struct gba *gba
+) {
+    gba->cheats.patched = false;
+}
+
+/*
+** Make the bytes `[offset; offset + 2)` of the ROM writable.
+**
+** A ROM mapped from a file is a private mapping: the kernel copies the pages on their first
+** write, and the others keep pointing to the page cache. A ROM given as a buffer belongs to the
+** frontend and is copied to a private mapping first.
+*/
+static
+bool
+cheat_rom_make_writable(
+    struct gba *gba,
+    uint32_t offset
+) {
+    struct rom_view *rom;
+    uintptr_t page_size;
+    uintptr_t start;
+    uintptr_t end;
+
+    rom = &gba->memory.rom;
+
+    if (!rom->mapping_base) {
+        void *mapping;
+
+        mapping = mmap(NULL, rom->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            logln(HS_ERROR, "Failed to copy the ROM to patch it: %s", strerror(errno));
+            return (false);
+        }
+
+        memcpy(mapping, rom->data, rom->size);
+        rom->data = mapping;
+        rom->mapping_base = mapping;
+        rom->mapping_size = rom->size;
+        return (true);
+    }
+
+    page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+    start = ((uintptr_t)rom->data + offset) & ~(page_size - 1);
+    end = (uintptr_t)rom->data + offset + sizeof(uint16_t);
+    if (mprotect((void *)start, end - start, PROT_READ | PROT_WRITE)) {
+        logln(HS_ERROR, "Failed to make the ROM writable to patch it: %s", strerror(errno));
+        return (false);
+    }
+    return (true);
+}
+
+static
+void
+cheat_apply_patches(
+    struct gba *gba,
+    struct cheat_list *list
+) {
+    size_t i;
+
+    for (i = 0; i < list->patches_len; ++i) {
+        struct cheat_rom_patch *patch;
+
+        patch = &list->patches[i];
+        if (patch->offset + sizeof(uint16_t) > gba->memory.rom.size || !cheat_rom_make_writable(gba, patch->offset)) {
+            logln(HS_WARNING, "Cannot patch the ROM at 0x%08x.", CART_0_START + patch->offset);
+            patch->offset = UINT32_MAX;
+            continue;
+        }
+
+        memcpy(&patch->original, gba->memory.rom.data + patch->offset, sizeof(uint16_t));
+        memcpy((uint8_t *)gba->memory.rom.data + patch->offset, &patch->value, sizeof(uint16_t));
+    }
+}
+
+static
+void
+cheat_revert_patches(
+    struct gba *gba,
+    struct cheat_list const *list
+) {
+    size_t i;
+
+    // Reverted in reverse order in case two patches overlap.
+    for (i = list->patches_len; i > 0; --i) {
+        struct cheat_rom_patch const *patch;
+
+        patch = &list->patches[i - 1];
+        if (patch->offset != UINT32_MAX) {
+            memcpy((uint8_t *)gba->memory.rom.data + patch->offset, &patch->original, sizeof(uint16_t));
+        }
+    }
+}
+
+/*
+** Mark the page written by `op` as dirty for the state digest, like `template_write()` does.
+**
+** Only needed when `op->offset` is set. The address is aligned, so the write never crosses a page.
+*/
+static inline
+void
+cheat_mark_dirty(
+    struct gba *gba,
+    struct cheat_op const *op
+) {
+    if ((op->addr >> 24) == EWRAM_REGION) {
+        gba->digest.dirty.ewram[(op->addr & EWRAM_MASK) >> DIGEST_PAGE_SHIFT] = true;
+    } else {
+        gba->digest.dirty.iwram[(op->addr & IWRAM_MASK) >> DIGEST_PAGE_SHIFT] = true;
+    }
+}
+
+static inline
+uint16_t
+cheat_read16(
+    struct gba *gba,
+    struct cheat_op const *op
+) {
+    uint16_t val;
+
+    if (op->offset < 0) {
+        return (mem_read16_raw(gba, op->addr));
+    }
+    memcpy(&val, (uint8_t *)&gba->memory + op->offset, sizeof(val));
+    return (val);
+}
+
+static inline
+void
+cheat_write16(
+    struct gba *gba,
+    struct cheat_op const *op,
+    uint16_t val
+) {
+    if (op->offset < 0) {
+        mem_write16_raw(gba, op->addr, val);
+    } else {
+        memcpy((uint8_t *)&gba->memory + op->offset, &val, sizeof(val));
+        cheat_mark_dirty(gba, op);
+    }
+}
+
+/*
+** Run the cheats, picking up the list set by `cheat_set()` if it changed.
+**
+** Called at the start of each VBlank while `enabled` is set, including when running ahead so
+** the frames shown match the ones the real timeline will produce. The list and the ROM patches
+** only change on the real timeline, since the ROM isn't part of the state restored afterwards.
+*/
+void
+cheat_frame(
+    struct gba *gba
+) {
+    struct cheat_engine *engine;
+    struct cheat_list const *list;
+    size_t i;
+
+    engine = &gba->cheats;
+
+    if (!gba->run_ahead.speculating && atomic_load(&engine->changed)) {
+        pthread_mutex_lock(&engine->lock);
+        if (engine->patched) {
+            cheat_revert_patches(gba, &engine->active);
+        }
+        cheat_list_free(&engine->active);
+        engine->active = engine->pending;
+        memset(&engine->pending, 0, sizeof(engine->pending));
+        atomic_store(&engine->changed, false);
+        engine->patched = false;
+        atomic_store(&engine->enabled, engine->active.ops_len || engine->active.patches_len);
+        pthread_mutex_unlock(&engine->lock);
+    }
+
+    if (!gba->run_ahead.speculating && !engine->patched) {
+        cheat_apply_patches(gba, &engine->active);
+        engine->patched = true;
+    }
+
+    list = &engine->active;
+    for (i = 0; i < list->ops_len; ++i) {
+        struct cheat_op const *op;
+
+        op = &list->ops[i];
+        switch (op->kind) {
+            case CHEAT_OP_WRITE8: {
+                if (op->offset < 0) {
+                    mem_write8_raw(gba, op->addr, (uint8_t)op->value);
+                } else {
+                    ((uint8_t *)&gba->memory)[op->offset] = (uint8_t)op->value;
+                    cheat_mark_dirty(gba, op);
+                }
+                break;
+            };
+            case CHEAT_OP_WRITE16:  cheat_write16(gba, op, (uint16_t)op->value); break;
+            case CHEAT_OP_WRITE32: {
+                if (op->offset < 0) {
+                    mem_write32_raw(gba, op->addr, op->value);
+                } else {
+                    memcpy((uint8_t *)&gba->memory + op->offset, &op->value, sizeof(uint32_t));
+                    cheat_mark_dirty(gba, op);
+                }
+                break;
+            };
+            case CHEAT_OP_OR16:     cheat_write16(gba, op, cheat_read16(gba, op) | (uint16_t)op->value); break;
+            case CHEAT_OP_AND16:    cheat_write16(gba, op, cheat_read16(gba, op) & (uint16_t)op->value); break;
+            case CHEAT_OP_ADD16:    cheat_write16(gba, op, cheat_read16(gba, op) + (uint16_t)op->value); break;
+            case CHEAT_OP_IF_EQ16:  i += (cheat_read16(gba, op) != (uint16_t)op->value); break;
+            case CHEAT_OP_IF_NE16:  i += (cheat_read16(gba, op) == (uint16_t)op->value); break;
+        }
+    }
+}
@@ -25,6 +25,8 @@ core_arm_bdt(
     uint32_t rn;
     uint32_t base;
     uint32_t base_new;
+    uint32_t *ram;
+    uint32_t k;
     int32_t count;
     enum arm_modes mode_old;
     bool mode_switch;
@@ -47,12 +49,7 @@ core_arm_bdt(
     ** Count how many registers we are going to transfer
     */
 
-    i = 0;
-    count = 0;
-    while (i < 16) {
-        count += (bitfield_get(op, i));
-        ++i;
-    }
+    count = __builtin_popcount(op & 0xFFFF);
 
     /*
     ** Edge case: if rlist is empty, transfer the pc but
@@ -98,7 +95,15 @@ core_arm_bdt(
         mode_switch = false;
     }
 
+    /*
+    ** Fast path: when the whole block is in IWRAM/EWRAM, the timing is computed once and
+    ** the words are copied straight from/to the host memory.
+    ** Loads end with an internal cycle, which must be accounted for.
+    */
+    ram = mem_ram_bulk_access32(gba, base + (pre ? 4 : 0), __builtin_popcount(op & 0xFFFF), load ? 1 : 0, !load);
+
     i = 0;
+    k = 0;
     first = true;
     access_type = NON_SEQUENTIAL;
     while (i < 16) {
@@ -111,9 +116,13 @@ core_arm_bdt(
                     first = false;
                 }
 
-                core->registers[i] = mem_read32(gba, base, access_type);
+                core->registers[i] = ram ? ram[k++] : mem_read32(gba, base, access_type);
             } else {
-                mem_write32(gba, base, core->registers[i], access_type);
+                if (ram) {
+                    ram[k++] = core->registers[i];
+                } else {
+                    mem_write32(gba, base, core->registers[i], access_type);
+                }
 
                 if (first && wb) { // Write back after data is stored
                     core->registers[rn] = base_new;
@@ -29,6 +29,73 @@
 #include "gba/core/thumb.h"
 #include "gba/core/helpers.h"
 
+/*
+** Fetch, decode and execute the next instruction, assuming the core is running.
+**
+** The instruction is fetched with `fetch16` or `fetch32`, which are always known at compile time
+** so each caller gets its own copy of this function, specialised for these accessors.
+*/
+static ALWAYS_INLINE
+void
+core_step_template(
+    struct gba *gba,
+    uint16_t (*fetch16)(struct gba *, uint32_t, enum access_types),
+    uint32_t (*fetch32)(struct gba *, uint32_t, enum access_types)
+) {
+    struct core *core;
+
+    core = &gba->core;
+
+    if (core->cpsr.thumb) {
+        uint16_t op;
+
+        op = core->prefetch[0];
+        core->prefetch[0] = core->prefetch[1];
+        core->prefetch[1] = fetch16(gba, core->pc, core->prefetch_access_type);
+        gba->memory.was_last_access_from_dma = false;
+
+        // Build a unique index based on the instruction's opcode, which is then used to index
+        // the Lookup Table (LUT) of Thumb instructions.
+        //
+        // NOTE: We need to properly handle unknown instructions instead of crashing.
+        if (unlikely(thumb_lut[op >> 8] == NULL)) {
+            panic(HS_CORE, "Unknown Thumb op-code 0x%04x (pc=0x%08x).", op, core->pc);
+        }
+
+        thumb_lut[op >> 8](gba, op);
+    } else {
+        size_t idx;
+        uint32_t op;
+
+        op = core->prefetch[0];
+        core->prefetch[0] = core->prefetch[1];
+        core->prefetch[1] = fetch32(gba, core->pc, core->prefetch_access_type);
+        gba->memory.was_last_access_from_dma = false;
+
+        // Test if the conditions required to execute the instruction are met using a Lookup Table (LUT).
+        //
+        // The index of the LUT is both the CPSR and the condition combined in an 8-bit integer
+        // unique per situation.
+        idx = (bitfield_get_range(core->cpsr.raw, 28, 32) << 4) | (bitfield_get_range(op, 28, 32));
+        if (unlikely(!cond_lut[idx])) {
+            core->pc += 4;
+            core->prefetch_access_type = SEQUENTIAL;
+            return;
+        }
+
+        // Build a unique index based on the instruction's opcode, which is then used to index
+        // the Lookup Table (LUT) of ARM instructions.
+        //
+        // NOTE: We need to properly handle unknown instructions instead of crashing.
+        idx = ((op >> 16) & 0xFF0) | ((op >> 4) & 0x00F);
+        if (unlikely(arm_lut[idx] == NULL)) {
+            panic(HS_CORE, "Unknown ARM op-code 0x%08x (pc=0x%08x).", op, core->pc);
+        }
+
+        arm_lut[idx](gba, op);
+    }
+}
+
 /*
 ** Fetch, decode and execute the next instruction.
 **
@@ -56,54 +123,7 @@ core_next(
     }
 
     if (likely(core->state == CORE_RUN)) {
-        if (core->cpsr.thumb) {
-            uint16_t op;
-
-            op = core->prefetch[0];
-            core->prefetch[0] = core->prefetch[1];
-            core->prefetch[1] = mem_read16(gba, core->pc, core->prefetch_access_type);
-            gba->memory.was_last_access_from_dma = false;
-
-            // Build a unique index based on the instruction's opcode, which is then used to index
-            // the Lookup Table (LUT) of Thumb instructions.
-            //
-            // NOTE: We need to properly handle unknown instructions instead of crashing.
-            if (unlikely(thumb_lut[op >> 8] == NULL)) {
-                panic(HS_CORE, "Unknown Thumb op-code 0x%04x (pc=0x%08x).", op, core->pc);
-            }
-
-            thumb_lut[op >> 8](gba, op);
-        } else {
-            size_t idx;
-            uint32_t op;
-
-            op = core->prefetch[0];
-            core->prefetch[0] = core->prefetch[1];
-            core->prefetch[1] = mem_read32(gba, core->pc, core->prefetch_access_type);
-            gba->memory.was_last_access_from_dma = false;
-
-            // Test if the conditions required to execute the instruction are met using a Lookup Table (LUT).
-            //
-            // The index of the LUT is both the CPSR and the condition combined in an 8-bit integer
-            // unique per situation.
-            idx = (bitfield_get_range(core->cpsr.raw, 28, 32) << 4) | (bitfield_get_range(op, 28, 32));
-            if (unlikely(!cond_lut[idx])) {
-                core->pc += 4;
-                core->prefetch_access_type = SEQUENTIAL;
-                goto end;
-            }
-
-            // Build a unique index based on the instruction's opcode, which is then used to index
-            // the Lookup Table (LUT) of ARM instructions.
-            //
-            // NOTE: We need to properly handle unknown instructions instead of crashing.
-            idx = ((op >> 16) & 0xFF0) | ((op >> 4) & 0x00F);
-            if (unlikely(arm_lut[idx] == NULL)) {
-                panic(HS_CORE, "Unknown ARM op-code 0x%08x (pc=0x%08x).", op, core->pc);
-            }
-
-            arm_lut[idx](gba, op);
-        }
+        core_step_template(gba, mem_read16, mem_read32);
     } else if (core->state == CORE_HALT) {
         if (gba->scheduler.next_event > gba->scheduler.cycles) {
             core_idle_for(gba, gba->scheduler.next_event - gba->scheduler.cycles);
@@ -112,14 +132,92 @@ core_next(
         }
     }
 
-end:
 #ifdef WITH_DEBUGGER
     debugger_eval_breakpoints(gba);
-#else
-    (void)0;
 #endif
 }
 
+/*
+** Execute instructions back to back until the scheduler's cycle counter reaches `run_limit`.
+**
+** Nothing is checked in between two instructions: whatever `core_next()` would have to
+** handle (a raised IRQ line, a change of state, a debugger stop) must call
+** `sched_raise_attention()`, which ends this loop after the current instruction.
+**
+** The caller must ensure none of those conditions are already pending.
+**
+** One variant of this loop is generated per combination of the settings tested when fetching
+** an instruction, and `core_select_variant()` picks the one matching the current configuration.
+*/
+#define DEFINE_CORE_RUN(name, fetch16, fetch32)                                             \
+    static                                                                                  \
+    void                                                                                    \
+    name(                                                                                   \
+        struct gba *gba                                                                     \
+    ) {                                                                                     \
+        struct scheduler const *scheduler;                                                  \
+                                                                                            \
+        scheduler = &gba->scheduler;                                                        \
+        while (scheduler->cycles < scheduler->run_limit) {                                  \
+            core_step_template(gba, (fetch16), (fetch32));                                  \
+        }                                                                                   \
+    }
+
+DEFINE_CORE_RUN(core_run_prefetch_eeprom, mem_fetch16_prefetch_eeprom, mem_fetch32_prefetch_eeprom)
+DEFINE_CORE_RUN(core_run_prefetch, mem_fetch16_prefetch, mem_fetch32_prefetch)
+DEFINE_CORE_RUN(core_run_eeprom, mem_fetch16_eeprom, mem_fetch32_eeprom)
+DEFINE_CORE_RUN(core_run_plain, mem_fetch16, mem_fetch32)
+
+#ifdef WITH_DEBUGGER
+// Used when watchpoints are set, as instruction fetches must be checked against them.
+DEFINE_CORE_RUN(core_run_debugger, mem_read16, mem_read32)
+#endif
+
+// Indexed by whether the prefetch buffer is enabled, then whether the game uses an EEPROM.
+static void (* const core_run_variants[2][2])(struct gba *gba) = {
+    [false] = {
+        [false] = core_run_plain,
+        [true] = core_run_eeprom,
+    },
+    [true] = {
+        [false] = core_run_prefetch,
+        [true] = core_run_prefetch_eeprom,
+    },
+};
+
+/*
+** Pick the variant of `core_run()` matching the current configuration.
+**
+** Must be called whenever the prefetch buffer is enabled or disabled, the backup storage type
+** changes or the debugger's watchpoints are updated.
+*/
+void
+core_select_variant(
+    struct gba *gba
+) {
+    bool eeprom;
+
+    eeprom = (
+        gba->memory.backup_storage.type == BACKUP_EEPROM_4K
+        || gba->memory.backup_storage.type == BACKUP_EEPROM_64K
+    );
+
+    gba->run_variant = core_run_variants[gba->memory.pbuffer.enabled][eeprom];
+
+#ifdef WITH_DEBUGGER
+    if (gba->debugger.watchpoints.len) {
+        gba->run_variant = core_run_debugger;
+    }
+#endif
+}
+
+void
+core_run(
+    struct gba *gba
+) {
+    gba->run_variant(gba);
+}
+
 void
 core_idle(
     struct gba *gba
@@ -464,6 +562,10 @@ core_update_irq_line(
     struct event_args args
 ) {
     gba->core.irq_line = (bool)args.a1.u32;
+
+    if (gba->core.irq_line) {
+        sched_raise_attention(gba);
+    }
 }
 
 void
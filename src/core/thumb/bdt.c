@@ -24,6 +24,8 @@ core_thumb_push(
     uint16_t op
 ) {
     struct core *core;
+    uint32_t count;
+    uint32_t *ram;
     ssize_t i;
 
     core = &gba->core;
@@ -37,6 +39,24 @@ core_thumb_push(
         return;
     }
 
+    /* Fast path: the stack is in IWRAM/EWRAM, store all the registers at once */
+    count = __builtin_popcount(op & 0x1FF);
+    ram = mem_ram_bulk_access32(gba, core->sp - count * 4, count, 0, true);
+    if (ram) {
+        for (i = 0; i < 8; ++i) {
+            if (bitfield_get(op, i)) {
+                *ram++ = core->registers[i];
+            }
+        }
+
+        if (bitfield_get(op, 8)) {
+            *ram = core->lr;
+        }
+
+        core->sp -= count * 4;
+        return;
+    }
+
     /* Push LR */
     if (bitfield_get(op, 8)) {
         core->sp -= 4;
@@ -61,6 +81,8 @@ core_thumb_pop(
 ) {
     struct core *core;
     enum access_types access_type;
+    uint32_t count;
+    uint32_t *ram;
     ssize_t i;
 
     core = &gba->core;
@@ -75,6 +97,26 @@ core_thumb_pop(
         return;
     }
 
+    /* Fast path: the stack is in IWRAM/EWRAM, load all the registers at once */
+    count = __builtin_popcount(op & 0x1FF);
+    ram = mem_ram_bulk_access32(gba, core->sp, count, 1, false);
+    if (ram) {
+        for (i = 0; i < 8; ++i) {
+            if (bitfield_get(op, i)) {
+                core->registers[i] = *ram++;
+            }
+        }
+
+        core_idle(gba);
+        core->sp += count * 4;
+
+        if (bitfield_get(op, 8)) {
+            core->pc = *ram;
+            core_reload_pipeline(gba);
+        }
+        return;
+    }
+
     access_type = NON_SEQUENTIAL;
 
     for (i = 0; i < 8; ++i) {
@@ -108,10 +150,10 @@ core_thumb_stmia(
     enum access_types access_type;
     uint32_t count;
     uint32_t addr;
+    uint32_t *ram;
     uint32_t rb;
     ssize_t i;
 
-    count = 0;
     rb = bitfield_get_range(op, 8, 11);
     core = &gba->core;
     core->pc += 2;
@@ -127,14 +169,11 @@ core_thumb_stmia(
         return;
     }
 
-    for (i = 0; i < 8; ++i) {
-        if (bitfield_get(op, i)) {
-            count += 4;
-        }
-    }
+    count = __builtin_popcount(op & 0xFF) * 4;
 
     first = true;
     addr = core->registers[rb];
+    ram = mem_ram_bulk_access32(gba, addr, count / 4, 0, true);
 
     /*
     ** Edge case if Rb is included in the rlist:
@@ -145,7 +184,11 @@ core_thumb_stmia(
     access_type = NON_SEQUENTIAL;
     for (i = 0; i < 8; ++i) {
         if (bitfield_get(op, i)) {
-            mem_write32(gba, addr, core->registers[i], access_type);
+            if (ram) {
+                *ram++ = core->registers[i];
+            } else {
+                mem_write32(gba, addr, core->registers[i], access_type);
+            }
             addr += 4;
             access_type = SEQUENTIAL;
 
@@ -169,10 +212,10 @@ core_thumb_ldmia(
     enum access_types access_type;
     uint32_t count;
     uint32_t addr;
+    uint32_t *ram;
     uint32_t rb;
     ssize_t i;
 
-    count = 0;
     core = &gba->core;
     core->pc += 2;
     core->prefetch_access_type = NON_SEQUENTIAL;
@@ -189,20 +232,22 @@ core_thumb_ldmia(
         return;
     }
 
-    for (i = 0; i < 8; ++i) {
-        if (bitfield_get(op, i)) {
-            count += 4;
-        }
-    }
+    count = __builtin_popcount(op & 0xFF) * 4;
 
     addr = core->registers[rb];
     core->registers[rb] += count;
     access_type = NON_SEQUENTIAL;
+
+    /*
+    ** The internal cycle happens before the transfer, so it must fit in
+    ** the window checked by the fast path too.
+    */
+    ram = mem_ram_bulk_access32(gba, addr, count / 4, 1, false);
     core_idle(gba);
 
     for (i = 0; i < 8; ++i) {
         if (bitfield_get(op, i)) {
-            core->registers[i] = mem_read32(gba, addr, access_type);
+            core->registers[i] = ram ? *ram++ : mem_read32(gba, addr, access_type);
             addr += 4;
             access_type = SEQUENTIAL;
         }
@@ -0,0 +1,106 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+/*
+** The list of all Thumb instructions, alongside the mask they must match and the function handling them.
+**
+** This file isn't compiled into the emulator: `tools/gen_luts.c` includes it to build `thumb_lut` at compile time.
+** Define `THUMB_INSN(name, mask, op)` before including it.
+**
+** In a mask, '0' and '1' are bits that must match, '_' are separators and any other character is a wildcard.
+*/
+
+// Move shifted register
+THUMB_INSN("lsl",            "00000yyyyysssddd",          core_thumb_lsl)
+THUMB_INSN("lsr",            "00001yyyyysssddd",          core_thumb_lsr)
+THUMB_INSN("asr",            "00010yyyyysssddd",          core_thumb_asr)
+
+// Add/Subtract from/to low registers
+THUMB_INSN("add_lo_reg",     "00011i0yyysssddd",          core_thumb_lo_add)
+THUMB_INSN("sub_lo_reg",     "00011i1yyysssddd",          core_thumb_lo_sub)
+
+// Move/Compare/Add/Subtract immediate
+THUMB_INSN("mov_imm",        "00100dddxxxxxxxx",          core_thumb_mov_imm)
+THUMB_INSN("cmp_imm",        "00101dddxxxxxxxx",          core_thumb_cmp_imm)
+THUMB_INSN("add_imm",        "00110dddxxxxxxxx",          core_thumb_add_imm)
+THUMB_INSN("sub_imm",        "00111dddxxxxxxxx",          core_thumb_sub_imm)
+
+// ALU operations
+THUMB_INSN("alu",            "010000xxxxsssddd",          core_thumb_alu)
+
+// Hi register operations/Branch exchange
+THUMB_INSN("add_hi_reg",     "01000100hhsssddd",          core_thumb_hi_add)
+THUMB_INSN("cmp_hi_reg",     "01000101hhsssddd",          core_thumb_hi_cmp)
+THUMB_INSN("mov_hi_reg",     "01000110hhsssddd",          core_thumb_hi_mov)
+THUMB_INSN("bx",             "01000111hhsssddd",          core_thumb_branch_xchg)
+
+// PC-Relative loads
+THUMB_INSN("ldr_pc",         "01001dddxxxxxxxx",          core_thumb_ldr_pc)
+
+// Load/Store Word/Byte with register offset
+THUMB_INSN("ldr_regoff",     "01011b0ooobbbddd",          core_thumb_sdt_wb_reg)
+THUMB_INSN("str_regoff",     "01010b0ooobbbddd",          core_thumb_sdt_wb_reg)
+
+// Load/Store Sign-Extended Byte/Halfword
+THUMB_INSN("sdt_sbh_reg",    "0101hs1ooobbbddd",          core_thumb_sdt_sbh_reg)
+
+// Load/Store with Immediate Offset
+THUMB_INSN("std_imm",        "011blooooobbbddd",          core_thumb_sdt_imm)
+
+// Load/Store Halfword with Immediate Offset
+THUMB_INSN("std_h_imm",      "1000looooobbbddd",          core_thumb_sdt_h_imm)
+
+// SP-Relative Load/Store
+THUMB_INSN("sdt_sp",         "1001ldddiiiiiiii",          core_thumb_sdt_sp)
+
+// Load Address
+THUMB_INSN("add_pc_imm",     "10100dddiiiiiiii",          core_thumb_add_pc_imm)
+THUMB_INSN("add_sp_imm",     "10101dddiiiiiiii",          core_thumb_add_sp_imm)
+
+// Add Offset to Stack Pointer
+THUMB_INSN("add_sp_s_imm",   "10110000siiiiiii",          core_thumb_add_sp_s_imm)
+
+// Push/Pop lo registers
+THUMB_INSN("push",           "1011010xxxxxxxxx",          core_thumb_push)
+THUMB_INSN("pop",            "1011110xxxxxxxxx",          core_thumb_pop)
+
+// Multiple Load/Store
+THUMB_INSN("stmia",          "11000bbbxxxxxxxx",          core_thumb_stmia)
+THUMB_INSN("ldmia",          "11001bbbxxxxxxxx",          core_thumb_ldmia)
+
+// Conditional Branch
+THUMB_INSN("beq",            "11010000xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bne",            "11010001xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bcs",            "11010010xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bcc",            "11010011xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bmi",            "11010100xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bpl",            "11010101xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bvs",            "11010110xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bvc",            "11010111xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bhi",            "11011000xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bls",            "11011001xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bge",            "11011010xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("blt",            "11011011xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("bgt",            "11011100xxxxxxxx",          core_thumb_branch_cond)
+THUMB_INSN("ble",            "11011101xxxxxxxx",          core_thumb_branch_cond)
+
+// Software Interrupt
+THUMB_INSN("swi",            "11011111xxxxxxxx",          core_thumb_swi)
+
+// Unconditional Branch (B)
+THUMB_INSN("b",              "11100xxxxxxxxxxx",          core_thumb_branch)
+
+// Long Branch with Link (BL)
+THUMB_INSN("bl_1",           "11110xxxxxxxxxxx",          core_thumb_branch_link)
+THUMB_INSN("bl_2",           "11111xxxxxxxxxxx",          core_thumb_branch_link)
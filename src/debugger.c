@@ -44,6 +44,7 @@ debugger_eval_breakpoints(
             notif.addr = pc;
 
             gba->debugger.interrupted = true;
+            sched_raise_attention(gba);
 
             gba_send_notification_raw(gba, &notif.header);
             gba_state_pause(gba);
@@ -75,6 +76,7 @@ debugger_eval_write_watchpoints(
             notif.access.write = true;
 
             gba->debugger.interrupted = true;
+            sched_raise_attention(gba);
 
             gba_send_notification_raw(gba, &notif.header);
             gba_state_pause(gba);
@@ -105,6 +107,7 @@ debugger_eval_read_watchpoints(
             notif.access.write = false;
 
             gba->debugger.interrupted = true;
+            sched_raise_attention(gba);
 
             gba_send_notification_raw(gba, &notif.header);
             gba_state_pause(gba);
@@ -0,0 +1,338 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <string.h>
+#include <unistd.h>
+#include "gba/gba.h"
+
+static_assert(DIGEST_EWRAM_PAGES * DIGEST_PAGE_SIZE == EWRAM_SIZE);
+static_assert(DIGEST_IWRAM_PAGES * DIGEST_PAGE_SIZE == IWRAM_SIZE);
+static_assert(DIGEST_VRAM_PAGES * DIGEST_PAGE_SIZE == VRAM_SIZE);
+
+/*
+** Write `size` bytes of `data` to the log, retrying on short writes.
+**
+** The log is a debugging aid: if it can't be written, the digest is disabled
+** instead of stopping the emulation.
+*/
+static
+void
+digest_write(
+    struct gba *gba,
+    void const *data,
+    size_t size
+) {
+    uint8_t const *p;
+
+    p = data;
+    while (size) {
+        ssize_t ret;
+
+        ret = write(gba->digest.fd, p, size);
+        if (ret <= 0) {
+            logln(HS_ERROR, "Failed to write the state digest log, disabling it.");
+            gba->digest.enabled = false;
+            return;
+        }
+        p += ret;
+        size -= (size_t)ret;
+    }
+}
+
+/*
+** Combine the hashes of the pages of a memory region, re-hashing only the ones
+** written to since the last call.
+**
+** The dirty pages are hashed `ISA_HASH_BATCH` at a time, the page index being the seed.
+*/
+static
+uint64_t
+digest_region(
+    uint8_t const *data,
+    bool *dirty,
+    uint64_t *pages,
+    size_t len
+) {
+    uint8_t const *batch[ISA_HASH_BATCH];
+    uint64_t hashes[ISA_HASH_BATCH];
+    uint64_t seeds[ISA_HASH_BATCH];
+    size_t count;
+    uint64_t h;
+    size_t i;
+
+    count = 0;
+    for (i = 0; i < len; ++i) {
+        if (dirty[i]) {
+            batch[count] = data + i * DIGEST_PAGE_SIZE;
+            seeds[count] = i;
+            ++count;
+            dirty[i] = false;
+        }
+
+        if (count == ISA_HASH_BATCH || (count && i + 1 == len)) {
+            size_t j;
+
+            isa.hash64_batch(hashes, batch, seeds, count, DIGEST_PAGE_SIZE);
+            for (j = 0; j < count; ++j) {
+                pages[seeds[j]] = hashes[j];
+            }
+            count = 0;
+        }
+    }
+
+    h = len;
+    for (i = 0; i < len; ++i) {
+        h = hs_hash64_merge(h, pages[i]);
+    }
+    return (h);
+}
+
+/*
+** Hash the architectural state of the CPU.
+**
+** The registers are picked one by one instead of hashing `struct core` so that
+** two builds with a different layout of that structure can still be compared.
+*/
+static
+uint64_t
+digest_core(
+    struct core const *core
+) {
+    uint32_t state[16 + 28 + 5];
+    size_t i;
+
+    i = 0;
+    memcpy(state + i, core->registers, sizeof(core->registers));
+    i += array_length(core->registers);
+    memcpy(state + i, core->bank_registers, sizeof(core->bank_registers));
+    i += array_length(core->bank_registers);
+    state[i++] = core->cpsr.raw;
+    state[i++] = core->prefetch[0];
+    state[i++] = core->prefetch[1];
+    state[i++] = core->state;
+    state[i++] = core->pending_dma;
+
+    return (hs_hash64(state, sizeof(state), DIGEST_CORE));
+}
+
+/*
+** Hash the architectural state of the IO registers.
+**
+** Like `digest_core()`, the registers are picked one by one: `struct io` also holds the
+** scheduler slots of the timers and DMA channels, and padding, which differ between builds
+** behaving identically.
+*/
+static
+uint64_t
+digest_io(
+    struct gba const *gba
+) {
+    struct io const *io;
+    uint32_t state[130];
+    size_t i;
+    size_t j;
+
+    io = &gba->io;
+    i = 0;
+
+    // Display
+    state[i++] = io->dispcnt.raw;
+    state[i++] = io->greenswp.raw;
+    state[i++] = io->dispstat.raw;
+    state[i++] = io->vcount.raw;
+    for (j = 0; j < 4; ++j) {
+        state[i++] = io->bgcnt[j].raw;
+        state[i++] = io->bg_hoffset[j].raw;
+        state[i++] = io->bg_voffset[j].raw;
+    }
+    for (j = 0; j < 2; ++j) {
+        state[i++] = io->bg_pa[j].raw;
+        state[i++] = io->bg_pb[j].raw;
+        state[i++] = io->bg_pc[j].raw;
+        state[i++] = io->bg_pd[j].raw;
+        state[i++] = io->bg_x[j].raw;
+        state[i++] = io->bg_y[j].raw;
+        state[i++] = io->winh[j].raw;
+        state[i++] = io->winv[j].raw;
+    }
+    state[i++] = io->winin.raw;
+    state[i++] = io->winout.raw;
+    state[i++] = io->mosaic.raw;
+    state[i++] = io->bldcnt.raw;
+    state[i++] = io->bldalpha.raw;
+    state[i++] = io->bldy.raw;
+
+    // Sound
+    state[i++] = io->sound1cnt_l.raw;
+    state[i++] = io->sound1cnt_h.raw;
+    state[i++] = io->sound1cnt_x.raw;
+    state[i++] = io->sound2cnt_l.raw;
+    state[i++] = io->sound2cnt_h.raw;
+    state[i++] = io->sound3cnt_l.raw;
+    state[i++] = io->sound3cnt_h.raw;
+    state[i++] = io->sound3cnt_x.raw;
+    state[i++] = io->sound4cnt_l.raw;
+    state[i++] = io->sound4cnt_h.raw;
+    state[i++] = io->soundcnt_l.raw;
+    state[i++] = io->soundcnt_h.raw;
+    state[i++] = io->soundcnt_x.raw;
+    state[i++] = io->soundbias.raw;
+    memcpy(state + i, io->waveram, sizeof(io->waveram));
+    i += sizeof(io->waveram) / sizeof(*state);
+
+    // DMA
+    for (j = 0; j < 4; ++j) {
+        state[i++] = io->dma[j].src.raw;
+        state[i++] = io->dma[j].dst.raw;
+        state[i++] = io->dma[j].count.raw;
+        state[i++] = io->dma[j].control.raw;
+        state[i++] = io->dma[j].internal_src;
+        state[i++] = io->dma[j].internal_dst;
+        state[i++] = io->dma[j].internal_count;
+        state[i++] = io->dma[j].latch;
+    }
+
+    // Timers, with the counter as the game would read it.
+    for (j = 0; j < 4; ++j) {
+        state[i++] = timer_read_value(gba, (uint32_t)j);
+        state[i++] = io->timers[j].reload.raw;
+        state[i++] = io->timers[j].control.raw;
+    }
+
+    // Keypad, serial and system control
+    state[i++] = io->keyinput.raw;
+    state[i++] = io->keycnt.raw;
+    for (j = 0; j < 4; ++j) {
+        state[i++] = io->siomulti[j].raw;
+    }
+    state[i++] = io->siocnt.raw;
+    state[i++] = io->siomlt_send.raw;
+    state[i++] = io->rcnt.raw;
+    state[i++] = io->int_enabled.raw;
+    state[i++] = io->int_flag.raw;
+    state[i++] = io->waitcnt.raw;
+    state[i++] = io->ime.raw;
+    state[i++] = io->postflg;
+
+    // Writes that haven't taken effect yet
+    for (j = 0; j < 4; ++j) {
+        state[i++] = io->pending.timers[j].reload.raw;
+        state[i++] = io->pending.timers[j].control.raw;
+    }
+    state[i++] = io->pending.int_enabled.raw;
+    state[i++] = io->pending.int_flag.raw;
+    state[i++] = io->pending.ime.raw;
+    state[i++] = io->pending.siocnt.raw;
+
+    hs_assert(i == array_length(state));
+
+    return (hs_hash64(state, sizeof(state), DIGEST_IO));
+}
+
+/*
+** Mark all the pages as dirty.
+**
+** Must be called whenever the memory is modified without going through `template_write()`,
+** like when a quicksave is loaded.
+*/
+void
+digest_invalidate(
+    struct gba *gba
+) {
+    memset(&gba->digest.dirty, true, sizeof(gba->digest.dirty));
+}
+
+/*
+** Write the records that are still buffered to the log.
+*/
+void
+digest_flush(
+    struct gba *gba
+) {
+    if (gba->digest.enabled && gba->digest.buffer_len) {
+        digest_write(gba, gba->digest.buffer, gba->digest.buffer_len * sizeof(struct digest_record));
+    }
+    gba->digest.buffer_len = 0;
+}
+
+/*
+** Start a new digest log as described by `config`, flushing the previous one if any.
+*/
+void
+digest_reset(
+    struct gba *gba,
+    struct launch_config const *config
+) {
+    digest_flush(gba);
+
+    memset(&gba->digest, 0, sizeof(gba->digest));
+    gba->digest.enabled = config->digest.enable;
+    gba->digest.fd = config->digest.fd;
+    digest_invalidate(gba);
+
+    if (gba->digest.enabled) {
+        struct digest_log_header header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, DIGEST_MAGIC, sizeof(header.magic));
+        header.version = DIGEST_VERSION;
+        header.components = DIGEST_COMPONENT_LEN;
+        header.record_size = sizeof(struct digest_record);
+        digest_write(gba, &header, sizeof(header));
+    }
+}
+
+/*
+** Compute the digest of the current frame and append it to the log.
+**
+** Called when the PPU enters VBlank, once the frame is complete.
+*/
+void
+digest_frame(
+    struct gba *gba
+) {
+    struct digest *digest;
+    struct digest_record *record;
+
+    digest = &gba->digest;
+    record = &digest->buffer[digest->buffer_len];
+
+    memset(record, 0, sizeof(*record));
+    record->frame = digest->frame++;
+    record->cycles = gba->scheduler.cycles;
+
+    record->hashes[DIGEST_CORE] = digest_core(&gba->core);
+    record->hashes[DIGEST_IO] = digest_io(gba);
+    record->hashes[DIGEST_SCHEDULER] = hs_hash64(&record->cycles, sizeof(record->cycles), DIGEST_SCHEDULER);
+    record->hashes[DIGEST_EWRAM] = digest_region(gba->memory.ewram, digest->dirty.ewram, digest->pages.ewram, DIGEST_EWRAM_PAGES);
+    record->hashes[DIGEST_IWRAM] = digest_region(gba->memory.iwram, digest->dirty.iwram, digest->pages.iwram, DIGEST_IWRAM_PAGES);
+    record->hashes[DIGEST_VRAM] = digest_region(gba->memory.vram, digest->dirty.vram, digest->pages.vram, DIGEST_VRAM_PAGES);
+    record->hashes[DIGEST_PALRAM] = hs_hash64(gba->memory.palram, sizeof(gba->memory.palram), DIGEST_PALRAM);
+    record->hashes[DIGEST_OAM] = hs_hash64(gba->memory.oam, sizeof(gba->memory.oam), DIGEST_OAM);
+    record->hashes[DIGEST_BACKUP_STORAGE] = hs_hash64(
+        gba->shared_data.backup_storage.data,
+        gba->shared_data.backup_storage.size,
+        DIGEST_BACKUP_STORAGE
+    );
+    record->hashes[DIGEST_FRAMEBUFFER] = hs_hash64(
+        gba->shared_data.framebuffer.data,
+        sizeof(gba->shared_data.framebuffer.data),
+        DIGEST_FRAMEBUFFER
+    );
+
+    ++digest->buffer_len;
+    if (digest->buffer_len == DIGEST_BUFFER_LEN) {
+        digest_flush(gba);
+    }
+}
@@ -13,13 +13,15 @@
 
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include "hs.h"
 #include "gba/gba.h"
-#include "gba/core/arm.h"
-#include "gba/core/thumb.h"
 #include "gba/channel.h"
 #include "gba/event.h"
 
@@ -76,25 +78,73 @@ gba_memory_attach_rom(
 }
 
 /*
-** Create a new GBA emulator.
+** Create the file descriptor returned by `gba_shared_event_fd()`.
+**
+** An eventfd is used when available, otherwise we fall back to a non-blocking pipe.
 */
-struct gba *
-gba_create(
-    void
+static void
+gba_event_fd_open(
+    struct gba *gba
 ) {
-    struct gba *gba;
+    int fds[2];
 
-    gba = malloc(sizeof(struct gba));
-    hs_assert(gba);
+    gba->shared_data.event.read_fd = -1;
+    gba->shared_data.event.write_fd = -1;
+    atomic_init(&gba->shared_data.event.pending, 0);
 
-    memset(gba, 0, sizeof(*gba));
+#ifdef __linux__
+    fds[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fds[0] >= 0) {
+        gba->shared_data.event.read_fd = fds[0];
+        gba->shared_data.event.write_fd = fds[0];
+        return;
+    }
+#endif
 
-    // Initialize the ARM and Thumb decoder
-    {
-        core_arm_decode_insns();
-        core_thumb_decode_insns();
+    if (pipe(fds)) {
+        logln(HS_ERROR, "Failed to create the event file descriptor: %s", strerror(errno));
+        return;
     }
 
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    gba->shared_data.event.read_fd = fds[0];
+    gba->shared_data.event.write_fd = fds[1];
+}
+
+static void
+gba_event_fd_close(
+    struct gba *gba
+) {
+    if (gba->shared_data.event.write_fd >= 0 && gba->shared_data.event.write_fd != gba->shared_data.event.read_fd) {
+        close(gba->shared_data.event.write_fd);
+    }
+
+    if (gba->shared_data.event.read_fd >= 0) {
+        close(gba->shared_data.event.read_fd);
+    }
+
+    gba->shared_data.event.read_fd = -1;
+    gba->shared_data.event.write_fd = -1;
+}
+
+/*
+** Initialize a GBA emulator allocated by the caller.
+**
+** Unlike `gba_create()`, no file descriptor is created for `gba_shared_event_fd()`, so that
+** callers driving a large number of instances don't run out of them.
+*/
+void
+gba_init(
+    struct gba *gba
+) {
+    memset(gba, 0, sizeof(*gba));
+
+    isa_init();
+
     // Channels
     {
         channel_init(&gba->channels.messages);
@@ -110,8 +160,41 @@ gba_create(
         atomic_init(&gba->shared_data.framebuffer.version, 1);
         atomic_init(&gba->shared_data.framebuffer.dirty, false);
         pthread_mutex_init(&gba->shared_data.audio_rbuffer_mutex, NULL);
+        gba->shared_data.event.read_fd = -1;
+        gba->shared_data.event.write_fd = -1;
     }
 
+    // Backup storage persistence
+    {
+        pthread_mutex_init(&gba->backup_persistence.lock, NULL);
+        pthread_cond_init(&gba->backup_persistence.cond, NULL);
+    }
+
+    // Capture
+    {
+        pthread_mutex_init(&gba->capture.lock, NULL);
+        pthread_cond_init(&gba->capture.cond, NULL);
+    }
+
+    watch_init(gba);
+    cheat_init(gba);
+}
+
+/*
+** Create a new GBA emulator.
+*/
+struct gba *
+gba_create(
+    void
+) {
+    struct gba *gba;
+
+    gba = malloc(sizeof(struct gba));
+    hs_assert(gba);
+
+    gba_init(gba);
+    gba_event_fd_open(gba);
+
     return (gba);
 }
 
@@ -128,6 +211,7 @@ gba_send_notification_raw(
             channel_lock(&gba->channels.notifications);
             channel_push(&gba->channels.notifications, notif_header);
             channel_release(&gba->channels.notifications);
+            gba_shared_signal_event(gba, GBA_EVENT_NOTIFICATION);
 
 #ifdef WITH_DEBUGGER
             channel_lock(&gba->channels.debug);
@@ -143,6 +227,7 @@ gba_send_notification_raw(
             channel_lock(&gba->channels.notifications);
             channel_push(&gba->channels.notifications, notif_header);
             channel_release(&gba->channels.notifications);
+            gba_shared_signal_event(gba, GBA_EVENT_NOTIFICATION);
             break;
         };
 #ifdef WITH_DEBUGGER
@@ -182,12 +267,16 @@ gba_state_stop(
     free(gba->scheduler.events);
     gba->scheduler.events = NULL;
 
-    free(gba->shared_data.backup_storage.data);
-    gba->shared_data.backup_storage.data = NULL;
+    mem_backup_storage_persist_stop(gba);
+    mem_backup_storage_release(gba);
 
     gba_memory_release_rom(&gba->memory);
 
+    digest_flush(gba);
+    capture_stop(gba);
+
     gba->state = GBA_STATE_STOP;
+    link_stop(gba);
     gba_send_notification(gba, NOTIFICATION_STOP);
 }
 
@@ -195,6 +284,9 @@ void
 gba_state_pause(
     struct gba *gba
 ) {
+    digest_flush(gba);
+    mem_backup_storage_write_to_disk(gba);
+
     gba->state = GBA_STATE_PAUSE;
     gba_send_notification(gba, NOTIFICATION_PAUSE);
 }
@@ -208,7 +300,7 @@ gba_state_run(
     gba_send_notification(gba, NOTIFICATION_RUN);
 }
 
-static void
+void
 gba_state_reset(
     struct gba *gba,
     struct launch_config const *config
@@ -228,16 +320,6 @@ gba_state_reset(
         hs_assert(scheduler->events);
 
         sched_update_speed(gba);
-
-        // Frame limiter
-        sched_add_event(
-            gba,
-            NEW_REPEAT_EVENT(
-                SCHED_EVENT_FRAME_LIMITER,
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH * GBA_SCREEN_REAL_HEIGHT,  // Timing of first trigger
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH * GBA_SCREEN_REAL_HEIGHT   // Period
-            )
-        );
     }
 
     // Shared framebuffer
@@ -250,6 +332,8 @@ gba_state_reset(
         );
         atomic_store(&gba->shared_data.framebuffer.version, 1);
         atomic_store(&gba->shared_data.framebuffer.dirty, false);
+        memset(gba->shared_data.framebuffer.dirty_tiles, 0xFF, sizeof(gba->shared_data.framebuffer.dirty_tiles));
+        memset(gba->shared_data.framebuffer.drawn_tiles, 0x00, sizeof(gba->shared_data.framebuffer.drawn_tiles));
         pthread_mutex_unlock(&gba->shared_data.framebuffer.lock);
     }
 
@@ -333,23 +417,13 @@ gba_state_reset(
         ppu = &gba->ppu;
         memset(ppu, 0, sizeof(*ppu));
 
-        // HDraw
+        // The first scanline starts in HDraw, and the event reschedules itself from there.
         sched_add_event(
             gba,
-            NEW_REPEAT_EVENT(
-                SCHED_EVENT_PPU_HDRAW,
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH,       // Timing of first trigger
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH        // Period
-            )
-        );
-
-        // HBlank
-        sched_add_event(
-            gba,
-            NEW_REPEAT_EVENT(
-                SCHED_EVENT_PPU_HBLANK,
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_WIDTH + 46,       // Timing of first trigger
-                GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH        // Period
+            NEW_FIX_EVENT_ARGS(
+                SCHED_EVENT_PPU_SCANLINE,
+                PPU_HDRAW_CYCLES,
+                EVENT_ARG(u32, PPU_PHASE_HBLANK)
             )
         );
     }
@@ -399,16 +473,8 @@ gba_state_reset(
             default: panic(HS_CORE, "Unknown backup type %i", gba->memory.backup_storage.type); break;
         }
 
-        if (gba->shared_data.backup_storage.size) {
-            gba->shared_data.backup_storage.data = malloc(gba->shared_data.backup_storage.size);
-            hs_assert(gba->shared_data.backup_storage.data);
-
-            memset(gba->shared_data.backup_storage.data, 0xFF, gba->shared_data.backup_storage.size);
-
-            if (config->backup_storage.data && config->backup_storage.size) {
-                memcpy(gba->shared_data.backup_storage.data, config->backup_storage.data, min(gba->shared_data.backup_storage.size, config->backup_storage.size));
-            }
-        }
+        mem_backup_storage_attach(gba, config);
+        mem_backup_storage_persist_start(gba, config);
     }
 
     // Core
@@ -440,6 +506,22 @@ gba_state_reset(
         }
     }
 
+    // State digest
+    digest_reset(gba, config);
+
+    // Capture
+    capture_start(gba, config);
+
+    // Run-ahead
+    run_ahead_reset(gba);
+    rollback_reset(gba);
+    cheat_reset(gba);
+
+    // Link cable
+    link_reset(gba);
+
+    core_select_variant(gba);
+
     gba_send_notification(gba, NOTIFICATION_RESET);
 }
 
@@ -480,28 +562,22 @@ gba_process_message(
         };
         case MESSAGE_KEY: {
             struct message_key const *msg_key;
+            uint32_t mask;
 
             msg_key = (struct message_key const *)message;
-            switch (msg_key->key) {
-                case KEY_A:         gba->io.keyinput.a = !msg_key->pressed; break;
-                case KEY_B:         gba->io.keyinput.b = !msg_key->pressed; break;
-                case KEY_L:         gba->io.keyinput.l = !msg_key->pressed; break;
-                case KEY_R:         gba->io.keyinput.r = !msg_key->pressed; break;
-                case KEY_UP:        gba->io.keyinput.up = !msg_key->pressed; break;
-                case KEY_DOWN:      gba->io.keyinput.down = !msg_key->pressed; break;
-                case KEY_RIGHT:     gba->io.keyinput.right = !msg_key->pressed; break;
-                case KEY_LEFT:      gba->io.keyinput.left = !msg_key->pressed; break;
-                case KEY_START:     gba->io.keyinput.start = !msg_key->pressed; break;
-                case KEY_SELECT:    gba->io.keyinput.select = !msg_key->pressed; break;
-                default:            break;
-            };
-
-            if (gba->core.state == CORE_STOP && io_evaluate_keypad_cond(gba)) {
-                gba->core.state = CORE_RUN;
-                sched_reset_frame_limiter(gba);
+            mask = (msg_key->key < KEY_MAX) ? (1u << msg_key->key) : 0;
+            if (gba->rollback.enabled) {
+                rollback_local_keys(gba, mask, msg_key->pressed ? mask : 0);
+            } else {
+                gba_set_keys(gba, mask, msg_key->pressed ? mask : 0);
             }
+            break;
+        };
+        case MESSAGE_INPUT: {
+            struct message_input const *msg_input;
 
-            io_scan_keypad_irq(gba);
+            msg_input = (struct message_input const *)message;
+            rollback_input(gba, msg_input->frame, msg_input->keys);
             break;
         };
         case MESSAGE_SETTINGS: {
@@ -516,6 +592,8 @@ gba_process_message(
             if (!gba->settings.prefetch_buffer) {
                 memset(&gba->memory.pbuffer, 0, sizeof(struct prefetch_buffer));
             }
+
+            core_select_variant(gba);
             break;
         };
         case MESSAGE_QUICKSAVE: {
@@ -532,6 +610,12 @@ gba_process_message(
 
             msg_quickload = (struct message_quickload const *)message;
             quickload(gba, msg_quickload->data, msg_quickload->size); // TODO FIXME Send back & handle any errors when loading the save state.
+            digest_invalidate(gba);
+            mem_backup_storage_mark_dirty(gba, 0, gba->shared_data.backup_storage.size);
+            link_reset(gba);
+            rollback_reset(gba);
+            mem_update_waitstates(gba);
+            core_select_variant(gba);
             gba_send_notification(gba, NOTIFICATION_QUICKLOAD);
             break;
         };
@@ -598,6 +682,8 @@ gba_process_message(
             hs_assert(gba->debugger.watchpoints.list);
             memcpy(gba->debugger.watchpoints.list, msg_set_watchpoints_list->watchpoints, sizeof(struct watchpoint) * gba->debugger.watchpoints.len);
 
+            core_select_variant(gba);
+
             gba_send_notification(gba, NOTIFICATION_WATCHPOINTS_LIST_SET);
             break;
         };
@@ -605,6 +691,49 @@ gba_process_message(
     }
 }
 
+/*
+** Set the state of the keys in `mask` to the one of the matching bits of `pressed`.
+** Bit `n` of both stands for the key `n` of `enum keys`.
+*/
+void
+gba_set_keys(
+    struct gba *gba,
+    uint32_t mask,
+    uint32_t pressed
+) {
+    enum keys key;
+
+    for (key = KEY_MIN; key < KEY_MAX; ++key) {
+        bool released;
+
+        if (!(mask & (1u << key))) {
+            continue;
+        }
+
+        released = !(pressed & (1u << key));
+        switch (key) {
+            case KEY_A:         gba->io.keyinput.a = released; break;
+            case KEY_B:         gba->io.keyinput.b = released; break;
+            case KEY_L:         gba->io.keyinput.l = released; break;
+            case KEY_R:         gba->io.keyinput.r = released; break;
+            case KEY_UP:        gba->io.keyinput.up = released; break;
+            case KEY_DOWN:      gba->io.keyinput.down = released; break;
+            case KEY_RIGHT:     gba->io.keyinput.right = released; break;
+            case KEY_LEFT:      gba->io.keyinput.left = released; break;
+            case KEY_START:     gba->io.keyinput.start = released; break;
+            case KEY_SELECT:    gba->io.keyinput.select = released; break;
+            default:            break;
+        };
+    }
+
+    if (gba->core.state == CORE_STOP && io_evaluate_keypad_cond(gba)) {
+        gba->core.state = CORE_RUN;
+        sched_reset_frame_limiter(gba);
+    }
+
+    io_scan_keypad_irq(gba);
+}
+
 /*
 ** Run the given GBA emulator.
 ** This will process all the message sent to the gba until an exit message is sent.
@@ -652,11 +781,33 @@ gba_run(
                 break;
             }
             case GBA_STATE_RUN: {
+                // Inputs received for past frames.
+                if (gba->rollback.dirty) {
+                    rollback_resimulate(gba);
+                }
+
 #ifdef WITH_DEBUGGER
-                debugger_execute_run_mode(gba);
+                if (gba->link.hub && gba->debugger.run_mode == GBA_RUN_MODE_NORMAL) {
+                    link_run(gba);
+                } else {
+                    debugger_execute_run_mode(gba);
+                }
 #else
-                sched_run_for(gba, GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH);
+                if (gba->link.hub) {
+                    link_run(gba);
+                } else {
+                    sched_run_for(gba, GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH);
+                }
 #endif
+
+                if (gba->rollback.frame_ready) {
+                    rollback_frame(gba);
+                }
+
+                // Set once the real timeline completed a frame.
+                if (gba->run_ahead.frame_ready) {
+                    run_ahead_frame(gba);
+                }
                 break;
             };
         }
@@ -671,11 +822,39 @@ gba_delete(
     struct gba *gba
 ) {
     if (gba) {
-        gba_memory_release_rom(&gba->memory);
+        gba_release(gba);
     }
     free(gba);
 }
 
+/*
+** Release the resources of a GBA initialized by `gba_init()`, but not the GBA itself.
+*/
+void
+gba_release(
+    struct gba *gba
+) {
+    digest_flush(gba);
+    capture_stop(gba);
+    run_ahead_release(gba);
+    rollback_release(gba);
+    mem_backup_storage_persist_stop(gba);
+    mem_backup_storage_release(gba);
+    gba_memory_release_rom(&gba->memory);
+    gba_event_fd_close(gba);
+    free(gba->scheduler.events);
+    gba->scheduler.events = NULL;
+    watch_release(gba);
+    cheat_release(gba);
+    link_hub_detach(gba);
+
+    free(gba->channels.messages.events);
+    free(gba->channels.notifications.events);
+#ifdef WITH_DEBUGGER
+    free(gba->channels.debug.events);
+#endif
+}
+
 /*
 ** Lock the mutex protecting the framebuffer shared with the frontend.
 */
@@ -736,6 +915,116 @@ gba_shared_reset_frame_counter(
     return (atomic_exchange(&gba->shared_data.frame_counter, 0));
 }
 
+/*
+** Fill `stats` with the frame skipping statistics gathered since the last call, and reset them.
+*/
+void
+gba_shared_reset_frame_skip_stats(
+    struct gba *gba,
+    struct frame_skip_stats *stats
+) {
+    stats->skipped = atomic_exchange(&gba->shared_data.frame_skip.skipped, 0);
+    stats->late = atomic_exchange(&gba->shared_data.frame_skip.late, 0);
+    stats->max_streak = atomic_exchange(&gba->shared_data.frame_skip.max_streak, 0);
+}
+
+/*
+** Fill `stats` with the capture statistics gathered since the last call, and reset them.
+*/
+void
+gba_shared_reset_capture_stats(
+    struct gba *gba,
+    struct capture_stats *stats
+) {
+    stats->frames = atomic_exchange(&gba->shared_data.capture.frames, 0);
+    stats->duplicates = atomic_exchange(&gba->shared_data.capture.duplicates, 0);
+    stats->dropped = atomic_exchange(&gba->shared_data.capture.dropped, 0);
+    stats->bytes = atomic_exchange(&gba->shared_data.capture.bytes, 0);
+}
+
+/*
+** Return the number of the frame running, to timestamp the inputs sent with `MESSAGE_INPUT`.
+*/
+uint64_t
+gba_shared_rollback_frame(
+    struct gba *gba
+) {
+    return (atomic_load(&gba->shared_data.rollback.frame));
+}
+
+/*
+** Fill `stats` with the rollback statistics gathered since the last call, and reset them.
+*/
+void
+gba_shared_reset_rollback_stats(
+    struct gba *gba,
+    struct rollback_stats *stats
+) {
+    stats->rollbacks = atomic_exchange(&gba->shared_data.rollback.rollbacks, 0);
+    stats->frames = atomic_exchange(&gba->shared_data.rollback.frames, 0);
+    stats->max_depth = atomic_exchange(&gba->shared_data.rollback.max_depth, 0);
+    stats->time = atomic_exchange(&gba->shared_data.rollback.time, 0);
+    stats->late = atomic_exchange(&gba->shared_data.rollback.late, 0);
+}
+
+/*
+** Return a file descriptor that becomes readable when one of `enum gba_events` occurs,
+** or -1 if it couldn't be created.
+**
+** This is meant for frontends driving many instances from a single poll()/epoll() loop.
+** Once it is readable, call `gba_shared_drain_events()` to know what happened and re-arm it.
+*/
+int
+gba_shared_event_fd(
+    struct gba *gba
+) {
+    return (gba->shared_data.event.read_fd);
+}
+
+/*
+** Clear the event file descriptor and return the `enum gba_events` that occurred since the last call.
+*/
+uint32_t
+gba_shared_drain_events(
+    struct gba *gba
+) {
+    uint8_t buffer[16];
+
+    // The file descriptor must be emptied *before* the pending events are fetched, otherwise an event
+    // signaled in-between would leave the bit set without the file descriptor being readable.
+    if (gba->shared_data.event.read_fd >= 0) {
+        while (read(gba->shared_data.event.read_fd, buffer, sizeof(buffer)) > 0);
+    }
+
+    return (atomic_exchange(&gba->shared_data.event.pending, 0));
+}
+
+/*
+** Signal the given event to the frontend.
+**
+** The file descriptor is only written to when no other event is pending, so this is cheap
+** to call from hot paths as long as the frontend isn't draining the events.
+*/
+void
+gba_shared_signal_event(
+    struct gba *gba,
+    enum gba_events event
+) {
+    uint64_t one;
+    ssize_t ret __unused;
+
+    if (atomic_load_explicit(&gba->shared_data.event.pending, memory_order_relaxed) & event) {
+        return;
+    }
+
+    if (!atomic_fetch_or(&gba->shared_data.event.pending, event) && gba->shared_data.event.write_fd >= 0) {
+        // An eventfd expects exactly 8 bytes, a pipe doesn't care.
+        // Failing here can only mean the pipe is full, in which case it's readable anyway.
+        one = 1;
+        ret = write(gba->shared_data.event.write_fd, &one, sizeof(one));
+    }
+}
+
 /*
 ** Delete a notification.
 ** Must be called by the frontend/debugger for each received notifications.
@@ -22,7 +22,7 @@ gpio_rumble_write(
     uint8_t val
 ) {
     gba->gpio.rumble.enabled = (bool)(val & 0b1000);
-    if (gba->gpio.rumble.enabled) {
+    if (gba->gpio.rumble.enabled && !gba->run_ahead.speculating) {
         gba_send_notification(gba, NOTIFICATION_RUMBLE);
     }
 }
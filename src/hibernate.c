@@ -0,0 +1,251 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gba/gba.h"
+#include "gba/hibernate.h"
+
+#define HIBERNATE_MAGIC         "HSHB"
+#define HIBERNATE_VERSION       1u
+
+struct hibernate_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t size;                      // Size of the whole image, header included.
+    enum gba_states state;
+    struct gba_settings settings;
+    uint64_t quicksave_size;            // The quicksave follows the header.
+};
+
+/*
+** Fill the header of the image of the given instance and save its state.
+*/
+static
+bool
+hibernate_prepare(
+    struct gba const *gba,
+    struct hibernate_header *header,
+    uint8_t **qsave,
+    size_t *qsave_size
+) {
+    if (gba->state == GBA_STATE_STOP) {
+        logln(HS_ERROR, "Cannot hibernate an instance with no game loaded.");
+        return (false);
+    }
+
+    quicksave(gba, qsave, qsave_size);
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, HIBERNATE_MAGIC, sizeof(header->magic));
+    header->version = HIBERNATE_VERSION;
+    header->size = (uint32_t)(sizeof(*header) + *qsave_size);
+    header->state = gba->state;
+    header->settings = gba->settings;
+    header->quicksave_size = *qsave_size;
+    return (true);
+}
+
+/*
+** Serialize the state of the given instance to a newly allocated buffer and delete it.
+**
+** `gba_run()` must have returned. Nothing is done and false is returned if no game is loaded.
+*/
+bool
+gba_hibernate(
+    struct gba *gba,
+    uint8_t **data,
+    size_t *size
+) {
+    struct hibernate_header header;
+    uint8_t *qsave;
+    size_t qsave_size;
+    uint8_t *image;
+
+    if (!hibernate_prepare(gba, &header, &qsave, &qsave_size)) {
+        return (false);
+    }
+
+    image = malloc(sizeof(header) + qsave_size);
+    hs_assert(image);
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), qsave, qsave_size);
+    free(qsave);
+
+    // Also persists the backup storage and stops its thread, if any.
+    gba_delete(gba);
+
+    *data = image;
+    *size = sizeof(header) + qsave_size;
+    return (true);
+}
+
+/*
+** Same as `gba_hibernate()`, writing the image to `fd` instead.
+**
+** The instance isn't deleted if the image couldn't be written.
+*/
+bool
+gba_hibernate_to_fd(
+    struct gba *gba,
+    int fd
+) {
+    struct hibernate_header header;
+    uint8_t *qsave;
+    size_t qsave_size;
+    struct {
+        uint8_t const *data;
+        size_t size;
+    } parts[2];
+    size_t i;
+
+    if (!hibernate_prepare(gba, &header, &qsave, &qsave_size)) {
+        return (false);
+    }
+
+    parts[0].data = (uint8_t const *)&header;
+    parts[0].size = sizeof(header);
+    parts[1].data = qsave;
+    parts[1].size = qsave_size;
+
+    for (i = 0; i < array_length(parts); ++i) {
+        while (parts[i].size) {
+            ssize_t written;
+
+            written = write(fd, parts[i].data, parts[i].size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            } else if (written <= 0) {
+                logln(HS_ERROR, "Failed to write the hibernation image: %s", strerror(errno));
+                free(qsave);
+                return (false);
+            }
+
+            parts[i].data += written;
+            parts[i].size -= written;
+        }
+    }
+
+    free(qsave);
+    gba_delete(gba);
+    return (true);
+}
+
+/*
+** Create an instance from an image written by `gba_hibernate()`.
+**
+** `config` must describe the game the instance was running. Return NULL if the image is
+** invalid or doesn't match that game.
+** As after `gba_create()`, the caller then starts `gba_run()`.
+*/
+struct gba *
+gba_resume(
+    struct launch_config const *config,
+    uint8_t const *data,
+    size_t size
+) {
+    struct hibernate_header header;
+    struct gba *gba;
+
+    if (size < sizeof(header)) {
+        goto invalid;
+    }
+
+    memcpy(&header, data, sizeof(header));
+    if (
+           memcmp(header.magic, HIBERNATE_MAGIC, sizeof(header.magic))
+        || header.version != HIBERNATE_VERSION
+        || header.size != size
+        || header.quicksave_size != size - sizeof(header)
+        || (header.state != GBA_STATE_PAUSE && header.state != GBA_STATE_RUN)
+    ) {
+        goto invalid;
+    }
+
+    gba = gba_create();
+    gba_state_reset(gba, config);
+
+    // `quickload()` doesn't modify the buffer, it only reads from it.
+    if (quickload(gba, (uint8_t *)data + sizeof(header), header.quicksave_size)) {
+        gba_delete(gba);
+        goto invalid;
+    }
+
+    gba->settings = header.settings;
+    sched_update_speed(gba);
+
+    // The waitstates are derived from REG_WAITCNT and aren't part of the quicksave.
+    mem_update_waitstates(gba);
+    core_select_variant(gba);
+
+    if (header.state == GBA_STATE_RUN) {
+        gba_state_run(gba);
+    } else {
+        gba_state_pause(gba);
+    }
+
+    return (gba);
+
+invalid:
+    logln(HS_ERROR, "Invalid hibernation image.");
+    return (NULL);
+}
+
+/*
+** Same as `gba_resume()`, reading the image from `fd` until its end.
+*/
+struct gba *
+gba_resume_from_fd(
+    struct launch_config const *config,
+    int fd
+) {
+    struct gba *gba;
+    uint8_t *image;
+    size_t capacity;
+    size_t size;
+
+    capacity = 64 * 1024;
+    size = 0;
+    image = malloc(capacity);
+    hs_assert(image);
+
+    while (true) {
+        ssize_t len;
+
+        if (size == capacity) {
+            capacity *= 2;
+            image = realloc(image, capacity);
+            hs_assert(image);
+        }
+
+        len = read(fd, image + size, capacity - size);
+        if (len < 0 && errno == EINTR) {
+            continue;
+        } else if (len < 0) {
+            logln(HS_ERROR, "Failed to read the hibernation image: %s", strerror(errno));
+            free(image);
+            return (NULL);
+        } else if (!len) {
+            break;
+        }
+
+        size += len;
+    }
+
+    gba = gba_resume(config, image, size);
+    free(image);
+    return (gba);
+}
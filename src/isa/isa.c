@@ -0,0 +1,304 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hs.h"
+#include "gba/gba.h"
+
+#if defined(__aarch64__) && defined(__linux__)
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+
+/*
+** Reference implementations, used when the host has none of the extensions
+** below and to define what the other variants must compute.
+*/
+
+static
+void
+scanline_to_rgb555_scalar(
+    uint16_t *dst,
+    struct rich_color const *src,
+    size_t len
+) {
+    size_t x;
+
+    for (x = 0; x < len; ++x) {
+        dst[x] = src[x].raw & 0x7FFF;
+    }
+}
+
+static
+size_t
+run_length_scalar(
+    uint8_t const *data,
+    size_t size,
+    size_t max
+) {
+    size_t limit;
+    size_t n;
+
+    limit = min(size, max);
+    n = 1;
+    while (n < limit && data[n] == data[0]) {
+        ++n;
+    }
+    return (n);
+}
+
+static
+void
+search_filter_scalar(
+    uint64_t *bitmap,
+    uint8_t const *cur,
+    uint8_t const *ref,
+    size_t ref_step,
+    size_t size,
+    size_t width,
+    enum isa_compare cmp
+) {
+    size_t chunk;
+
+    for (chunk = 0; chunk < size / ISA_SEARCH_CHUNK; ++chunk) {
+        uint8_t const *a;
+        uint8_t const *b;
+        uint64_t bits;
+        uint64_t keep;
+        size_t i;
+
+        bits = isa_search_chunk_bits(bitmap, chunk, width);
+        if (!bits) {
+            continue;
+        }
+
+        a = cur + chunk * ISA_SEARCH_CHUNK;
+        b = ref + chunk * ref_step;
+        keep = 0;
+        for (i = 0; i < ISA_SEARCH_CHUNK / width; ++i) {
+            uint32_t x;
+            uint32_t y;
+            bool match;
+
+            x = 0;
+            y = 0;
+            memcpy(&x, a + i * width, width);
+            memcpy(&y, b + i * width, width);
+
+            switch (cmp) {
+                case ISA_CMP_EQ:    match = (x == y); break;
+                case ISA_CMP_NE:    match = (x != y); break;
+                case ISA_CMP_GT:    match = (x > y); break;
+                case ISA_CMP_LT:    match = (x < y); break;
+                default:            match = false; break;
+            }
+            keep |= (uint64_t)match << i;
+        }
+
+        isa_search_chunk_store(bitmap, chunk, width, bits & keep);
+    }
+}
+
+static
+void
+hash64_batch_scalar(
+    uint64_t *hashes,
+    uint8_t const * const *data,
+    uint64_t const *seeds,
+    size_t count,
+    size_t size
+) {
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        hashes[i] = hs_hash64(data[i], size, seeds[i]);
+    }
+}
+
+static struct isa_kernels const isa_kernels_scalar = {
+    .scanline_to_rgb555 = scanline_to_rgb555_scalar,
+    .run_length = run_length_scalar,
+    .search_filter = search_filter_scalar,
+    .hash64_batch = hash64_batch_scalar,
+};
+
+struct isa_kernels isa = {
+    .scanline_to_rgb555 = scanline_to_rgb555_scalar,
+    .run_length = run_length_scalar,
+    .search_filter = search_filter_scalar,
+    .hash64_batch = hash64_batch_scalar,
+};
+
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+static enum isa_levels isa_selected = ISA_SCALAR;
+
+/*
+** Return true if the host CPU (and OS) can run code using the given extension.
+*/
+static
+bool
+isa_supported(
+    enum isa_levels level
+) {
+    switch (level) {
+        case ISA_SCALAR:        return (true);
+#if defined(__x86_64__) || defined(__i386__)
+        case ISA_SSE4_1:        return (__builtin_cpu_supports("sse4.1"));
+        case ISA_AVX2:          return (__builtin_cpu_supports("avx2"));
+        case ISA_AVX512:        return (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq"));
+#elif defined(__aarch64__) && defined(__linux__)
+        case ISA_NEON:          return (getauxval(AT_HWCAP) & HWCAP_ASIMD);
+#elif defined(__aarch64__)
+        case ISA_NEON:          return (true); // Advanced SIMD is mandatory on AArch64
+#endif
+        default:                return (false);
+    }
+}
+
+/*
+** Return the kernel table of the given extension, or NULL if this build has none.
+*/
+static
+struct isa_kernels const *
+isa_table(
+    enum isa_levels level
+) {
+    switch (level) {
+        case ISA_SCALAR:        return (&isa_kernels_scalar);
+#if defined(__x86_64__) || defined(__i386__)
+        case ISA_SSE4_1:        return (&isa_kernels_sse4_1);
+        case ISA_AVX2:          return (&isa_kernels_avx2);
+        case ISA_AVX512:        return (&isa_kernels_avx512);
+#elif defined(__aarch64__)
+        case ISA_NEON:          return (&isa_kernels_neon);
+#endif
+        default:                return (NULL);
+    }
+}
+
+/*
+** The extension a kernel falls back to when `level` has no variant of it.
+*/
+static
+enum isa_levels
+isa_fallback(
+    enum isa_levels level
+) {
+    switch (level) {
+        case ISA_AVX512:        return (ISA_AVX2);
+        case ISA_AVX2:          return (ISA_SSE4_1);
+        default:                return (ISA_SCALAR);
+    }
+}
+
+/*
+** Pick, for each kernel, the variant of the most capable extension at or below
+** `level` that implements it.
+*/
+#define isa_select_kernel(level, kernel)                                    \
+    do {                                                                    \
+        enum isa_levels _lvl;                                               \
+                                                                            \
+        _lvl = (level);                                                     \
+        while (!isa_table(_lvl) || !isa_table(_lvl)->kernel) {              \
+            _lvl = isa_fallback(_lvl);                                      \
+        }                                                                   \
+        isa.kernel = isa_table(_lvl)->kernel;                               \
+    } while (0)
+
+static
+void
+isa_detect(
+    void
+) {
+    char const *forced;
+    enum isa_levels level;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#endif
+
+    isa_selected = ISA_SCALAR;
+    for (level = ISA_SCALAR; level < ISA_LEN; ++level) {
+        if (isa_table(level) && isa_supported(level)) {
+            isa_selected = level;
+        }
+    }
+
+    // `GBAEMU_FORCE_ISA` restricts the kernels to a given extension, to compare them or to
+    // work around a faulty one. It can't enable an extension the host doesn't have.
+    forced = getenv("GBAEMU_FORCE_ISA");
+    if (forced && *forced) {
+        for (level = ISA_SCALAR; level < ISA_LEN; ++level) {
+            if (!strcmp(forced, isa_names[level])) {
+                break;
+            }
+        }
+
+        if (level == ISA_LEN) {
+            logln(HS_WARNING, "Unknown ISA \"%s\" in GBAEMU_FORCE_ISA, ignoring it.", forced);
+        } else if (!isa_table(level) || !isa_supported(level)) {
+            logln(HS_WARNING, "The ISA \"%s\" forced by GBAEMU_FORCE_ISA isn't supported by this host, ignoring it.", forced);
+        } else {
+            isa_selected = level;
+        }
+    }
+
+    isa_select_kernel(isa_selected, scanline_to_rgb555);
+    isa_select_kernel(isa_selected, run_length);
+    isa_select_kernel(isa_selected, search_filter);
+    isa_select_kernel(isa_selected, hash64_batch);
+
+    logln(HS_INFO, "Using the %s kernels.", isa_names[isa_selected]);
+}
+
+/*
+** Detect the extensions supported by the host and select the matching kernels.
+**
+** The result is shared by all the instances of the emulator, so only the first call
+** does anything.
+*/
+void
+isa_init(
+    void
+) {
+    pthread_once(&isa_once, isa_detect);
+}
+
+/*
+** Return the kernels of the given extension, or NULL if this build has none or the host
+** doesn't support it. The kernels the extension has no variant of are NULL.
+**
+** Used by `tools/isa_check.c` to compare each variant with the scalar one.
+*/
+struct isa_kernels const *
+isa_level_kernels(
+    enum isa_levels level
+) {
+    isa_init();
+    return ((isa_table(level) && isa_supported(level)) ? isa_table(level) : NULL);
+}
+
+/*
+** Return the extension the kernels were selected for.
+*/
+enum isa_levels
+isa_level(
+    void
+) {
+    isa_init();
+    return (isa_selected);
+}
@@ -0,0 +1,94 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+/*
+** AArch64 Advanced SIMD variants of the kernels.
+*/
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+#include "hs.h"
+#include "gba/gba.h"
+
+static_assert(sizeof(struct rich_color) == 3);
+
+/*
+** `vld3q_u8` de-interleaves 16 pixels into their low, high and flag bytes, the
+** flags are dropped and the two others are interleaved back.
+*/
+static
+void
+scanline_to_rgb555_neon(
+    uint16_t *dst,
+    struct rich_color const *src,
+    size_t len
+) {
+    uint8_t const *p;
+    size_t x;
+
+    p = (uint8_t const *)src;
+    for (x = 0; x + 16 <= len; x += 16) {
+        uint8x16x3_t in;
+        uint8x16x2_t out;
+
+        in = vld3q_u8(p + 3 * x);
+        out.val[0] = in.val[0];
+        out.val[1] = vandq_u8(in.val[1], vdupq_n_u8(0x7F));
+        vst2q_u8((uint8_t *)(dst + x), out);
+    }
+
+    for (; x < len; ++x) {
+        dst[x] = src[x].raw & 0x7FFF;
+    }
+}
+
+static
+size_t
+run_length_neon(
+    uint8_t const *data,
+    size_t size,
+    size_t max
+) {
+    uint8x16_t value;
+    size_t limit;
+    size_t n;
+
+    limit = min(size, max);
+    value = vdupq_n_u8(data[0]);
+
+    for (n = 0; n + 16 <= limit; n += 16) {
+        uint8x16_t eq;
+        uint64_t diff;
+
+        // Narrow the comparison to 4 bits per byte to test it as a single 64-bit word.
+        eq = vceqq_u8(vld1q_u8(data + n), value);
+        diff = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (diff) {
+            return (n + __builtin_ctzll(diff) / 4);
+        }
+    }
+
+    while (n < limit && data[n] == data[0]) {
+        ++n;
+    }
+    return (n);
+}
+
+struct isa_kernels const isa_kernels_neon = {
+    .scanline_to_rgb555 = scanline_to_rgb555_neon,
+    .run_length = run_length_neon,
+};
+
+#endif
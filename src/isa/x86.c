@@ -0,0 +1,557 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+/*
+** x86 variants of the kernels.
+**
+** Each function is compiled for its extension with `__attribute__((target))` so
+** the rest of the emulator keeps running on a baseline CPU. They must only be
+** called once `isa_init()` has checked the host supports them.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "hs.h"
+#include "gba/gba.h"
+
+static_assert(sizeof(struct rich_color) == 3);
+static_assert(ISA_HASH_BATCH == 8);
+
+/*
+** Pixels are 3 bytes wide in a scanline: two loads of 16 bytes, 12 bytes apart,
+** cover 8 of them and a shuffle packs their color into the low 16 bits.
+*/
+__attribute__((target("sse4.1")))
+static
+void
+scanline_to_rgb555_sse4_1(
+    uint16_t *dst,
+    struct rich_color const *src,
+    size_t len
+) {
+    uint8_t const *p;
+    __m128i shuffle;
+    __m128i mask;
+    size_t x;
+
+    p = (uint8_t const *)src;
+    shuffle = _mm_setr_epi8(0, 1, 3, 4, 6, 7, 9, 10, -1, -1, -1, -1, -1, -1, -1, -1);
+    mask = _mm_set1_epi16(0x7FFF);
+
+    // The second load reads up to byte `3 * x + 28`, which must stay within `src`.
+    for (x = 0; x + 10 <= len; x += 8) {
+        __m128i lo;
+        __m128i hi;
+
+        lo = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(p + 3 * x)), shuffle);
+        hi = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(p + 3 * x + 12)), shuffle);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_and_si128(_mm_unpacklo_epi64(lo, hi), mask));
+    }
+
+    for (; x < len; ++x) {
+        dst[x] = src[x].raw & 0x7FFF;
+    }
+}
+
+__attribute__((target("sse4.1")))
+static
+size_t
+run_length_sse4_1(
+    uint8_t const *data,
+    size_t size,
+    size_t max
+) {
+    __m128i value;
+    size_t limit;
+    size_t n;
+
+    limit = min(size, max);
+    value = _mm_set1_epi8((char)data[0]);
+
+    for (n = 0; n + 16 <= limit; n += 16) {
+        uint32_t diff;
+
+        diff = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)(data + n)), value)) & 0xFFFF;
+        if (diff) {
+            return (n + __builtin_ctz(diff));
+        }
+    }
+
+    while (n < limit && data[n] == data[0]) {
+        ++n;
+    }
+    return (n);
+}
+
+__attribute__((target("avx2")))
+static
+size_t
+run_length_avx2(
+    uint8_t const *data,
+    size_t size,
+    size_t max
+) {
+    __m256i value;
+    size_t limit;
+    size_t n;
+
+    limit = min(size, max);
+    value = _mm256_set1_epi8((char)data[0]);
+
+    for (n = 0; n + 32 <= limit; n += 32) {
+        uint32_t diff;
+
+        diff = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(data + n)), value));
+        if (diff) {
+            return (n + __builtin_ctz(diff));
+        }
+    }
+
+    while (n < limit && data[n] == data[0]) {
+        ++n;
+    }
+    return (n);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static
+size_t
+run_length_avx512(
+    uint8_t const *data,
+    size_t size,
+    size_t max
+) {
+    __m512i value;
+    size_t limit;
+    size_t n;
+
+    limit = min(size, max);
+    value = _mm512_set1_epi8((char)data[0]);
+
+    for (n = 0; n + 64 <= limit; n += 64) {
+        uint64_t diff;
+
+        diff = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((void const *)(data + n)), value);
+        if (diff) {
+            return (n + __builtin_ctzll(diff));
+        }
+    }
+
+    // Masked loads never fault on the bytes left out, so the tail needs no scalar loop.
+    if (n < limit) {
+        __mmask64 tail;
+        uint64_t diff;
+
+        tail = (1ull << (limit - n)) - 1;
+        diff = _mm512_mask_cmpneq_epi8_mask(tail, _mm512_maskz_loadu_epi8(tail, data + n), value);
+        if (diff) {
+            return (n + __builtin_ctzll(diff));
+        }
+    }
+    return (limit);
+}
+
+/*
+** The vector variants of `search_filter` only test equality, `a <= b` (`max(a, b) == b`) and
+** `a >= b` (`max(a, b) == a`), then invert the result to get the other comparisons.
+*/
+static inline
+bool
+search_inverted(
+    enum isa_compare cmp
+) {
+    return (cmp != ISA_CMP_EQ);
+}
+
+__attribute__((target("sse4.1")))
+static inline
+__m128i
+search_compare_sse4_1(
+    __m128i a,
+    __m128i b,
+    size_t width,
+    enum isa_compare cmp
+) {
+    switch (width) {
+        case 1: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm_cmpeq_epi8(_mm_max_epu8(a, b), b));
+                case ISA_CMP_LT:    return (_mm_cmpeq_epi8(_mm_max_epu8(a, b), a));
+                default:            return (_mm_cmpeq_epi8(a, b));
+            }
+        };
+        case 2: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm_cmpeq_epi16(_mm_max_epu16(a, b), b));
+                case ISA_CMP_LT:    return (_mm_cmpeq_epi16(_mm_max_epu16(a, b), a));
+                default:            return (_mm_cmpeq_epi16(a, b));
+            }
+        };
+        default: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm_cmpeq_epi32(_mm_max_epu32(a, b), b));
+                case ISA_CMP_LT:    return (_mm_cmpeq_epi32(_mm_max_epu32(a, b), a));
+                default:            return (_mm_cmpeq_epi32(a, b));
+            }
+        };
+    }
+}
+
+__attribute__((target("sse4.1")))
+static
+void
+search_filter_sse4_1(
+    uint64_t *bitmap,
+    uint8_t const *cur,
+    uint8_t const *ref,
+    size_t ref_step,
+    size_t size,
+    size_t width,
+    enum isa_compare cmp
+) {
+    uint64_t full;
+    size_t chunk;
+
+    full = (width == 1) ? UINT64_MAX : ((1ull << (ISA_SEARCH_CHUNK / width)) - 1);
+
+    for (chunk = 0; chunk < size / ISA_SEARCH_CHUNK; ++chunk) {
+        uint8_t const *a;
+        uint8_t const *b;
+        uint64_t bits;
+        uint64_t mask;
+        __m128i r[4];
+        size_t i;
+
+        bits = isa_search_chunk_bits(bitmap, chunk, width);
+        if (!bits) {
+            continue;
+        }
+
+        a = cur + chunk * ISA_SEARCH_CHUNK;
+        b = ref + chunk * ref_step;
+        for (i = 0; i < 4; ++i) {
+            r[i] = search_compare_sse4_1(
+                _mm_loadu_si128((__m128i const *)(a + 16 * i)),
+                _mm_loadu_si128((__m128i const *)(b + 16 * i)),
+                width,
+                cmp
+            );
+        }
+
+        switch (width) {
+            case 1: {
+                mask = (uint64_t)(uint16_t)_mm_movemask_epi8(r[0])
+                    | ((uint64_t)(uint16_t)_mm_movemask_epi8(r[1]) << 16)
+                    | ((uint64_t)(uint16_t)_mm_movemask_epi8(r[2]) << 32)
+                    | ((uint64_t)(uint16_t)_mm_movemask_epi8(r[3]) << 48)
+                ;
+                break;
+            };
+            case 2: {
+                mask = (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_packs_epi16(r[0], r[1]))
+                    | ((uint64_t)(uint16_t)_mm_movemask_epi8(_mm_packs_epi16(r[2], r[3])) << 16)
+                ;
+                break;
+            };
+            default: {
+                mask = (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(r[0]))
+                    | ((uint64_t)_mm_movemask_ps(_mm_castsi128_ps(r[1])) << 4)
+                    | ((uint64_t)_mm_movemask_ps(_mm_castsi128_ps(r[2])) << 8)
+                    | ((uint64_t)_mm_movemask_ps(_mm_castsi128_ps(r[3])) << 12)
+                ;
+                break;
+            };
+        }
+
+        if (search_inverted(cmp)) {
+            mask ^= full;
+        }
+
+        isa_search_chunk_store(bitmap, chunk, width, bits & mask);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline
+__m256i
+search_compare_avx2(
+    __m256i a,
+    __m256i b,
+    size_t width,
+    enum isa_compare cmp
+) {
+    switch (width) {
+        case 1: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), b));
+                case ISA_CMP_LT:    return (_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a));
+                default:            return (_mm256_cmpeq_epi8(a, b));
+            }
+        };
+        case 2: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm256_cmpeq_epi16(_mm256_max_epu16(a, b), b));
+                case ISA_CMP_LT:    return (_mm256_cmpeq_epi16(_mm256_max_epu16(a, b), a));
+                default:            return (_mm256_cmpeq_epi16(a, b));
+            }
+        };
+        default: {
+            switch (cmp) {
+                case ISA_CMP_GT:    return (_mm256_cmpeq_epi32(_mm256_max_epu32(a, b), b));
+                case ISA_CMP_LT:    return (_mm256_cmpeq_epi32(_mm256_max_epu32(a, b), a));
+                default:            return (_mm256_cmpeq_epi32(a, b));
+            }
+        };
+    }
+}
+
+__attribute__((target("avx2")))
+static
+void
+search_filter_avx2(
+    uint64_t *bitmap,
+    uint8_t const *cur,
+    uint8_t const *ref,
+    size_t ref_step,
+    size_t size,
+    size_t width,
+    enum isa_compare cmp
+) {
+    uint64_t full;
+    size_t chunk;
+
+    full = (width == 1) ? UINT64_MAX : ((1ull << (ISA_SEARCH_CHUNK / width)) - 1);
+
+    for (chunk = 0; chunk < size / ISA_SEARCH_CHUNK; ++chunk) {
+        uint8_t const *a;
+        uint8_t const *b;
+        uint64_t bits;
+        uint64_t mask;
+        __m256i lo;
+        __m256i hi;
+
+        bits = isa_search_chunk_bits(bitmap, chunk, width);
+        if (!bits) {
+            continue;
+        }
+
+        a = cur + chunk * ISA_SEARCH_CHUNK;
+        b = ref + chunk * ref_step;
+        lo = search_compare_avx2(_mm256_loadu_si256((__m256i const *)a), _mm256_loadu_si256((__m256i const *)b), width, cmp);
+        hi = search_compare_avx2(_mm256_loadu_si256((__m256i const *)(a + 32)), _mm256_loadu_si256((__m256i const *)(b + 32)), width, cmp);
+
+        switch (width) {
+            case 1: {
+                mask = (uint64_t)(uint32_t)_mm256_movemask_epi8(lo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32);
+                break;
+            };
+            case 2: {
+                // The pack works within each 128-bit lane, the permutation puts the elements back in order.
+                mask = (uint32_t)_mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8));
+                break;
+            };
+            default: {
+                mask = (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(lo)) | ((uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(hi)) << 8);
+                break;
+            };
+        }
+
+        if (search_inverted(cmp)) {
+            mask ^= full;
+        }
+
+        isa_search_chunk_store(bitmap, chunk, width, bits & mask);
+    }
+}
+
+/*
+** AVX-512 compares unsigned integers directly into a mask, one chunk at a time.
+*/
+__attribute__((target("avx512f,avx512bw")))
+static inline
+uint64_t
+search_compare_avx512(
+    __m512i a,
+    __m512i b,
+    size_t width,
+    enum isa_compare cmp
+) {
+    switch (width) {
+        case 1: {
+            switch (cmp) {
+                case ISA_CMP_EQ:    return (_mm512_cmp_epu8_mask(a, b, _MM_CMPINT_EQ));
+                case ISA_CMP_NE:    return (_mm512_cmp_epu8_mask(a, b, _MM_CMPINT_NE));
+                case ISA_CMP_GT:    return (_mm512_cmp_epu8_mask(a, b, _MM_CMPINT_NLE));
+                default:            return (_mm512_cmp_epu8_mask(a, b, _MM_CMPINT_LT));
+            }
+        };
+        case 2: {
+            switch (cmp) {
+                case ISA_CMP_EQ:    return (_mm512_cmp_epu16_mask(a, b, _MM_CMPINT_EQ));
+                case ISA_CMP_NE:    return (_mm512_cmp_epu16_mask(a, b, _MM_CMPINT_NE));
+                case ISA_CMP_GT:    return (_mm512_cmp_epu16_mask(a, b, _MM_CMPINT_NLE));
+                default:            return (_mm512_cmp_epu16_mask(a, b, _MM_CMPINT_LT));
+            }
+        };
+        default: {
+            switch (cmp) {
+                case ISA_CMP_EQ:    return (_mm512_cmp_epu32_mask(a, b, _MM_CMPINT_EQ));
+                case ISA_CMP_NE:    return (_mm512_cmp_epu32_mask(a, b, _MM_CMPINT_NE));
+                case ISA_CMP_GT:    return (_mm512_cmp_epu32_mask(a, b, _MM_CMPINT_NLE));
+                default:            return (_mm512_cmp_epu32_mask(a, b, _MM_CMPINT_LT));
+            }
+        };
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static
+void
+search_filter_avx512(
+    uint64_t *bitmap,
+    uint8_t const *cur,
+    uint8_t const *ref,
+    size_t ref_step,
+    size_t size,
+    size_t width,
+    enum isa_compare cmp
+) {
+    size_t chunk;
+
+    for (chunk = 0; chunk < size / ISA_SEARCH_CHUNK; ++chunk) {
+        uint64_t bits;
+
+        bits = isa_search_chunk_bits(bitmap, chunk, width);
+        if (!bits) {
+            continue;
+        }
+
+        bits &= search_compare_avx512(
+            _mm512_loadu_si512((void const *)(cur + chunk * ISA_SEARCH_CHUNK)),
+            _mm512_loadu_si512((void const *)(ref + chunk * ref_step)),
+            width,
+            cmp
+        );
+        isa_search_chunk_store(bitmap, chunk, width, bits);
+    }
+}
+
+/*
+** The 256-bit state of two hashes fills a 512-bit register, so four registers carry the eight
+** hashes of a batch. AVX-512DQ multiplies 64-bit lanes directly; AVX2, which has to build that
+** multiplication out of 32-bit ones, is slower than the scalar code and has no variant.
+*/
+__attribute__((target("avx512f,avx512dq")))
+static inline
+__m512i
+hash64_round_avx512(
+    __m512i acc,
+    uint8_t const *lo,
+    uint8_t const *hi,
+    __m512i prime1,
+    __m512i prime2
+) {
+    __m512i input;
+
+    input = _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm256_loadu_si256((__m256i const *)lo)),
+        _mm256_loadu_si256((__m256i const *)hi),
+        1
+    );
+    acc = _mm512_add_epi64(acc, _mm512_mullo_epi64(input, prime2));
+    acc = _mm512_rol_epi64(acc, 31);
+    return (_mm512_mullo_epi64(acc, prime1));
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static
+void
+hash64_batch_avx512(
+    uint64_t *hashes,
+    uint8_t const * const *data,
+    uint64_t const *seeds,
+    size_t count,
+    size_t size
+) {
+    uint8_t const *src[ISA_HASH_BATCH];
+    uint64_t lanes[ISA_HASH_BATCH * 4];
+    __m512i prime1;
+    __m512i prime2;
+    __m512i v[4];
+    size_t i;
+    size_t k;
+
+    if (size < 32) {
+        for (k = 0; k < count; ++k) {
+            hashes[k] = hs_hash64(data[k], size, seeds[k]);
+        }
+        return;
+    }
+
+    // The missing buffers are replaced by the first one and their hash is dropped.
+    for (k = 0; k < ISA_HASH_BATCH; ++k) {
+        uint64_t seed;
+
+        src[k] = data[k < count ? k : 0];
+        seed = seeds[k < count ? k : 0];
+        lanes[4 * k + 0] = seed + HS_HASH64_PRIME1 + HS_HASH64_PRIME2;
+        lanes[4 * k + 1] = seed + HS_HASH64_PRIME2;
+        lanes[4 * k + 2] = seed;
+        lanes[4 * k + 3] = seed - HS_HASH64_PRIME1;
+    }
+
+    prime1 = _mm512_set1_epi64((long long)HS_HASH64_PRIME1);
+    prime2 = _mm512_set1_epi64((long long)HS_HASH64_PRIME2);
+    v[0] = _mm512_loadu_si512((void const *)(lanes + 0));
+    v[1] = _mm512_loadu_si512((void const *)(lanes + 8));
+    v[2] = _mm512_loadu_si512((void const *)(lanes + 16));
+    v[3] = _mm512_loadu_si512((void const *)(lanes + 24));
+
+    for (i = 0; i + 32 <= size; i += 32) {
+        v[0] = hash64_round_avx512(v[0], src[0] + i, src[1] + i, prime1, prime2);
+        v[1] = hash64_round_avx512(v[1], src[2] + i, src[3] + i, prime1, prime2);
+        v[2] = hash64_round_avx512(v[2], src[4] + i, src[5] + i, prime1, prime2);
+        v[3] = hash64_round_avx512(v[3], src[6] + i, src[7] + i, prime1, prime2);
+    }
+
+    _mm512_storeu_si512((void *)(lanes + 0), v[0]);
+    _mm512_storeu_si512((void *)(lanes + 8), v[1]);
+    _mm512_storeu_si512((void *)(lanes + 16), v[2]);
+    _mm512_storeu_si512((void *)(lanes + 24), v[3]);
+
+    for (k = 0; k < count; ++k) {
+        hashes[k] = hs_hash64_finish(hs_hash64_converge(lanes + 4 * k), src[k] + i, src[k] + size, size);
+    }
+}
+
+struct isa_kernels const isa_kernels_sse4_1 = {
+    .scanline_to_rgb555 = scanline_to_rgb555_sse4_1,
+    .run_length = run_length_sse4_1,
+    .search_filter = search_filter_sse4_1,
+};
+
+// Scanlines are too short for wider vectors to pay for the extra shuffling.
+struct isa_kernels const isa_kernels_avx2 = {
+    .run_length = run_length_avx2,
+    .search_filter = search_filter_avx2,
+};
+
+struct isa_kernels const isa_kernels_avx512 = {
+    .run_length = run_length_avx512,
+    .search_filter = search_filter_avx512,
+    .hash64_batch = hash64_batch_avx512,
+};
+
+#endif
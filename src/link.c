@@ -0,0 +1,689 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gba/gba.h"
+#include "gba/link.h"
+
+#define LINK_DEFAULT_COARSE_CYCLES  (GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH)
+#define LINK_DEFAULT_FINE_CYCLES    64
+
+// How long an instance waits for the others before going back to `gba_run()` to process its messages.
+#define LINK_WAIT_TIMEOUT_NSEC      (1000 * 1000)
+
+enum link_modes {
+    LINK_MODE_NORMAL_8 = 0,
+    LINK_MODE_NORMAL_32,
+    LINK_MODE_MULTIPLAYER,
+    LINK_MODE_UART,
+};
+
+struct link_member {
+    struct gba *gba;                // NULL if the slot is free.
+    bool active;                    // A game is loaded.
+
+    // Cycles elapsed on the hub's timeline, as of the last time the instance stopped running.
+    uint64_t time;
+
+    // What the player puts on the cable: REG_SIOMLT_SEND (or REG_SIODATA8) and REG_SIODATA32.
+    uint16_t send;
+    uint32_t data32;
+
+    // Set in Normal mode when the player is waiting for its partner to clock a transfer.
+    bool ready;
+};
+
+struct link_transfer {
+    uint32_t id;
+    bool active;
+    enum link_modes mode;
+
+    // When it ends, on the hub's timeline.
+    uint64_t end;
+
+    // The slots taking part in the transfer that didn't reach its end yet.
+    uint32_t pending;
+    uint32_t players;
+
+    // What each slot receives, latched by the first player reaching the end.
+    bool latched;
+    uint32_t data[LINK_MAX_PLAYERS];
+};
+
+struct link_hub {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t waiting;
+
+    uint64_t coarse_cycles;
+    uint64_t fine_cycles;
+
+    struct link_member members[LINK_MAX_PLAYERS];
+    struct link_transfer transfer;
+};
+
+/*
+** Create a hub. While no transfer is in flight, the instances connected to it can't run more than
+** `coarse_cycles` ahead of each other, and `fine_cycles` while one is.
+** 0 selects the default value of either.
+*/
+struct link_hub *
+link_hub_create(
+    uint32_t coarse_cycles,
+    uint32_t fine_cycles
+) {
+    struct link_hub *hub;
+
+    hub = calloc(1, sizeof(struct link_hub));
+    hs_assert(hub);
+
+    pthread_mutex_init(&hub->lock, NULL);
+    pthread_cond_init(&hub->cond, NULL);
+
+    hub->coarse_cycles = coarse_cycles ? coarse_cycles : LINK_DEFAULT_COARSE_CYCLES;
+    hub->fine_cycles = min(fine_cycles ? fine_cycles : LINK_DEFAULT_FINE_CYCLES, hub->coarse_cycles);
+
+    return (hub);
+}
+
+/*
+** Delete a hub. All the instances must have been detached from it, or deleted.
+*/
+void
+link_hub_delete(
+    struct link_hub *hub
+) {
+    if (hub) {
+        pthread_mutex_destroy(&hub->lock);
+        pthread_cond_destroy(&hub->cond);
+    }
+    free(hub);
+}
+
+static
+uint64_t
+link_local_time(
+    struct gba const *gba
+) {
+    return (gba->scheduler.cycles - gba->link.base);
+}
+
+static
+void
+link_wake_up(
+    struct link_hub *hub
+) {
+    if (hub->waiting) {
+        pthread_cond_broadcast(&hub->cond);
+    }
+}
+
+static
+uint32_t
+link_count_players(
+    struct link_hub const *hub
+) {
+    uint32_t players;
+    uint32_t i;
+
+    players = 0;
+    for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+        players += hub->members[i].gba && hub->members[i].active;
+    }
+    return (players);
+}
+
+/*
+** Remove `slot` from the transfer in flight, if it takes part in it.
+** The hub must be locked.
+*/
+static
+void
+link_leave_transfer(
+    struct link_hub *hub,
+    uint32_t slot
+) {
+    hub->transfer.pending &= ~(1u << slot);
+    if (!hub->transfer.pending) {
+        hub->transfer.active = false;
+    }
+    link_wake_up(hub);
+}
+
+/*
+** Put the instance on the hub's timeline, next to the slowest of the other players.
+** `active` is true if a game is loaded. The hub must be locked.
+*/
+static
+void
+link_join(
+    struct gba *gba,
+    bool active
+) {
+    struct link_hub *hub;
+    struct link_member *member;
+    uint64_t time;
+    uint32_t i;
+
+    hub = gba->link.hub;
+    member = &hub->members[gba->link.slot];
+
+    time = UINT64_MAX;
+    for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+        if (i != gba->link.slot && hub->members[i].gba && hub->members[i].active) {
+            time = min(time, hub->members[i].time);
+        }
+    }
+
+    member->time = (time == UINT64_MAX) ? 0 : time;
+    member->active = active;
+    member->send = gba->io.siomlt_send.raw;
+    member->data32 = gba->io.siomulti[0].raw | ((uint32_t)gba->io.siomulti[1].raw << 16);
+    member->ready = false;
+
+    gba->io.pending.siocnt.raw = gba->io.siocnt.raw;
+    gba->link.base = gba->scheduler.cycles - member->time;
+    gba->link.transfer = 0;
+
+    link_wake_up(hub);
+}
+
+/*
+** Plug `gba` into `slot` of `hub`, which must be free.
+** `gba_run()` must not be running.
+*/
+bool
+link_hub_attach(
+    struct link_hub *hub,
+    struct gba *gba,
+    uint32_t slot
+) {
+    if (slot >= LINK_MAX_PLAYERS) {
+        logln(HS_ERROR, "Invalid link slot %u.", slot);
+        return (false);
+    }
+
+    pthread_mutex_lock(&hub->lock);
+
+    if (hub->members[slot].gba) {
+        pthread_mutex_unlock(&hub->lock);
+        logln(HS_ERROR, "Link slot %u is already taken.", slot);
+        return (false);
+    }
+
+    hub->members[slot].gba = gba;
+    gba->link.hub = hub;
+    gba->link.slot = slot;
+    link_join(gba, gba->state != GBA_STATE_STOP);
+
+    pthread_mutex_unlock(&hub->lock);
+    return (true);
+}
+
+/*
+** Unplug `gba` from its hub, if any.
+** `gba_run()` must not be running.
+*/
+void
+link_hub_detach(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+
+    hub = gba->link.hub;
+    if (!hub) {
+        return;
+    }
+
+    pthread_mutex_lock(&hub->lock);
+    memset(&hub->members[gba->link.slot], 0, sizeof(struct link_member));
+    link_leave_transfer(hub, gba->link.slot);
+    pthread_mutex_unlock(&hub->lock);
+
+    memset(&gba->link, 0, sizeof(gba->link));
+}
+
+/*
+** Called when the instance is reset or its state is replaced, so it joins back the other players.
+*/
+void
+link_reset(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+
+    hub = gba->link.hub;
+    if (!hub) {
+        return;
+    }
+
+    pthread_mutex_lock(&hub->lock);
+    link_leave_transfer(hub, gba->link.slot);
+    link_join(gba, true);
+    pthread_mutex_unlock(&hub->lock);
+}
+
+/*
+** Called when the game is unloaded, so the other players don't wait for the instance anymore.
+*/
+void
+link_stop(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+
+    hub = gba->link.hub;
+    if (!hub) {
+        return;
+    }
+
+    pthread_mutex_lock(&hub->lock);
+    hub->members[gba->link.slot].active = false;
+    hub->members[gba->link.slot].ready = false;
+    link_leave_transfer(hub, gba->link.slot);
+    pthread_mutex_unlock(&hub->lock);
+}
+
+/*
+** Schedule the end of the transfer in flight if the instance takes part in it and didn't yet.
+** The hub must be locked.
+*/
+static
+void
+link_pick_up_transfer(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+    struct link_transfer *transfer;
+    struct link_member *member;
+
+    hub = gba->link.hub;
+    transfer = &hub->transfer;
+    member = &hub->members[gba->link.slot];
+
+    if (!transfer->active || !(transfer->pending & (1u << gba->link.slot)) || gba->link.transfer == transfer->id) {
+        return;
+    }
+
+    gba->link.transfer = transfer->id;
+
+    // Players already past the end because of the skew allowed before the transfer started end it right away.
+    sched_add_event(
+        gba,
+        NEW_FIX_EVENT_ARGS(
+            SCHED_EVENT_LINK_TRANSFER,
+            gba->link.base + max(transfer->end, member->time),
+            EVENT_ARG(u32, transfer->id)
+        )
+    );
+
+    if (transfer->mode == LINK_MODE_MULTIPLAYER) {
+        gba->io.siocnt.multi.start = true;
+    }
+}
+
+/*
+** Run the instance for at most a scanline, without going further than the other players allow.
+*/
+void
+link_run(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+    struct link_member *member;
+    uint64_t horizon;
+    uint64_t quantum;
+    uint32_t i;
+
+    hub = gba->link.hub;
+    member = &hub->members[gba->link.slot];
+
+    pthread_mutex_lock(&hub->lock);
+
+    member->time = link_local_time(gba);
+    link_pick_up_transfer(gba);
+
+    quantum = hub->transfer.active ? hub->fine_cycles : hub->coarse_cycles;
+    horizon = UINT64_MAX;
+    for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+        if (i != gba->link.slot && hub->members[i].gba && hub->members[i].active) {
+            horizon = min(horizon, hub->members[i].time + quantum);
+        }
+    }
+
+    if (member->time >= horizon) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LINK_WAIT_TIMEOUT_NSEC;
+        if (deadline.tv_nsec >= 1000 * 1000 * 1000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000 * 1000 * 1000;
+        }
+
+        ++hub->waiting;
+        pthread_cond_timedwait(&hub->cond, &hub->lock, &deadline);
+        --hub->waiting;
+
+        pthread_mutex_unlock(&hub->lock);
+        return;
+    }
+
+    pthread_mutex_unlock(&hub->lock);
+
+    sched_run_for(gba, min(horizon - member->time, (uint64_t)(GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH)));
+
+    pthread_mutex_lock(&hub->lock);
+    member->time = link_local_time(gba);
+    link_wake_up(hub);
+    pthread_mutex_unlock(&hub->lock);
+}
+
+/*
+** Publish what the player puts on the cable after a write to one of the data registers.
+*/
+void
+link_write_data(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+    struct link_member *member;
+
+    hub = gba->link.hub;
+    if (!hub || gba->run_ahead.speculating) {
+        return;
+    }
+
+    member = &hub->members[gba->link.slot];
+
+    pthread_mutex_lock(&hub->lock);
+    member->send = gba->io.siomlt_send.raw;
+    member->data32 = gba->io.siomulti[0].raw | ((uint32_t)gba->io.siomulti[1].raw << 16);
+    pthread_mutex_unlock(&hub->lock);
+}
+
+/*
+** Return how many cycles a transfer started with the current value of REG_SIOCNT lasts.
+**
+** In Multiplayer mode, each player sends a start bit, 16 data bits and a stop bit in turn.
+*/
+static
+uint64_t
+link_transfer_duration(
+    struct io const *io,
+    uint32_t players
+) {
+    static uint32_t const bauds[] = { 9600, 38400, 57600, 115200 };
+    uint64_t cycles_per_bit;
+
+    if (io->siocnt.mode == LINK_MODE_MULTIPLAYER) {
+        return (GBA_CYCLES_PER_SECOND / bauds[io->siocnt.multi.baud_rate] * 18 * players);
+    }
+
+    // 256KHz or 2MHz
+    cycles_per_bit = io->siocnt.internal_shift_clock ? 8 : 64;
+    return (cycles_per_bit * (io->siocnt.mode == LINK_MODE_NORMAL_32 ? 32 : 8));
+}
+
+/*
+** Start a transfer clocked by the instance.
+** The hub must be locked and no other transfer be in flight.
+*/
+static
+void
+link_start_transfer(
+    struct gba *gba,
+    uint32_t players
+) {
+    struct link_hub *hub;
+    struct link_transfer *transfer;
+    uint32_t i;
+
+    hub = gba->link.hub;
+    transfer = &hub->transfer;
+
+    transfer->id += 1;
+    transfer->active = true;
+    transfer->mode = gba->io.siocnt.mode;
+    transfer->players = players;
+    transfer->pending = players;
+    transfer->latched = false;
+    transfer->end = link_local_time(gba) + link_transfer_duration(&gba->io, __builtin_popcount(players));
+
+    for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+        transfer->data[i] = UINT32_MAX;
+    }
+
+    hub->members[gba->link.slot].time = link_local_time(gba);
+    link_pick_up_transfer(gba);
+
+    // The others run with a finer granularity from now on.
+    link_wake_up(hub);
+}
+
+/*
+** Handle a write to REG_SIOCNT, and return false if it should be stubbed because the instance
+** isn't connected or the mode isn't emulated.
+**
+** Called once the write is complete (see `io_register_delayed_write()`), as the start bit and
+** the mode are in different bytes.
+*/
+bool
+link_write_siocnt(
+    struct gba *gba
+) {
+    struct link_hub *hub;
+    struct link_member *member;
+    struct link_transfer *transfer;
+    struct io *io;
+    uint32_t slot;
+    bool busy;
+
+    hub = gba->link.hub;
+    io = &gba->io;
+
+    // The General Purpose and JOY Bus modes aren't emulated.
+    if (!hub || gba->run_ahead.speculating || (io->rcnt.raw & 0x8000) || io->siocnt.mode == LINK_MODE_UART) {
+        return (false);
+    }
+
+    slot = gba->link.slot;
+    member = &hub->members[slot];
+    transfer = &hub->transfer;
+
+    pthread_mutex_lock(&hub->lock);
+
+    busy = transfer->active && (transfer->pending & (1u << slot)) && gba->link.transfer == transfer->id;
+
+    if (io->siocnt.mode == LINK_MODE_MULTIPLAYER) {
+        io->siocnt.multi.id = slot;
+        io->siocnt.multi.si_terminal = (slot != 0);
+        io->siocnt.multi.sd_terminal = (link_count_players(hub) > 1);
+
+        // Only the parent can start a transfer, and the busy flag is read-only.
+        if (io->siocnt.multi.start && !busy && slot == 0 && !transfer->active) {
+            uint32_t players;
+            uint32_t i;
+
+            players = 0;
+            for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+                if (hub->members[i].gba && hub->members[i].active) {
+                    players |= 1u << i;
+                }
+            }
+
+            link_start_transfer(gba, players);
+        } else {
+            io->siocnt.multi.start = busy;
+        }
+    } else if (busy) {
+        io->siocnt.start = true;
+    } else if (io->siocnt.start && !io->siocnt.shift_clock) {
+        // External clock: wait for the partner to clock the transfer.
+        member->ready = true;
+    } else if (io->siocnt.start && !transfer->active) {
+        struct link_member const *partner;
+        uint32_t players;
+
+        partner = &hub->members[slot ^ 1];
+        players = 1u << slot;
+        if (partner->gba && partner->active && partner->ready) {
+            players |= 1u << (slot ^ 1);
+        }
+
+        member->ready = false;
+        link_start_transfer(gba, players);
+    } else {
+        member->ready = false;
+
+        // Another transfer is in flight: this one won't happen.
+        io->siocnt.start = false;
+    }
+
+    pthread_mutex_unlock(&hub->lock);
+    return (true);
+}
+
+/*
+** Latch what each player of the transfer receives.
+** The hub must be locked.
+*/
+static
+void
+link_latch_transfer(
+    struct link_hub *hub
+) {
+    struct link_transfer *transfer;
+    uint32_t i;
+
+    transfer = &hub->transfer;
+    for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+        struct link_member const *member;
+
+        if (!(transfer->players & (1u << i))) {
+            continue;
+        }
+
+        member = &hub->members[i];
+        switch (transfer->mode) {
+            case LINK_MODE_MULTIPLAYER: {
+                transfer->data[i] = member->send;
+                break;
+            };
+            case LINK_MODE_NORMAL_32: {
+                transfer->data[i ^ 1] = member->data32;
+                break;
+            };
+            case LINK_MODE_NORMAL_8: {
+                transfer->data[i ^ 1] = member->send & 0xFF;
+                break;
+            };
+            default: break;
+        }
+    }
+    transfer->latched = true;
+}
+
+/*
+** Write what the instance received to its registers.
+** A player whose partner isn't plugged in reads all ones, as the line is pulled high.
+*/
+static
+void
+link_receive(
+    struct gba *gba,
+    enum link_modes mode,
+    uint32_t const *data
+) {
+    struct io *io;
+    uint32_t i;
+
+    io = &gba->io;
+    switch (mode) {
+        case LINK_MODE_MULTIPLAYER: {
+            for (i = 0; i < LINK_MAX_PLAYERS; ++i) {
+                io->siomulti[i].raw = data ? data[i] : 0xFFFF;
+            }
+            io->siocnt.multi.id = gba->link.slot;
+            io->siocnt.multi.error = false;
+            break;
+        };
+        case LINK_MODE_NORMAL_32: {
+            io->siomulti[0].raw = data ? data[gba->link.slot] : 0xFFFF;
+            io->siomulti[1].raw = data ? data[gba->link.slot] >> 16 : 0xFFFF;
+            break;
+        };
+        case LINK_MODE_NORMAL_8: {
+            io->siomlt_send.bytes[0] = data ? data[gba->link.slot] : 0xFF;
+            break;
+        };
+        default: break;
+    }
+
+    io->siocnt.start = false;
+    io->pending.siocnt.raw = io->siocnt.raw;
+    if (io->siocnt.irq) {
+        core_schedule_irq(gba, IRQ_SERIAL);
+    }
+}
+
+/*
+** Scheduler event: the transfer identified by `args.a1` reaches its end on this instance.
+*/
+void
+link_transfer_end(
+    struct gba *gba,
+    struct event_args args
+) {
+    struct link_hub *hub;
+    struct link_transfer *transfer;
+    uint32_t data[LINK_MAX_PLAYERS];
+    enum link_modes mode;
+    uint32_t slot;
+
+    hub = gba->link.hub;
+    slot = gba->link.slot;
+
+    // Frames run ahead, instances unplugged since and transfers left in a quicksave end alone.
+    if (!hub || gba->run_ahead.speculating) {
+        link_receive(gba, gba->io.siocnt.mode, NULL);
+        return;
+    }
+
+    pthread_mutex_lock(&hub->lock);
+
+    transfer = &hub->transfer;
+    if (!transfer->active || transfer->id != args.a1.u32 || !(transfer->pending & (1u << slot))) {
+        pthread_mutex_unlock(&hub->lock);
+        link_receive(gba, gba->io.siocnt.mode, NULL);
+        return;
+    }
+
+    if (!transfer->latched) {
+        link_latch_transfer(hub);
+    }
+
+    mode = transfer->mode;
+    memcpy(data, transfer->data, sizeof(data));
+
+    hub->members[slot].ready = false;
+    link_leave_transfer(hub, slot);
+
+    pthread_mutex_unlock(&hub->lock);
+
+    link_receive(gba, mode, data);
+}
@@ -81,6 +81,118 @@ mem_io_dma_ctl_write8(
     }
 }
 
+/*
+** Return true if `addr` is a cartridge address mapped to the EEPROM.
+*/
+static inline
+bool
+dma_is_eeprom_addr(
+    struct gba const *gba,
+    uint32_t addr
+) {
+    struct eeprom const *eeprom;
+
+    eeprom = &gba->memory.backup_storage.chip.eeprom;
+    return (
+           (addr >> 24) >= CART_REGION_START
+        && (addr >> 24) <= CART_REGION_END
+        && (addr & eeprom->mask) == eeprom->range
+    );
+}
+
+/*
+** Perform a whole DMA transfer between a RAM buffer and the EEPROM at once.
+**
+** Games talk to the EEPROM through DMA3 transfers of one bit per half-word. Instead of going
+** through the memory bus for each of them, the whole stream is handed to the EEPROM and the
+** cycles of all the accesses are charged in one go.
+**
+** This is only done when the RAM side is a contiguous EWRAM/IWRAM buffer walked forward and no
+** scheduler event is due before the end of the transfer, so that the outcome is exactly the
+** same as with `dma_run_channel()`'s regular loop. Otherwise, nothing is done.
+**
+** On success, `channel->internal_count` is 0.
+*/
+static
+void
+dma_run_eeprom_transfer(
+    struct gba *gba,
+    struct dma_channel *channel,
+    int32_t src_step,
+    int32_t dst_step
+) {
+    uint32_t count;
+    uint32_t src;
+    uint32_t dst;
+    uint32_t cycles;
+    uint32_t i;
+    uint16_t *ram;
+    bool to_eeprom;
+
+    if (
+           (gba->memory.backup_storage.type != BACKUP_EEPROM_4K && gba->memory.backup_storage.type != BACKUP_EEPROM_64K)
+        || channel->control.unit_size
+        || channel->is_fifo
+        || !channel->internal_count
+        || gba->core.reenter_dma_transfer_loop
+    ) {
+        return;
+    }
+
+#ifdef WITH_DEBUGGER
+    if (gba->debugger.watchpoints.len) {
+        return;
+    }
+#endif
+
+    count = channel->internal_count;
+    src = channel->internal_src;
+    dst = channel->internal_dst;
+
+    // The EEPROM side is always walked forward, like any other ROM access made by a DMA.
+    if (dma_is_eeprom_addr(gba, dst) && dma_is_eeprom_addr(gba, dst + 2 * (count - 1)) && src_step == 2) {
+        to_eeprom = true;
+    } else if (dma_is_eeprom_addr(gba, src) && dma_is_eeprom_addr(gba, src + 2 * (count - 1)) && dst_step == 2) {
+        to_eeprom = false;
+    } else {
+        return;
+    }
+
+    if (!mem_ram_span(gba, to_eeprom ? src : dst, count * sizeof(uint16_t), false)) {
+        return;
+    }
+
+    // Only the first access to the cartridge is non-sequential.
+    cycles = 0;
+    for (i = 0; i < count; ++i) {
+        cycles += mem_access_cycles(gba, src + 2 * i, sizeof(uint16_t), (!to_eeprom && !i) ? NON_SEQUENTIAL : SEQUENTIAL);
+        cycles += mem_access_cycles(gba, dst + 2 * i, sizeof(uint16_t), (to_eeprom && !i) ? NON_SEQUENTIAL : SEQUENTIAL);
+    }
+
+    if (gba->scheduler.cycles + cycles >= gba->scheduler.next_event) {
+        return;
+    }
+
+    if (to_eeprom) {
+        ram = mem_ram_span(gba, src, count * sizeof(uint16_t), false);
+        mem_eeprom_write_stream(gba, ram, count);
+    } else {
+        ram = mem_ram_span(gba, dst, count * sizeof(uint16_t), true);
+        mem_eeprom_read_stream(gba, ram, count);
+    }
+
+    logln(HS_DMA, "EEPROM transfer of %u bits done in one go (%u cycles)", count, cycles);
+
+    channel->latch = ((uint32_t)ram[count - 1] << 16) | ram[count - 1];
+    channel->internal_src = src + 2 * count;
+    channel->internal_dst = dst + 2 * count;
+    channel->internal_count = 0;
+    gba->memory.dma_bus = channel->latch;
+    gba->memory.was_last_access_from_dma = true;
+    gba->memory.gamepak_bus_in_use = to_eeprom;
+    core_idle_for(gba, cycles);
+}
+
 /*
 ** Run a single DMA transfer.
 */
@@ -131,6 +243,8 @@ dma_run_channel(
         channel->index
     );
 
+    dma_run_eeprom_transfer(gba, channel, src_step, dst_step);
+
     rom_accessed = false;
     access_src = SEQUENTIAL;
     access_dst = SEQUENTIAL;
@@ -153,7 +153,12 @@ mem_io_reg_name(
         case IO_REG_IME:            return ("ime");
         case IO_REG_POSTFLG:        return ("postflg");
         case IO_REG_HALTCNT:        return ("haltcnt");
+        case IO_REG_SIOMULTI0:      return ("siomulti0");
+        case IO_REG_SIOMULTI1:      return ("siomulti1");
+        case IO_REG_SIOMULTI2:      return ("siomulti2");
+        case IO_REG_SIOMULTI3:      return ("siomulti3");
         case IO_REG_SIOCNT:         return ("siocnt");
+        case IO_REG_SIOMLT_SEND:    return ("siomlt_send");
         case IO_REG_RCNT:           return ("rcnt");
         default:                    return ("<unknown>");
     }
@@ -331,8 +336,18 @@ mem_io_read8(
         case IO_REG_KEYCNT + 1:             return (io->keycnt.bytes[1]);
 
         /* Serial communication */
+        case IO_REG_SIOMULTI0:              return (io->siomulti[0].bytes[0]);
+        case IO_REG_SIOMULTI0 + 1:          return (io->siomulti[0].bytes[1]);
+        case IO_REG_SIOMULTI1:              return (io->siomulti[1].bytes[0]);
+        case IO_REG_SIOMULTI1 + 1:          return (io->siomulti[1].bytes[1]);
+        case IO_REG_SIOMULTI2:              return (io->siomulti[2].bytes[0]);
+        case IO_REG_SIOMULTI2 + 1:          return (io->siomulti[2].bytes[1]);
+        case IO_REG_SIOMULTI3:              return (io->siomulti[3].bytes[0]);
+        case IO_REG_SIOMULTI3 + 1:          return (io->siomulti[3].bytes[1]);
         case IO_REG_SIOCNT:                 return (io->siocnt.bytes[0]);
         case IO_REG_SIOCNT + 1:             return (io->siocnt.bytes[1]);
+        case IO_REG_SIOMLT_SEND:            return (io->siomlt_send.bytes[0]);
+        case IO_REG_SIOMLT_SEND + 1:        return (io->siomlt_send.bytes[1]);
         case IO_REG_RCNT:                   return (io->rcnt.bytes[0]);
         case IO_REG_RCNT + 1:               return (io->rcnt.bytes[1]);
         case IO_REG_IR:                     return (0);
@@ -364,6 +379,21 @@ mem_io_read8(
     return (mem_openbus_read(gba, addr));
 }
 
+/*
+** Serial transfers that aren't emulated end as soon as they start.
+*/
+static
+void
+io_sio_stub(
+    struct gba *gba
+) {
+    if (gba->io.siocnt.start && gba->io.siocnt.irq) {
+        core_schedule_irq(gba, IRQ_SERIAL);
+    }
+
+    gba->io.siocnt.start = false;
+}
+
 /*
 ** Write the given value to the corresponding IO register.
 */
@@ -746,16 +776,28 @@ mem_io_write8(
         };
 
         /* Serial communication */
+        case IO_REG_SIOMULTI0 ... IO_REG_SIOMULTI3 + 1: {
+            io->siomulti[(addr - IO_REG_SIOMULTI0) / 2].bytes[addr % 2] = val;
+            link_write_data(gba);
+            break;
+        };
+        case IO_REG_SIOMLT_SEND:
+        case IO_REG_SIOMLT_SEND + 1: {
+            io->siomlt_send.bytes[addr - IO_REG_SIOMLT_SEND] = val;
+            link_write_data(gba);
+            break;
+        };
         case IO_REG_SIOCNT:
         case IO_REG_SIOCNT + 1: {
-            io->siocnt.bytes[addr - IO_REG_SIOCNT] = val;
-
-            /* Stub */
-            if (io->siocnt.start && io->siocnt.irq) {
-                core_schedule_irq(gba, IRQ_SERIAL);
+            // Transfers are only emulated between instances plugged into a link cable.
+            if (gba->link.hub) {
+                io->pending.siocnt.bytes[addr - IO_REG_SIOCNT] = val;
+                io_schedule_register_delayed_write(gba, IO_REG_SIOCNT);
+                break;
             }
 
-            io->siocnt.start = false;
+            io->siocnt.bytes[addr - IO_REG_SIOCNT] = val;
+            io_sio_stub(gba);
             break;
         };
 
@@ -807,6 +849,10 @@ mem_io_write8(
 
             gba->memory.pbuffer.enabled = gba->settings.prefetch_buffer && io->waitcnt.gamepak_prefetch;
 
+            // The running variant of `core_run()` may assume the opposite.
+            core_select_variant(gba);
+            sched_raise_attention(gba);
+
             mem_update_waitstates(gba);
             break;
         };
@@ -821,6 +867,7 @@ mem_io_write8(
         case IO_REG_POSTFLG:                io->postflg = val; break;
         case IO_REG_HALTCNT: {
             gba->core.state = (val >> 7) + 1;
+            sched_raise_attention(gba);
             if (gba->core.state == CORE_STOP) {
                 ppu_render_black_screen(gba);
             }
@@ -931,6 +978,16 @@ io_register_delayed_write(
             break;
         };
 
+        /* Serial Communication */
+        case IO_REG_SIOCNT: {
+            io->siocnt.raw = io->pending.siocnt.raw;
+            if (!link_write_siocnt(gba)) {
+                io_sio_stub(gba);
+            }
+            io->pending.siocnt.raw = io->siocnt.raw;
+            break;
+        };
+
         default: panic(HS_ERROR, "Delayed write to unsupported register %08x", addr);
     }
 }
@@ -42,17 +42,17 @@
 **
 ** Source: GBATek
 */
-static uint32_t access_time16[2][16] = {
+static uint32_t const access_time16_default[2][16] = {
     [NON_SEQUENTIAL]    = { 1, 1, 3, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1 },
     [SEQUENTIAL]        = { 1, 1, 3, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1 },
 };
 
-static uint32_t access_time32[2][16] = {
+static uint32_t const access_time32_default[2][16] = {
     [NON_SEQUENTIAL]    = { 1, 1, 6, 1, 1, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 1 },
     [SEQUENTIAL]        = { 1, 1, 6, 1, 1, 2, 2, 1, 0, 0, 0, 0, 0, 0, 0, 1 },
 };
 
-static uint32_t gamepak_nonseq_waitstates[4] = { 4, 3, 2, 8 };
+static uint32_t const gamepak_nonseq_waitstates[4] = { 4, 3, 2, 8 };
 
 // Optional hot/inline hints (GCC/Clang)
 
@@ -72,15 +72,25 @@ align_addr_pow2(
 
 /*
 ** Set the waitstates for ROM/SRAM memory according to the content of REG_WAITCNT.
+**
+** They are kept in `struct memory`, so that each instance has its own, and must be updated
+** whenever REG_WAITCNT is written or restored.
 */
 void
 mem_update_waitstates(
-    struct gba const *gba
+    struct gba *gba
 ) {
     struct io const *io;
+    uint32_t (*access_time16)[16];
+    uint32_t (*access_time32)[16];
     uint32_t x;
 
     io = &gba->io;
+    access_time16 = gba->memory.access_time16;
+    access_time32 = gba->memory.access_time32;
+
+    memcpy(access_time16, access_time16_default, sizeof(access_time16_default));
+    memcpy(access_time32, access_time32_default, sizeof(access_time32_default));
 
     // 16 bit, non seq
     access_time16[NON_SEQUENTIAL][CART_0_REGION_1] = 1 + gamepak_nonseq_waitstates[io->waitcnt.ws0_nonseq];
@@ -142,11 +152,11 @@ mem_prefetch_buffer_access_fast(
         p->insn_len = sizeof(uint16_t);
         p->capacity = 8;
         // Reload for sequential on this page (reuse row to avoid 2D index)
-        p->reload   = access_time16[SEQUENTIAL][page];
+        p->reload   = gba->memory.access_time16[SEQUENTIAL][page];
     } else {
         p->insn_len = sizeof(uint32_t);
         p->capacity = 4;
-        p->reload   = access_time32[SEQUENTIAL][page];
+        p->reload   = gba->memory.access_time32[SEQUENTIAL][page];
     }
 
     p->countdown = p->reload;
@@ -158,13 +168,17 @@ mem_prefetch_buffer_access_fast(
 /*
 ** Calculate and add to the current cycle counter the amount of cycles needed for as many bus accesses
 ** are needed to transfer a data of the given size and access type.
+**
+** `prefetch` must be the value of `gba->memory.pbuffer.enabled`. It is a parameter so that the
+** specialised variants below can pass a constant and have the prefetch buffer's branches removed.
 */
-void HOT FLATTEN
-mem_access(
+static ALWAYS_INLINE void
+mem_access_template(
     struct gba *gba,
     uint32_t addr,
     uint32_t size,  // In bytes
-    enum access_types access_type
+    enum access_types access_type,
+    bool prefetch
 ) {
     const bool thumb = gba->core.cpsr.thumb;
 
@@ -184,14 +198,14 @@ mem_access(
     }
 
     const uint32_t cycles = (size <= sizeof(uint16_t))
-        ? access_time16[access_type][page]
-        : access_time32[access_type][page];
+        ? gba->memory.access_time16[access_type][page]
+        : gba->memory.access_time32[access_type][page];
 
     // Track bus state eagerly for non-cart paths too
     gba->memory.gamepak_bus_in_use = in_cart;
 
     // If not on cart bus, or prefetch disabled, or DMA active -> simple idle
-    const bool can_prefetch = in_cart && gba->memory.pbuffer.enabled && !gba->core.is_dma_running;
+    const bool can_prefetch = prefetch && in_cart && !gba->core.is_dma_running;
     if (LIKELY(!can_prefetch)) {
         core_idle_for(gba, cycles);
         return;
@@ -201,6 +215,150 @@ mem_access(
     mem_prefetch_buffer_access_fast(gba, addr, cycles, page, thumb);
 }
 
+void HOT FLATTEN
+mem_access(
+    struct gba *gba,
+    uint32_t addr,
+    uint32_t size,  // In bytes
+    enum access_types access_type
+) {
+    mem_access_template(gba, addr, size, access_type, gba->memory.pbuffer.enabled);
+}
+
+/*
+** Return the amount of cycles a single access to `addr` takes when the prefetch buffer
+** isn't involved, like during a DMA transfer.
+*/
+uint32_t
+mem_access_cycles(
+    struct gba const *gba,
+    uint32_t addr,
+    uint32_t size,  // In bytes
+    enum access_types access_type
+) {
+    uint32_t region;
+
+    addr = align_addr_pow2(addr, size);
+    region = addr >> 24;
+
+    // Same as in `mem_access_template()`: every 128 KiB boundary of the cartridge is non-sequential.
+    if ((uint32_t)(region - CART_REGION_START) <= (CART_REGION_END - CART_REGION_START) && !(addr & 0x1FFFFu)) {
+        access_type = NON_SEQUENTIAL;
+    }
+
+    return ((size <= sizeof(uint16_t))
+        ? gba->memory.access_time16[access_type][region & 0xF]
+        : gba->memory.access_time32[access_type][region & 0xF]
+    );
+}
+
+/*
+** Return a host pointer to the `size` bytes starting at `addr` if they all lie in EWRAM or IWRAM
+** without wrapping around the end of the region, or NULL otherwise.
+**
+** If `write` is true, the caller is about to modify them and they are marked as such for the
+** state digest.
+*/
+void *
+mem_ram_span(
+    struct gba *gba,
+    uint32_t addr,
+    size_t size,
+    bool write
+) {
+    uint32_t offset;
+    uint8_t *base;
+    bool *dirty;
+    uint32_t page;
+
+    switch (addr >> 24) {
+        case EWRAM_REGION: {
+            offset = addr & EWRAM_MASK;
+            if (offset + size > EWRAM_SIZE) {
+                return (NULL);
+            }
+            base = gba->memory.ewram;
+            dirty = gba->digest.dirty.ewram;
+            break;
+        };
+        case IWRAM_REGION: {
+            offset = addr & IWRAM_MASK;
+            if (offset + size > IWRAM_SIZE) {
+                return (NULL);
+            }
+            base = gba->memory.iwram;
+            dirty = gba->digest.dirty.iwram;
+            break;
+        };
+        default: {
+            return (NULL);
+        };
+    }
+
+    if (write && size) {
+        for (page = offset >> DIGEST_PAGE_SHIFT; page <= (offset + size - 1) >> DIGEST_PAGE_SHIFT; ++page) {
+            dirty[page] = true;
+        }
+    }
+
+    return (base + offset);
+}
+
+/*
+** Try to perform a block transfer of `count` consecutive words starting at `addr`
+** in one go, for the LDM/STM/PUSH/POP instructions.
+**
+** If the whole block lies in EWRAM or IWRAM, no debugger watchpoint is set and no scheduler
+** event or DMA could fire before `extra_cycles` after the transfer, the cycles of the `count`
+** accesses (1N + (count - 1)S) are charged at once and a host pointer to the first word is returned.
+** The caller is then responsible for copying the words itself, in any order.
+**
+** Otherwise, nothing is done and NULL is returned: the caller must fall back to `mem_read32()`
+** and `mem_write32()`, which handle IO, ROM, mirrors wrapping around and event timing precisely.
+*/
+uint32_t *
+mem_ram_bulk_access32(
+    struct gba *gba,
+    uint32_t addr,
+    uint32_t count,
+    uint32_t extra_cycles,
+    bool write
+) {
+    uint32_t region;
+    uint32_t cycles;
+    uint32_t *ptr;
+
+    addr = align(uint32_t, addr);
+    region = addr >> 24;
+
+    if (region != EWRAM_REGION && region != IWRAM_REGION) {
+        return (NULL);
+    }
+
+#ifdef WITH_DEBUGGER
+    if (gba->debugger.watchpoints.len) {
+        return (NULL);
+    }
+#endif
+
+    cycles = gba->memory.access_time32[NON_SEQUENTIAL][region] + (count - 1) * gba->memory.access_time32[SEQUENTIAL][region];
+
+    // Each access could run a pending DMA or a scheduler event in between two words.
+    if (gba->core.pending_dma || gba->scheduler.cycles + cycles + extra_cycles >= gba->scheduler.next_event) {
+        return (NULL);
+    }
+
+    ptr = mem_ram_span(gba, addr, count * sizeof(uint32_t), write);
+    if (!ptr) {
+        return (NULL);
+    }
+
+    gba->memory.gamepak_bus_in_use = false;
+    core_idle_for(gba, cycles);
+
+    return (ptr);
+}
+
 void
 mem_prefetch_buffer_step(
     struct gba *gba,
@@ -293,8 +451,13 @@ mem_openbus_read(
 ** Read the data of type T located in memory at the given address.
 **
 ** T must be either uint32_t, uint16_t or uint8_t.
+**
+** `may_use_eeprom` can be set to false if the game is known not to use an EEPROM, to remove
+** that test from reads to the cartridge.
 */
-#define template_read(T, gba, unaligned_addr)                                               \
+#define template_read(T, gba, unaligned_addr)   template_read_for(T, gba, unaligned_addr, true)
+
+#define template_read_for(T, gba, unaligned_addr, may_use_eeprom)                           \
     ({                                                                                      \
         T _ret = 0;                                                                         \
         uint32_t _addr;                                                                     \
@@ -349,7 +512,8 @@ mem_openbus_read(
                 break;                                                                      \
             case CART_REGION_START ... CART_REGION_END: {                                   \
                 if (unlikely(                                                               \
-                    ((gba)->memory.backup_storage.type == BACKUP_EEPROM_4K || (gba)->memory.backup_storage.type == BACKUP_EEPROM_64K) \
+                    (may_use_eeprom)                                                        \
+                    && ((gba)->memory.backup_storage.type == BACKUP_EEPROM_4K || (gba)->memory.backup_storage.type == BACKUP_EEPROM_64K) \
                     && (_addr & (gba)->memory.backup_storage.chip.eeprom.mask) == (gba)->memory.backup_storage.chip.eeprom.range \
                 )) {                                                                        \
                     _ret = mem_eeprom_read8(gba);                                           \
@@ -412,9 +576,11 @@ mem_openbus_read(
                 break;                                                                          \
             case EWRAM_REGION:                                                                  \
                 *(T *)((uint8_t *)((gba)->memory.ewram) + (_addr & EWRAM_MASK)) = (T)(val);     \
+                (gba)->digest.dirty.ewram[(_addr & EWRAM_MASK) >> DIGEST_PAGE_SHIFT] = true;    \
                 break;                                                                          \
             case IWRAM_REGION:                                                                  \
                 *(T *)((uint8_t *)((gba)->memory.iwram) + (_addr & IWRAM_MASK)) = (T)(val);     \
+                (gba)->digest.dirty.iwram[(_addr & IWRAM_MASK) >> DIGEST_PAGE_SHIFT] = true;    \
                 break;                                                                          \
             case IO_REGION:                                                                     \
                 _Generic(val,                                                                   \
@@ -454,9 +620,11 @@ mem_openbus_read(
                 _Generic(val,                                                                   \
                     uint32_t: ({                                                                \
                         *(T *)((uint8_t *)((gba)->memory.vram) + (_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2))) = (T)(val); \
+                        (gba)->digest.dirty.vram[(_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2)) >> DIGEST_PAGE_SHIFT] = true; \
                     }),                                                                         \
                     uint16_t: ({                                                                \
                         *(T *)((uint8_t *)((gba)->memory.vram) + (_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2))) = (T)(val); \
+                        (gba)->digest.dirty.vram[(_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2)) >> DIGEST_PAGE_SHIFT] = true; \
                     }),                                                                         \
                     default: ({                                                                 \
                         uint32_t new_addr;                                                      \
@@ -473,6 +641,8 @@ mem_openbus_read(
                             addr &= ~(sizeof(uint16_t) - 1);                                    \
                             *(T *)((uint8_t *)((gba)->memory.vram) + (_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2))) = (T)(val); \
                             *(T *)((uint8_t *)((gba)->memory.vram) + ((_addr + 1) & (((_addr + 1) & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2))) = (T)(val); \
+                            (gba)->digest.dirty.vram[(_addr & ((_addr & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2)) >> DIGEST_PAGE_SHIFT] = true; \
+                            (gba)->digest.dirty.vram[((_addr + 1) & (((_addr + 1) & 0x10000) ? VRAM_MASK_1 : VRAM_MASK_2)) >> DIGEST_PAGE_SHIFT] = true; \
                         }                                                                       \
                     })                                                                          \
                 );                                                                              \
@@ -651,6 +821,34 @@ mem_read32_ror(
     return (ror32(value, rotate));
 }
 
+/*
+** Specialised versions of `mem_read16()` and `mem_read32()` used by `core_run()` to fetch
+** instructions, one for each combination of the prefetch buffer being enabled and the game
+** using an EEPROM.
+**
+** They don't evaluate the debugger's watchpoints: the core falls back to `mem_read16()`
+** and `mem_read32()` when any is set.
+*/
+#define DEFINE_MEM_FETCH(T, name, prefetch, eeprom)                                         \
+    T                                                                                       \
+    name(                                                                                   \
+        struct gba *gba,                                                                    \
+        uint32_t addr,                                                                      \
+        enum access_types access_type                                                       \
+    ) {                                                                                     \
+        mem_access_template(gba, addr, sizeof(T), access_type, (prefetch));                 \
+        return (template_read_for(T, gba, addr, (eeprom)));                                 \
+    }
+
+DEFINE_MEM_FETCH(uint16_t, mem_fetch16_prefetch_eeprom, true, true)
+DEFINE_MEM_FETCH(uint16_t, mem_fetch16_prefetch, true, false)
+DEFINE_MEM_FETCH(uint16_t, mem_fetch16_eeprom, false, true)
+DEFINE_MEM_FETCH(uint16_t, mem_fetch16, false, false)
+DEFINE_MEM_FETCH(uint32_t, mem_fetch32_prefetch_eeprom, true, true)
+DEFINE_MEM_FETCH(uint32_t, mem_fetch32_prefetch, true, false)
+DEFINE_MEM_FETCH(uint32_t, mem_fetch32_eeprom, false, true)
+DEFINE_MEM_FETCH(uint32_t, mem_fetch32, false, false)
+
 void
 mem_write8_raw(
     struct gba *gba,
@@ -12,6 +12,7 @@
 */
 
 
+#include <string.h>
 #include "hs.h"
 #include "gba/gba.h"
 
@@ -130,6 +131,7 @@ mem_eeprom_write8(
                     gba->shared_data.backup_storage.data[eeprom->transfer_address + i] = (eeprom->transfer_data >> (56 - 8 * i)) & 0xFF;
                 }
                 gba->shared_data.backup_storage.dirty = true;
+                mem_backup_storage_mark_dirty(gba, eeprom->transfer_address, 8);
 
                 eeprom->state = EEPROM_STATE_END;
             }
@@ -143,3 +145,116 @@ mem_eeprom_write8(
         }
     }
 }
+
+/*
+** Read `len` bits from the EEPROM on behalf of a DMA, one per half-word of `stream`.
+**
+** Reading the 4 junk bits and the 64 data bits of a block in one transfer, which is what
+** all games do, is done in one go. Anything else goes through `mem_eeprom_read8()`.
+*/
+void
+mem_eeprom_read_stream(
+    struct gba *gba,
+    uint16_t *stream,
+    size_t len
+) {
+    struct eeprom *eeprom;
+    size_t i;
+
+    eeprom = &gba->memory.backup_storage.chip.eeprom;
+
+    if (
+           eeprom->cmd == EEPROM_CMD_READ
+        && eeprom->state == EEPROM_STATE_TRANSFER_JUNK
+        && eeprom->transfer_len == 0
+        && len == 4 + 64
+    ) {
+        memset(stream, 0, 4 * sizeof(*stream));
+        for (i = 0; i < 64; ++i) {
+            stream[4 + i] = (eeprom->transfer_data >> (63 - i)) & 1;
+        }
+
+        eeprom->transfer_data = 0;
+        eeprom->state = EEPROM_STATE_READY;
+        return;
+    }
+
+    for (i = 0; i < len; ++i) {
+        stream[i] = mem_eeprom_read8(gba);
+    }
+}
+
+/*
+** Send `len` bits written by a DMA to the EEPROM, one per half-word of `stream` (only bit 0
+** is used).
+**
+** A complete read request or write command sent while the EEPROM is ready is decoded at
+** once and leaves the EEPROM in the same state as the bit-by-bit state machine would.
+** Anything else goes through `mem_eeprom_write8()`.
+*/
+void
+mem_eeprom_write_stream(
+    struct gba *gba,
+    uint16_t const *stream,
+    size_t len
+) {
+    struct eeprom *eeprom;
+    uint32_t address;
+    size_t header_len;
+    size_t i;
+
+    eeprom = &gba->memory.backup_storage.chip.eeprom;
+    header_len = 2 + eeprom->address_len;
+
+    if (
+           eeprom->state == EEPROM_STATE_READY
+        && eeprom->transfer_len == 0
+        && len >= header_len
+        && (stream[0] & 1)
+    ) {
+        address = 0;
+        for (i = 2; i < header_len; ++i) {
+            address = (address << 1) | (stream[i] & 1);
+        }
+        address = (address * 8) & eeprom->address_mask;
+
+        // Read request, eventually followed by its stop bit.
+        if ((stream[1] & 1) && len <= header_len + 1) {
+            eeprom->cmd = EEPROM_CMD_READ;
+            eeprom->transfer_address = address;
+            eeprom->transfer_data = 0;
+            for (i = 0; i < 8; ++i) {
+                eeprom->transfer_data <<= 8;
+                eeprom->transfer_data |= gba->shared_data.backup_storage.data[address + i];
+            }
+            eeprom->state = EEPROM_STATE_TRANSFER_JUNK;
+            return;
+        }
+
+        // Write command: 64 bits of data followed by the stop bit.
+        if (!(stream[1] & 1) && len == header_len + 64 + 1) {
+            uint64_t data;
+
+            data = 0;
+            for (i = header_len; i < header_len + 64; ++i) {
+                data = (data << 1) | (stream[i] & 1);
+            }
+
+            for (i = 0; i < 8; ++i) {
+                gba->shared_data.backup_storage.data[address + i] = (data >> (56 - 8 * i)) & 0xFF;
+            }
+            gba->shared_data.backup_storage.dirty = true;
+            mem_backup_storage_mark_dirty(gba, address, 8);
+
+            eeprom->cmd = EEPROM_CMD_WRITE;
+            eeprom->transfer_address = address;
+            eeprom->transfer_data = data;
+            eeprom->state = (stream[len - 1] & 1) ? EEPROM_STATE_END : EEPROM_STATE_READY;
+            return;
+        }
+    }
+
+    for (i = 0; i < len; ++i) {
+        mem_eeprom_write8(gba, stream[i] & 1);
+    }
+}
@@ -0,0 +1,569 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gba/gba.h"
+
+static_assert(BACKUP_SECTOR_LEN % 64 == 0);
+
+static
+bool
+persist_any(
+    uint64_t const *bitmap
+) {
+    size_t i;
+
+    for (i = 0; i < BACKUP_DIRTY_WORDS; ++i) {
+        if (bitmap[i]) {
+            return (true);
+        }
+    }
+    return (false);
+}
+
+static inline
+bool
+persist_test(
+    uint64_t const *bitmap,
+    size_t sector
+) {
+    return ((bitmap[sector / 64] >> (sector % 64)) & 1);
+}
+
+/*
+** Turn a bitmap of sectors into the list of the ranges of consecutive sectors it holds,
+** clamped to `size`, and return the length of that list.
+**
+** `ranges` must be able to hold `BACKUP_SECTOR_LEN / 2` entries.
+*/
+static
+size_t
+persist_coalesce(
+    uint64_t const *bitmap,
+    size_t size,
+    struct backup_range *ranges
+) {
+    size_t sector;
+    size_t len;
+
+    len = 0;
+    sector = 0;
+    while (sector < BACKUP_SECTOR_LEN && (sector << BACKUP_SECTOR_SHIFT) < size) {
+        size_t start;
+
+        if (!persist_test(bitmap, sector)) {
+            ++sector;
+            continue;
+        }
+
+        start = sector;
+        while (sector < BACKUP_SECTOR_LEN && persist_test(bitmap, sector)) {
+            ++sector;
+        }
+
+        ranges[len].offset = start << BACKUP_SECTOR_SHIFT;
+        ranges[len].size = min(sector << BACKUP_SECTOR_SHIFT, size) - ranges[len].offset;
+        ++len;
+    }
+    return (len);
+}
+
+/*
+** Write `data` to `path` through a temporary file that is then renamed over it, so
+** that a crash can't leave a truncated save behind.
+*/
+static
+void
+persist_write_file(
+    char const *path,
+    uint8_t const *data,
+    size_t size
+) {
+    char *tmp;
+    int fd;
+
+    tmp = malloc(strlen(path) + sizeof(".tmp"));
+    hs_assert(tmp);
+    sprintf(tmp, "%s.tmp", path);
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        logln(HS_ERROR, "Failed to open \"%s\": %s.", tmp, strerror(errno));
+        goto end;
+    }
+
+    while (size) {
+        ssize_t ret;
+
+        ret = write(fd, data, size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            logln(HS_ERROR, "Failed to write \"%s\": %s.", tmp, strerror(errno));
+            close(fd);
+            unlink(tmp);
+            goto end;
+        }
+        data += ret;
+        size -= (size_t)ret;
+    }
+
+    if (fsync(fd) || close(fd)) {
+        logln(HS_ERROR, "Failed to write \"%s\": %s.", tmp, strerror(errno));
+        unlink(tmp);
+        goto end;
+    }
+
+    if (rename(tmp, path)) {
+        logln(HS_ERROR, "Failed to rename \"%s\" to \"%s\": %s.", tmp, path, strerror(errno));
+        unlink(tmp);
+    }
+
+end:
+    free(tmp);
+}
+
+/*
+** Body of the thread persisting the snapshots taken by the emulator.
+**
+** It works on a private copy of the snapshot so that the emulator never waits for
+** the frontend's callback or for the disk.
+*/
+static
+void *
+persist_thread(
+    void *arg
+) {
+    struct backup_persistence *persist;
+    struct backup_range ranges[BACKUP_SECTOR_LEN / 2];
+    uint8_t *copy;
+    size_t copy_size;
+
+    persist = arg;
+    copy = NULL;
+    copy_size = 0;
+
+    pthread_mutex_lock(&persist->lock);
+    while (true) {
+        size_t ranges_len;
+
+        while (!persist->exit && !persist_any(persist->pending)) {
+            pthread_cond_wait(&persist->cond, &persist->lock);
+        }
+
+        if (!persist_any(persist->pending)) {
+            break;
+        }
+
+        if (copy_size != persist->size) {
+            free(copy);
+            copy = malloc(persist->size);
+            hs_assert(copy);
+            copy_size = persist->size;
+        }
+        memcpy(copy, persist->snapshot, copy_size);
+        ranges_len = persist_coalesce(persist->pending, copy_size, ranges);
+        memset(persist->pending, 0, sizeof(persist->pending));
+        persist->busy = true;
+        pthread_mutex_unlock(&persist->lock);
+
+        if (persist->callback) {
+            persist->callback(persist->arg, copy, copy_size, ranges, ranges_len);
+        }
+
+        if (persist->path) {
+            persist_write_file(persist->path, copy, copy_size);
+        }
+
+        pthread_mutex_lock(&persist->lock);
+        persist->busy = false;
+        pthread_cond_broadcast(&persist->cond);
+    }
+    pthread_mutex_unlock(&persist->lock);
+
+    free(copy);
+    return (NULL);
+}
+
+/*
+** Copy the dirty sectors of the backup storage to the snapshot and wake up the
+** persistence thread.
+*/
+static
+void
+persist_snapshot(
+    struct gba *gba
+) {
+    struct backup_persistence *persist;
+    uint8_t const *data;
+    size_t size;
+    size_t sector;
+    size_t i;
+
+    persist = &gba->backup_persistence;
+    data = gba->shared_data.backup_storage.data;
+    size = gba->shared_data.backup_storage.size;
+
+    pthread_mutex_lock(&persist->lock);
+
+    // A quickload can change the size of the backup storage.
+    if (persist->size != size) {
+        free(persist->snapshot);
+        persist->snapshot = size ? malloc(size) : NULL;
+        hs_assert(!size || persist->snapshot);
+        persist->size = size;
+        memset(persist->dirty, 0xFF, sizeof(persist->dirty));
+    }
+
+    for (sector = 0; sector < BACKUP_SECTOR_LEN && (sector << BACKUP_SECTOR_SHIFT) < size; ++sector) {
+        if (persist_test(persist->dirty, sector)) {
+            size_t offset;
+
+            offset = sector << BACKUP_SECTOR_SHIFT;
+            memcpy(persist->snapshot + offset, data + offset, min(BACKUP_SECTOR_SIZE, size - offset));
+        }
+    }
+
+    for (i = 0; i < BACKUP_DIRTY_WORDS; ++i) {
+        persist->pending[i] |= persist->dirty[i];
+        persist->dirty[i] = 0;
+    }
+
+    pthread_cond_broadcast(&persist->cond);
+    pthread_mutex_unlock(&persist->lock);
+}
+
+/*
+** Map the first `size` bytes of `fd` as the backup storage, growing the file if needed.
+**
+** The bytes the file is grown with are set to 0xFF, like an erased chip.
+*/
+static
+bool
+backup_map_file(
+    struct gba *gba,
+    int fd,
+    size_t size
+) {
+    struct stat st;
+    size_t file_size;
+    void *mapping;
+
+    if (fstat(fd, &st)) {
+        logln(HS_ERROR, "Failed to stat the backup storage file: %s.", strerror(errno));
+        return (false);
+    }
+
+    file_size = (size_t)max(st.st_size, 0);
+    if (file_size < size && ftruncate(fd, (off_t)size)) {
+        logln(HS_ERROR, "Failed to grow the backup storage file: %s.", strerror(errno));
+        return (false);
+    }
+
+    mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        logln(HS_ERROR, "Failed to mmap the backup storage file: %s.", strerror(errno));
+        return (false);
+    }
+
+    if (file_size < size) {
+        memset((uint8_t *)mapping + file_size, 0xFF, size - file_size);
+    }
+
+    gba->shared_data.backup_storage.data = mapping;
+    gba->backup_persistence.mapped = true;
+    return (true);
+}
+
+/*
+** Allocate the backup storage, which must already have its size set, and fill it with
+** its initial content.
+**
+** If the frontend gave a file descriptor, the file is mapped in memory instead. If that
+** fails, we fall back to a buffer filled with the file's content.
+*/
+void
+mem_backup_storage_attach(
+    struct gba *gba,
+    struct launch_config const *config
+) {
+    size_t size;
+
+    size = gba->shared_data.backup_storage.size;
+
+    gba->shared_data.backup_storage.data = NULL;
+    gba->backup_persistence.mapped = false;
+    gba->backup_persistence.unsynced = false;
+    gba->backup_persistence.sync_delay = config->backup_storage.sync_delay;
+
+    if (!size) {
+        return;
+    }
+
+    if (config->backup_storage.fd >= 0 && !config->backup_storage.data) {
+        if (backup_map_file(gba, config->backup_storage.fd, size)) {
+            return;
+        }
+    }
+
+    gba->shared_data.backup_storage.data = malloc(size);
+    hs_assert(gba->shared_data.backup_storage.data);
+
+    memset(gba->shared_data.backup_storage.data, 0xFF, size);
+
+    if (config->backup_storage.data && config->backup_storage.size) {
+        memcpy(gba->shared_data.backup_storage.data, config->backup_storage.data, min(size, config->backup_storage.size));
+    } else if (config->backup_storage.fd >= 0) {
+        ssize_t ret;
+
+        ret = pread(config->backup_storage.fd, gba->shared_data.backup_storage.data, size, 0);
+        if (ret < 0) {
+            logln(HS_ERROR, "Failed to read the backup storage file: %s.", strerror(errno));
+        }
+    }
+}
+
+/*
+** Release the backup storage, making sure a mapped file is written back first.
+*/
+void
+mem_backup_storage_release(
+    struct gba *gba
+) {
+    if (gba->backup_persistence.mapped) {
+        msync(gba->shared_data.backup_storage.data, gba->shared_data.backup_storage.size, MS_SYNC);
+        munmap(gba->shared_data.backup_storage.data, gba->shared_data.backup_storage.size);
+        gba->backup_persistence.mapped = false;
+        gba->backup_persistence.unsynced = false;
+    } else {
+        free(gba->shared_data.backup_storage.data);
+    }
+
+    gba->shared_data.backup_storage.data = NULL;
+}
+
+/*
+** Replace the backup storage by an uninitialized one of `size` bytes.
+**
+** Used when loading a quicksave made with a different kind of backup storage. A mapped
+** file can't change size, so it is detached and the new backup storage lives in memory.
+*/
+void
+mem_backup_storage_resize(
+    struct gba *gba,
+    size_t size
+) {
+    mem_backup_storage_release(gba);
+
+    gba->shared_data.backup_storage.size = size;
+    if (size) {
+        gba->shared_data.backup_storage.data = malloc(size);
+        hs_assert(gba->shared_data.backup_storage.data);
+    }
+}
+
+/*
+** Start persisting the backup storage as described by `config`.
+**
+** Must be called once the backup storage is allocated and filled with its initial content.
+*/
+void
+mem_backup_storage_persist_start(
+    struct gba *gba,
+    struct launch_config const *config
+) {
+    struct backup_persistence *persist;
+
+    persist = &gba->backup_persistence;
+
+    mem_backup_storage_persist_stop(gba);
+
+    if (
+           !gba->shared_data.backup_storage.size
+        || (!config->backup_storage.persist.callback && !config->backup_storage.persist.path)
+    ) {
+        return;
+    }
+
+    memset(persist->dirty, 0, sizeof(persist->dirty));
+    memset(persist->pending, 0, sizeof(persist->pending));
+    persist->written = false;
+    persist->quiet_frames = 0;
+    persist->flush_delay = config->backup_storage.persist.flush_delay;
+    persist->callback = config->backup_storage.persist.callback;
+    persist->arg = config->backup_storage.persist.arg;
+    persist->path = config->backup_storage.persist.path ? strdup(config->backup_storage.persist.path) : NULL;
+    persist->busy = false;
+    persist->exit = false;
+
+    persist->size = gba->shared_data.backup_storage.size;
+    persist->snapshot = malloc(persist->size);
+    hs_assert(persist->snapshot);
+    memcpy(persist->snapshot, gba->shared_data.backup_storage.data, persist->size);
+
+    if (pthread_create(&persist->thread, NULL, persist_thread, persist)) {
+        logln(HS_ERROR, "Failed to start the backup storage persistence thread.");
+        free(persist->snapshot);
+        free(persist->path);
+        persist->snapshot = NULL;
+        persist->path = NULL;
+        return;
+    }
+
+    persist->enabled = true;
+}
+
+/*
+** Persist the pending changes and stop the persistence thread.
+*/
+void
+mem_backup_storage_persist_stop(
+    struct gba *gba
+) {
+    struct backup_persistence *persist;
+
+    persist = &gba->backup_persistence;
+
+    if (!persist->enabled) {
+        return;
+    }
+
+    mem_backup_storage_write_to_disk(gba);
+
+    pthread_mutex_lock(&persist->lock);
+    persist->exit = true;
+    pthread_cond_broadcast(&persist->cond);
+    pthread_mutex_unlock(&persist->lock);
+    pthread_join(persist->thread, NULL);
+
+    free(persist->snapshot);
+    free(persist->path);
+    persist->snapshot = NULL;
+    persist->path = NULL;
+    persist->size = 0;
+    persist->enabled = false;
+}
+
+/*
+** Mark `size` bytes of the backup storage starting at `offset` as modified.
+**
+** Called by every path writing to the backup storage.
+*/
+void
+mem_backup_storage_mark_dirty(
+    struct gba *gba,
+    size_t offset,
+    size_t size
+) {
+    struct backup_persistence *persist;
+    size_t sector;
+
+    persist = &gba->backup_persistence;
+
+    if (!size) {
+        return;
+    }
+
+    // Tells `run_ahead_frame()` the backup storage must be restored.
+    if (gba->run_ahead.speculating) {
+        gba->run_ahead.backup_written = true;
+    } else {
+        gba->rollback.backup_frame = gba->rollback.frame;
+    }
+
+    if (persist->enabled) {
+        for (sector = offset >> BACKUP_SECTOR_SHIFT; sector <= (offset + size - 1) >> BACKUP_SECTOR_SHIFT && sector < BACKUP_SECTOR_LEN; ++sector) {
+            persist->dirty[sector / 64] |= (1ull << (sector % 64));
+        }
+    }
+
+    persist->unsynced = persist->mapped;
+    persist->written = true;
+}
+
+/*
+** Called when the PPU enters VBlank.
+**
+** Takes a snapshot of the dirty sectors once the game stopped writing to the backup
+** storage for `flush_delay` frames, so that a burst of writes (like a Flash sector being
+** programmed byte by byte) is persisted once, in a consistent state.
+**
+** A mapped file is msync'd the same way after `sync_delay` frames. `MS_ASYNC` only
+** schedules the write-back, so the emulator doesn't wait for the disk.
+*/
+void
+mem_backup_storage_frame(
+    struct gba *gba
+) {
+    struct backup_persistence *persist;
+
+    persist = &gba->backup_persistence;
+
+    if (persist->written) {
+        persist->written = false;
+        persist->quiet_frames = 0;
+    } else if (persist->quiet_frames < UINT32_MAX) {
+        ++persist->quiet_frames;
+    }
+
+    if (persist->enabled && persist->quiet_frames >= persist->flush_delay && persist_any(persist->dirty)) {
+        persist_snapshot(gba);
+    }
+
+    if (persist->unsynced && persist->quiet_frames >= persist->sync_delay) {
+        msync(gba->shared_data.backup_storage.data, gba->shared_data.backup_storage.size, MS_ASYNC);
+        persist->unsynced = false;
+    }
+}
+
+/*
+** Persist all the changes made to the backup storage so far, and wait until it's done.
+*/
+void
+mem_backup_storage_write_to_disk(
+    struct gba *gba
+) {
+    struct backup_persistence *persist;
+
+    persist = &gba->backup_persistence;
+
+    if (persist->mapped) {
+        msync(gba->shared_data.backup_storage.data, gba->shared_data.backup_storage.size, MS_SYNC);
+        persist->unsynced = false;
+    }
+
+    if (!persist->enabled) {
+        return;
+    }
+
+    if (persist_any(persist->dirty) || persist->size != gba->shared_data.backup_storage.size) {
+        persist_snapshot(gba);
+    }
+
+    pthread_mutex_lock(&persist->lock);
+    while (persist->busy || persist_any(persist->pending)) {
+        pthread_cond_wait(&persist->cond, &persist->lock);
+    }
+    pthread_mutex_unlock(&persist->lock);
+
+    persist->written = false;
+    persist->quiet_frames = 0;
+}
@@ -52,6 +52,7 @@ mem_backup_storage_write8(
         case BACKUP_SRAM:
             gba->shared_data.backup_storage.data[addr & SRAM_MASK] = val;
             gba->shared_data.backup_storage.dirty = true;
+            mem_backup_storage_mark_dirty(gba, addr & SRAM_MASK, 1);
             break;
         default:
             break;
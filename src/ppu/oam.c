@@ -30,6 +30,53 @@
 int32_t sprite_size_x[16] = { 8, 16, 32, 64, 16, 32, 32, 64, 8, 8, 16, 32, 0, 0, 0, 0};
 int32_t sprite_size_y[16] = { 8, 16, 32, 64, 8, 8, 16, 32, 16, 32, 32, 64, 0, 0, 0, 0};
 
+/*
+** Floor of `n / d`, for `d > 0`.
+*/
+static inline
+int64_t
+oam_floor_div(
+    int64_t n,
+    int64_t d
+) {
+    return ((n >= 0) ? n / d : -((-n + d - 1) / d));
+}
+
+/*
+** Narrow `[*start, *end)` to the values of `x` for which `0 <= (v + step * x) >> 8 < limit`.
+**
+** This is how affine sprites skip the part of their bounding box that falls outside of the
+** sprite once transformed, without testing each pixel.
+*/
+static
+void
+oam_clip_span(
+    int32_t v,
+    int32_t step,
+    int32_t limit,
+    int32_t *start,
+    int32_t *end
+) {
+    int64_t lo;
+    int64_t hi;
+
+    if (step > 0) {
+        lo = -oam_floor_div(v, step);                                   // ceil(-v / step)
+        hi = -oam_floor_div(v - ((int64_t)limit << 8), step);           // ceil((limit - v) / step)
+    } else if (step < 0) {
+        lo = oam_floor_div(v - ((int64_t)limit << 8), -step) + 1;
+        hi = oam_floor_div(v, -step) + 1;
+    } else if (v >= 0 && v < (limit << 8)) {
+        return;
+    } else {
+        *end = *start;
+        return;
+    }
+
+    *start = max(*start, (int32_t)max(lo, (int64_t)INT32_MIN));
+    *end = min(*end, (int32_t)min(hi, (int64_t)INT32_MAX));
+}
+
 /*
 ** Pre-render all visible sprites.
 */
@@ -98,6 +145,11 @@ ppu_prerender_oam(
             int16_t pb;
             int16_t pc;
             int16_t pd;
+            int32_t x_start;
+            int32_t x_end;
+            uint32_t tile_size;     // In bytes
+            uint32_t tile_base;     // Within VRAM
+            uint32_t tile_stride;   // Between two rows of tiles, in bytes
 
             if (oam.affine) {
                 pa = (int16_t)mem_oam_read16(gba, oam.affine_data_idx * 32 + 0x6);
@@ -117,21 +169,36 @@ ppu_prerender_oam(
             px = pa * -(win_sx / 2) + pb * ((line - win_oy) - (win_sy / 2)) + ((sprite_sx / 2) << 8);
             py = pc * -(win_sx / 2) + pd * ((line - win_oy) - (win_sy / 2)) + ((sprite_sy / 2) << 8);
 
-            for (x = 0; x < win_sx; ++x, px += pa, py += pc) {
+            /*
+            ** Only the pixels that are on screen and, once transformed, inside the sprite are walked.
+            ** The mosaic moves pixels around and may bring some back in, so these are still tested one by one.
+            */
+            x_start = max(0, -win_ox);
+            x_end = min(win_sx, GBA_SCREEN_WIDTH - win_ox);
+
+            if (!oam.mosaic) {
+                oam_clip_span(px, pa, sprite_sx, &x_start, &x_end);
+                oam_clip_span(py, pc, sprite_sy, &x_start, &x_end);
+            }
+
+            if (x_start >= x_end) {
+                continue;
+            }
+
+            tile_size = oam.color_256 ? 64 : 32;
+            tile_base = 0x10000 + oam.tile_idx * 32;
+            tile_stride = io->dispcnt.obj_dim ? (sprite_sx / 8) * tile_size : 32 * 32;   // 1 or 2 Dimension
+
+            px += pa * x_start;
+            py += pc * x_start;
+
+            for (x = x_start; x < x_end; ++x, px += pa, py += pc) {
                 uint32_t palette_idx;
                 int32_t rel_x;          // X coordinate of the pixel within the sprite
                 int32_t rel_y;          // Y coordinate of the pixel within the sprite
                 uint32_t chr_x;         // X coordinate of the pixel within the tile (0-7)
                 uint32_t chr_y;         // Y coordinate of the pixel within the tile (0-7)
-                uint32_t tile_x;        // X coordinate of the tile within the sprite
-                uint32_t tile_y;        // Y coordinate of the tile within the sprite
                 uint32_t tile_offset;   // Within VRAM
-                uint32_t tile_size;     // In bytes
-
-                // Filter-out pixels that are outside of the screen
-                if (win_ox + x < 0 || win_ox + x >= GBA_SCREEN_WIDTH) {
-                    continue;
-                }
 
                 rel_x = (px >> 8);
                 rel_y = (py >> 8);
@@ -139,41 +206,29 @@ ppu_prerender_oam(
                 if (oam.mosaic) {
                     rel_x = (win_ox + rel_x) / (io->mosaic.obj_hsize + 1) * (io->mosaic.obj_hsize + 1) - win_ox;
                     rel_y = (win_oy + rel_y) / (io->mosaic.obj_vsize + 1) * (io->mosaic.obj_vsize + 1) - win_oy;
-                }
 
-                tile_x = rel_x / 8;
-                tile_y = rel_y / 8;
-                chr_x = rel_x % 8;
-                chr_y = rel_y % 8;
-
-                // Filter out pixels that are rotated/shred/scaled outside of their sprite.
-                if (
-                       rel_x < 0 || tile_x >= sprite_sx / 8
-                    || rel_y < 0 || tile_y >= sprite_sy / 8
-                ) {
-                    continue;
+                    // Filter out pixels that are rotated/shred/scaled outside of their sprite.
+                    if (
+                           rel_x < 0 || rel_x >= sprite_sx
+                        || rel_y < 0 || rel_y >= sprite_sy
+                    ) {
+                        continue;
+                    }
                 }
 
                 // Flip horizontally
                 if (!oam.affine && oam.hflip) {
-                    tile_x = (sprite_sx / 8) - 1 - tile_x;
-                    chr_x ^= 0b111;
+                    rel_x = sprite_sx - 1 - rel_x;
                 }
 
                 // Flip vertically
                 if (!oam.affine && oam.vflip) {
-                    tile_y = (sprite_sy / 8) - 1 - tile_y;
-                    chr_y ^= 0b111;
+                    rel_y = sprite_sy - 1 - rel_y;
                 }
 
-                tile_size = oam.color_256 ? 64 : 32;
-                tile_offset = 0x10000 + oam.tile_idx * 32;
-
-                if (io->dispcnt.obj_dim) { // 1 Dimension
-                    tile_offset += tile_y * (sprite_sx / 8) * tile_size + tile_x * tile_size;
-                } else { // 2 Dimension
-                    tile_offset += tile_y * 32 * 32 + tile_x * tile_size;
-                }
+                chr_x = rel_x & 0b111;
+                chr_y = rel_y & 0b111;
+                tile_offset = tile_base + (rel_y >> 3) * tile_stride + (rel_x >> 3) * tile_size;
 
                 if (oam.color_256) { // 256 colors, 1 palette
                     palette_idx = mem_vram_read8(gba, tile_offset + chr_y * 8 + chr_x);
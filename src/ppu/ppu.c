@@ -16,6 +16,8 @@
 #include "gba/gba.h"
 #include "gba/ppu.h"
 
+static_assert(GBA_SCREEN_TILES <= 32);
+
 static void ppu_merge_layer(struct gba const *gba, struct scanline *scanline, struct rich_color *layer);
 
 /*
@@ -54,6 +56,54 @@ ppu_initialize_scanline(
     }
 }
 
+/*
+** Rebuild the tables used by `ppu_merge_layer()` if BLDALPHA or BLDY changed since they were built.
+*/
+static
+void
+ppu_update_blend_luts(
+    struct gba *gba
+) {
+    struct io const *io;
+    struct ppu *ppu;
+    uint32_t eva;
+    uint32_t evb;
+    uint32_t evy;
+    uint32_t hash;
+    uint32_t top;
+    uint32_t bot;
+
+    io = &gba->io;
+    ppu = &gba->ppu;
+
+    // Clamp to [0..16]
+    eva = min((uint32_t)io->bldalpha.top_coef, 16u);
+    evb = min((uint32_t)io->bldalpha.bot_coef, 16u);
+    evy = min((uint32_t)io->bldy.coef, 16u);
+
+    // The top bit tells a built table from a zeroed one.
+    hash = 0x80000000 | eva | (evb << 8);
+    if (hash != ppu->blend_alpha_hash) {
+        ppu->blend_alpha_hash = hash;
+
+        for (top = 0; top < 32; ++top) {
+            for (bot = 0; bot < 32; ++bot) {
+                ppu->blend_alpha[top][bot] = min((eva * top + evb * bot) >> 4, 31u);
+            }
+        }
+    }
+
+    hash = 0x80000000 | evy;
+    if (hash != ppu->blend_bright_hash) {
+        ppu->blend_bright_hash = hash;
+
+        for (top = 0; top < 32; ++top) {
+            ppu->blend_light[top] = top + (((31 - top) * evy) >> 4);
+            ppu->blend_dark[top] = top - ((top * evy) >> 4);
+        }
+    }
+}
+
 /*
 ** Merge the current layer with any previous ones (using alpha blending) as stated in REG_BLDCNT.
 */
@@ -66,10 +116,10 @@ ppu_merge_layer(
 ) {
     struct io const *io = &gba->io;
 
-    // Clamp to [0..16]
-    const uint32_t eva = (io->bldalpha.top_coef  > 16) ? 16 : io->bldalpha.top_coef;
-    const uint32_t evb = (io->bldalpha.bot_coef  > 16) ? 16 : io->bldalpha.bot_coef;
-    const uint32_t evy = (io->bldy.coef          > 16) ? 16 : io->bldy.coef;
+    // See `ppu_update_blend_luts()`
+    uint8_t const (*alpha)[32] = gba->ppu.blend_alpha;
+    uint8_t const *light = gba->ppu.blend_light;
+    uint8_t const *dark = gba->ppu.blend_dark;
 
     const uint32_t bldcnt_raw = io->bldcnt.raw;
     const uint32_t base_mode  = io->bldcnt.mode;
@@ -129,19 +179,11 @@ ppu_merge_layer(
             if (!(top_enabled_global || topc.force_blend) || !bot_enabled || !botc.visible) {
                 res[x] = topc;
             } else {
-                // Use true eva/evb weights: out = (eva * top + evb * bot) >> 4
-                int32_t blended_r = ((int32_t)eva * (int32_t)topc.red   + (int32_t)evb * (int32_t)botc.red)   >> 4;
-                int32_t blended_g = ((int32_t)eva * (int32_t)topc.green + (int32_t)evb * (int32_t)botc.green) >> 4;
-                int32_t blended_b = ((int32_t)eva * (int32_t)topc.blue  + (int32_t)evb * (int32_t)botc.blue)  >> 4;
-
-                if (blended_r > 31) blended_r = 31;
-                if (blended_g > 31) blended_g = 31;
-                if (blended_b > 31) blended_b = 31;
-
+                // out = min((eva * top + evb * bot) >> 4, 31)
                 struct rich_color out;
-                out.red     = (uint8_t)blended_r;
-                out.green   = (uint8_t)blended_g;
-                out.blue    = (uint8_t)blended_b;
+                out.red     = alpha[topc.red][botc.red];
+                out.green   = alpha[topc.green][botc.green];
+                out.blue    = alpha[topc.blue][botc.blue];
                 out.visible = true;
                 out.idx     = (uint8_t)top_idx;
                 res[x] = out;
@@ -152,9 +194,9 @@ ppu_merge_layer(
         if (top_enabled_global) {
             if (mode_eff == BLEND_LIGHT) {
                 struct rich_color out;
-                out.red     = topc.red   + (((31 - topc.red)   * evy) >> 4);
-                out.green   = topc.green + (((31 - topc.green) * evy) >> 4);
-                out.blue    = topc.blue  + (((31 - topc.blue)  * evy) >> 4);
+                out.red     = light[topc.red];
+                out.green   = light[topc.green];
+                out.blue    = light[topc.blue];
                 out.visible = true;
                 out.idx     = topc.idx;
                 res[x] = out;
@@ -163,9 +205,9 @@ ppu_merge_layer(
 
             // BLEND_DARK
             struct rich_color out;
-            out.red     = topc.red   - ((topc.red   * evy) >> 4);
-            out.green   = topc.green - ((topc.green * evy) >> 4);
-            out.blue    = topc.blue  - ((topc.blue  * evy) >> 4);
+            out.red     = dark[topc.red];
+            out.green   = dark[topc.green];
+            out.blue    = dark[topc.blue];
             out.visible = true;
             out.idx     = topc.idx;
             res[x] = out;
@@ -303,6 +345,9 @@ ppu_render_scanline(
 
 /*
 ** Compose the content of the framebuffer based on the content of `scanline->result` and/or the backdrop color.
+**
+** The line is compared with the one it replaces, which is still in the framebuffer, to know which
+** tiles changed (see `shared_data.framebuffer.dirty_tiles`).
 */
 static
 void
@@ -310,24 +355,86 @@ ppu_draw_scanline(
     struct gba *gba,
     struct scanline const *scanline
 ) {
-    uint32_t x;
-    uint32_t y;
+    uint16_t line[GBA_SCREEN_WIDTH];
     uint16_t *dst;
-    size_t base;
+    uint32_t tiles;
+    uint32_t x;
 
-    y = gba->io.vcount.raw;
-    dst = gba->shared_data.framebuffer.data;
-    base = GBA_SCREEN_WIDTH * (size_t)y;
+    dst = gba->shared_data.framebuffer.data + GBA_SCREEN_WIDTH * (size_t)gba->io.vcount.raw;
+    isa.scanline_to_rgb555(line, scanline->result, GBA_SCREEN_WIDTH);
 
-    for (x = 0; x < GBA_SCREEN_WIDTH; ++x) {
-        struct rich_color c;
-
-        c = scanline->result[x];
-        dst[base + x] = (uint16_t)(
-            ((uint32_t)c.red & 0x1F)
-            | (((uint32_t)c.green & 0x1F) << 5)
-            | (((uint32_t)c.blue & 0x1F) << 10)
-        );
+    tiles = 0;
+    for (x = 0; x < GBA_SCREEN_TILES; ++x) {
+        size_t offset;
+
+        offset = x * GBA_SCREEN_TILE_WIDTH;
+        if (memcmp(line + offset, dst + offset, GBA_SCREEN_TILE_WIDTH * sizeof(uint16_t))) {
+            memcpy(dst + offset, line + offset, GBA_SCREEN_TILE_WIDTH * sizeof(uint16_t));
+            tiles |= (1u << x);
+        }
+    }
+
+    gba->shared_data.framebuffer.drawn_tiles[gba->io.vcount.raw] |= tiles;
+}
+
+/*
+** Add the tiles changed by the frame that was just drawn to the ones published to the frontend.
+*/
+static
+bool
+ppu_publish_dirty_tiles(
+    struct gba *gba
+) {
+    uint32_t changed;
+    size_t y;
+
+    changed = 0;
+    gba_shared_framebuffer_lock(gba);
+    for (y = 0; y < GBA_SCREEN_HEIGHT; ++y) {
+        gba->shared_data.framebuffer.dirty_tiles[y] |= gba->shared_data.framebuffer.drawn_tiles[y];
+        changed |= gba->shared_data.framebuffer.drawn_tiles[y];
+    }
+    gba_shared_framebuffer_release(gba);
+
+    memset(gba->shared_data.framebuffer.drawn_tiles, 0, sizeof(gba->shared_data.framebuffer.drawn_tiles));
+    return (changed != 0);
+}
+
+/*
+** Decide whether the frame about to start should be drawn.
+**
+** In adaptive mode, `current_frame_skip_counter` is the number of frames skipped in a row.
+*/
+static
+void
+ppu_update_frame_skipping(
+    struct gba *gba
+) {
+    struct ppu *ppu;
+
+    ppu = &gba->ppu;
+
+    if (gba->settings.enable_frame_skipping && gba->settings.adaptive_frame_skipping) {
+        if (gba->scheduler.late && ppu->current_frame_skip_counter + 1 < gba->settings.frame_skip_counter) {
+            ++ppu->current_frame_skip_counter;
+            ppu->skip_current_frame = true;
+
+            if (ppu->current_frame_skip_counter > atomic_load(&gba->shared_data.frame_skip.max_streak)) {
+                atomic_store(&gba->shared_data.frame_skip.max_streak, ppu->current_frame_skip_counter);
+            }
+        } else {
+            ppu->current_frame_skip_counter = 0;
+            ppu->skip_current_frame = false;
+        }
+    } else if (gba->settings.enable_frame_skipping && gba->settings.frame_skip_counter > 0) {
+        ppu->current_frame_skip_counter = (ppu->current_frame_skip_counter + 1) % gba->settings.frame_skip_counter;
+        ppu->skip_current_frame = (ppu->current_frame_skip_counter != 0);
+    } else {
+        ppu->skip_current_frame = false;
+    }
+
+    if (ppu->skip_current_frame && !gba->run_ahead.enabled) {
+        atomic_fetch_add(&gba->shared_data.frame_skip.skipped, 1);
     }
 }
 
@@ -335,10 +442,10 @@ ppu_draw_scanline(
 ** Called when the PPU enters HDraw, this function updates some IO registers
 ** to reflect the progress of the PPU and eventually triggers an IRQ.
 */
+static
 void
 ppu_hdraw(
-    struct gba *gba,
-    struct event_args args __unused
+    struct gba *gba
 ) {
     struct io *io;
 
@@ -349,18 +456,71 @@ ppu_hdraw(
 
     if (io->vcount.raw >= GBA_SCREEN_REAL_HEIGHT) {
         io->vcount.raw = 0;
-        atomic_fetch_add(&gba->shared_data.frame_counter, 1);
-        atomic_fetch_add(&gba->shared_data.framebuffer.version, 1);
 
-        if (gba->settings.enable_frame_skipping && gba->settings.frame_skip_counter > 0) {
-            gba->ppu.current_frame_skip_counter = (gba->ppu.current_frame_skip_counter + 1) % gba->settings.frame_skip_counter;
-            gba->ppu.skip_current_frame = (gba->ppu.current_frame_skip_counter != 0);
-        } else {
-            gba->ppu.skip_current_frame = false;
+        // Runs first, like when it was an event of its own firing at the same cycle.
+        sched_frame_limiter(gba);
+
+        if (!gba->run_ahead.speculating && !gba->rollback.resimulating) {
+            atomic_fetch_add(&gba->shared_data.frame_counter, 1);
+        }
+
+        if (!gba->run_ahead.speculating) {
+            run_ahead_latch(gba);
+        }
+
+        ppu_update_frame_skipping(gba);
+
+        // When running ahead, only the last frame of the speculation is drawn.
+        if (gba->run_ahead.enabled) {
+            gba->ppu.skip_current_frame = !run_ahead_publishes(&gba->run_ahead);
+        }
+
+        // When re-simulating, only the frame ending where the emulation was is drawn.
+        if (!rollback_publishes(&gba->rollback)) {
+            gba->ppu.skip_current_frame = true;
+        }
+
+        if (run_ahead_publishes(&gba->run_ahead)) {
+            atomic_fetch_add(&gba->shared_data.framebuffer.version, 1);
         }
     } else if (io->vcount.raw == GBA_SCREEN_HEIGHT) {
-        atomic_store(&gba->shared_data.framebuffer.dirty, true);
-        atomic_fetch_add(&gba->shared_data.framebuffer.version, 1);
+        if (run_ahead_publishes(&gba->run_ahead) && rollback_publishes(&gba->rollback)) {
+            bool changed;
+
+            changed = ppu_publish_dirty_tiles(gba);
+            atomic_store(&gba->shared_data.framebuffer.dirty, true);
+            atomic_fetch_add(&gba->shared_data.framebuffer.version, 1);
+            gba_shared_signal_event(gba, GBA_EVENT_FRAME);
+
+            // A re-simulated frame was recorded when it was first published.
+            if (gba->capture.enabled && !gba->rollback.resimulating) {
+                capture_frame(gba, changed);
+            }
+        }
+
+        if (atomic_load_explicit(&gba->cheats.enabled, memory_order_relaxed)) {
+            cheat_frame(gba);
+        }
+
+        if (gba->run_ahead.speculating) {
+            ++gba->run_ahead.frames_done;
+        } else {
+            // The digests describe the first run of each frame.
+            if (gba->digest.enabled && !gba->rollback.resimulating) {
+                digest_frame(gba);
+            }
+
+            if (atomic_load_explicit(&gba->shared_data.watch.enabled, memory_order_relaxed) && rollback_publishes(&gba->rollback)) {
+                watch_gather(gba);
+            }
+
+            if (gba->backup_persistence.enabled || gba->backup_persistence.mapped) {
+                mem_backup_storage_frame(gba);
+            }
+
+            gba->run_ahead.frame_ready = gba->run_ahead.enabled;
+            gba->rollback.frame_ready = true;
+        }
     }
 
     io->dispstat.vcount_eq = (io->vcount.raw == io->dispstat.vcount_val);
@@ -393,10 +553,10 @@ ppu_hdraw(
 ** Called when the PPU enters HBlank, this function updates some IO registers
 ** to reflect the progress of the PPU and eventually triggers an IRQ.
 */
+static
 void
 ppu_hblank(
-    struct gba *gba,
-    struct event_args args __unused
+    struct gba *gba
 ) {
     struct io *io;
 
@@ -406,6 +566,7 @@ ppu_hblank(
         struct scanline scanline;
 
         if (!gba->ppu.skip_current_frame) {
+            ppu_update_blend_luts(gba);
             ppu_initialize_scanline(gba, &scanline);
 
             if (!gba->io.dispcnt.blank) {
@@ -450,6 +611,36 @@ ppu_hblank(
     }
 }
 
+/*
+** The only event driving the PPU: it alternates between HDraw and HBlank, scheduling the
+** next phase before running the current one. The VBlank and the start of a new frame are
+** handled by `ppu_hdraw()` when VCOUNT reaches them.
+*/
+void
+ppu_scanline(
+    struct gba *gba,
+    struct event_args args
+) {
+    enum ppu_phase phase;
+
+    phase = args.a1.u32;
+
+    sched_add_event(
+        gba,
+        NEW_FIX_EVENT_ARGS(
+            SCHED_EVENT_PPU_SCANLINE,
+            gba->scheduler.cycles + (phase == PPU_PHASE_HDRAW ? PPU_HDRAW_CYCLES : PPU_HBLANK_CYCLES),
+            EVENT_ARG(u32, phase == PPU_PHASE_HDRAW ? PPU_PHASE_HBLANK : PPU_PHASE_HDRAW)
+        )
+    );
+
+    if (phase == PPU_PHASE_HDRAW) {
+        ppu_hdraw(gba);
+    } else {
+        ppu_hblank(gba);
+    }
+}
+
 /*
 ** Called when the CPU enters stop-mode to render the screen black.
 */
@@ -91,7 +91,7 @@ struct quicksave_backup_snapshot {
 };
 
 #define QUICKSAVE_MAGIC       "HSQS"
-#define QUICKSAVE_VERSION     2u
+#define QUICKSAVE_VERSION     3u
 
 static void quicksave_buffer_reserve(struct quicksave_buffer *buffer, size_t length) {
     if (buffer->index + length > buffer->size) {
@@ -187,10 +187,7 @@ static void quicksave_encode_rle(
         uint16_t chunk_len;
 
         value = data[i];
-        run = 1;
-        while (i + run < size && data[i + run] == value && run < UINT16_MAX) {
-            ++run;
-        }
+        run = isa.run_length(data + i, size - i, UINT16_MAX);
         chunk_len = (uint16_t)run;
         quicksave_write(out, (uint8_t *)&chunk_len, sizeof(chunk_len));
         quicksave_write(out, &value, sizeof(value));
@@ -304,12 +301,6 @@ static bool quicksave_read_region(
     }
 }
 
-static bool quickload_v1(
-    struct gba *gba,
-    uint8_t *data,
-    size_t size
-);
-
 /*
 ** Save the current state of the emulator in the given buffer.
 */
@@ -383,7 +374,7 @@ quicksave(
     }
 
     *data = buffer.data;
-    *size = buffer.size;
+    *size = buffer.index;
 }
 
 /*
@@ -400,6 +391,7 @@ quickload(
     struct quicksave_scheduler_snapshot sched = { 0 };
     struct scheduler_event *events_tmp = NULL;
     size_t events_tmp_len = 0;
+    size_t i;
     bool seen_core = false;
     bool seen_io = false;
     bool seen_ppu = false;
@@ -423,9 +415,10 @@ quickload(
         || quicksave_read(&buffer, (uint8_t *)&header, sizeof(header))
         || memcmp(header.magic, QUICKSAVE_MAGIC, sizeof(header.magic)) != 0
     ) {
-        return quickload_v1(gba, data, size);
+        return true;
     }
 
+    // Older versions store event kinds that were renumbered since.
     if (header.version != QUICKSAVE_VERSION) {
         return true;
     }
@@ -509,6 +502,11 @@ quickload(
                 if (quicksave_read(&buffer, (uint8_t *)events_tmp, chunk.size)) {
                     goto error;
                 }
+                for (i = 0; i < events_tmp_len; ++i) {
+                    if ((uint32_t)events_tmp[i].kind >= SCHED_EVENT_MAX) {
+                        goto error;
+                    }
+                }
                 break;
             };
             case QS_CHUNK_MEMORY_META: {
@@ -575,10 +573,7 @@ quickload(
                     uint8_t *storage;
 
                     if (gba->shared_data.backup_storage.size != meta.size) {
-                        free(gba->shared_data.backup_storage.data);
-                        gba->shared_data.backup_storage.data = malloc(meta.size);
-                        hs_assert(gba->shared_data.backup_storage.data);
-                        gba->shared_data.backup_storage.size = meta.size;
+                        mem_backup_storage_resize(gba, meta.size);
                     }
 
                     storage = gba->shared_data.backup_storage.data;
@@ -586,9 +581,7 @@ quickload(
                         goto error;
                     }
                 } else {
-                    free(gba->shared_data.backup_storage.data);
-                    gba->shared_data.backup_storage.data = NULL;
-                    gba->shared_data.backup_storage.size = 0;
+                    mem_backup_storage_resize(gba, 0);
                     if (quicksave_read_region(&buffer, chunk_end, NULL, 0)) {
                         goto error;
                     }
@@ -648,63 +641,3 @@ error:
     free(events_tmp);
     return (true);
 }
-
-static bool
-quickload_v1(
-    struct gba *gba,
-    uint8_t *data,
-    size_t size
-) {
-    struct quicksave_buffer buffer;
-    size_t i;
-    struct rom_view rom_view;
-
-    buffer.data = data;
-    buffer.size = size;
-    buffer.index = 0;
-
-    free(gba->scheduler.events);
-    gba->scheduler.events = NULL;
-    gba->scheduler.events_size = 0;
-
-    rom_view = gba->memory.rom;
-
-    if (
-           quicksave_read(&buffer, (uint8_t *)&gba->core, sizeof(gba->core))
-        || quicksave_read(&buffer, (uint8_t *)&gba->memory, sizeof(gba->memory))
-        || quicksave_read(&buffer, (uint8_t *)&gba->io, sizeof(gba->io))
-        || quicksave_read(&buffer, (uint8_t *)&gba->ppu, sizeof(gba->ppu))
-        || quicksave_read(&buffer, (uint8_t *)&gba->gpio, sizeof(gba->gpio))
-        || quicksave_read(&buffer, (uint8_t *)&gba->apu, sizeof(gba->apu))
-        || quicksave_read(&buffer, (uint8_t *)&gba->scheduler.cycles, sizeof(uint64_t))
-        || quicksave_read(&buffer, (uint8_t *)&gba->scheduler.next_event, sizeof(uint64_t))
-        || quicksave_read(&buffer, (uint8_t *)&gba->scheduler.events_size, sizeof(size_t))
-    ) {
-        return (true);
-    }
-
-    gba->memory.rom = rom_view;
-
-    if (gba->scheduler.events_size) {
-        gba->scheduler.events = calloc(gba->scheduler.events_size, sizeof(struct scheduler_event));
-        hs_assert(gba->scheduler.events);
-    }
-
-    for (i = 0; i < gba->scheduler.events_size; ++i) {
-        struct scheduler_event *event;
-
-        event = &gba->scheduler.events[i];
-        if (
-               quicksave_read(&buffer, (uint8_t *)&event->kind, sizeof(enum sched_event_kind))
-            || quicksave_read(&buffer, (uint8_t *)&event->active, sizeof(bool))
-            || quicksave_read(&buffer, (uint8_t *)&event->repeat, sizeof(bool))
-            || quicksave_read(&buffer, (uint8_t *)&event->at, sizeof(uint64_t))
-            || quicksave_read(&buffer, (uint8_t *)&event->period, sizeof(uint64_t))
-            || quicksave_read(&buffer, (uint8_t *)&event->args, sizeof(struct event_args))
-        ) {
-            return (true);
-        }
-    }
-
-    return (false);
-}
@@ -0,0 +1,387 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+#define ROLLBACK_KEYS_ALL       ((1u << KEY_MAX) - 1)
+
+/*
+** Release the ring of saved frames and the inputs held back.
+*/
+void
+rollback_release(
+    struct gba *gba
+) {
+    struct rollback *rollback;
+    uint32_t i;
+
+    rollback = &gba->rollback;
+
+    for (i = 0; i < rollback->ring_len; ++i) {
+        snapshot_delete(rollback->ring[i].snapshot);
+    }
+    free(rollback->ring);
+    rollback->ring = NULL;
+    rollback->ring_len = 0;
+
+    free(rollback->delayed);
+    rollback->delayed = NULL;
+    rollback->delayed_len = 0;
+    rollback->delayed_size = 0;
+}
+
+/*
+** Forget everything about the previous game or state. Frames are numbered from 0 again.
+*/
+void
+rollback_reset(
+    struct gba *gba
+) {
+    rollback_release(gba);
+    memset(&gba->rollback, 0, sizeof(gba->rollback));
+    atomic_store(&gba->shared_data.rollback.frame, 0);
+}
+
+/*
+** Return the keys pressed according to REG_KEYINPUT, as a bitfield of `enum keys`.
+*/
+static
+uint32_t
+rollback_current_keys(
+    struct gba const *gba
+) {
+    uint32_t keys;
+
+    keys = 0;
+    keys |= (uint32_t)!gba->io.keyinput.a << KEY_A;
+    keys |= (uint32_t)!gba->io.keyinput.b << KEY_B;
+    keys |= (uint32_t)!gba->io.keyinput.l << KEY_L;
+    keys |= (uint32_t)!gba->io.keyinput.r << KEY_R;
+    keys |= (uint32_t)!gba->io.keyinput.up << KEY_UP;
+    keys |= (uint32_t)!gba->io.keyinput.down << KEY_DOWN;
+    keys |= (uint32_t)!gba->io.keyinput.left << KEY_LEFT;
+    keys |= (uint32_t)!gba->io.keyinput.right << KEY_RIGHT;
+    keys |= (uint32_t)!gba->io.keyinput.start << KEY_START;
+    keys |= (uint32_t)!gba->io.keyinput.select << KEY_SELECT;
+    return (keys);
+}
+
+/*
+** Latch the rollback settings for the frame starting, reallocating the ring if its size changed.
+*/
+static
+void
+rollback_latch(
+    struct gba *gba
+) {
+    struct rollback *rollback;
+    bool enabled;
+    uint32_t i;
+
+    rollback = &gba->rollback;
+    enabled = (gba->settings.rollback.frames > 0) && !gba->link.hub;
+
+#ifdef WITH_DEBUGGER
+    // Breakpoints and the stepping modes must see every instruction once.
+    enabled = enabled
+        && gba->debugger.run_mode == GBA_RUN_MODE_NORMAL
+        && !gba->debugger.breakpoints.len
+        && !gba->debugger.watchpoints.len
+    ;
+#endif
+
+    if (enabled && !rollback->enabled) {
+        rollback->keys = rollback_current_keys(gba);
+        rollback->keys_frame = rollback->frame;
+        rollback->local_keys = rollback->keys;
+    }
+
+    rollback->enabled = enabled;
+    rollback->delay = gba->settings.rollback.delay;
+
+    if (!enabled) {
+        rollback_release(gba);
+        rollback->dirty = false;
+        return;
+    }
+
+    if (rollback->ring_len != gba->settings.rollback.frames) {
+        for (i = 0; i < rollback->ring_len; ++i) {
+            snapshot_delete(rollback->ring[i].snapshot);
+        }
+        free(rollback->ring);
+
+        rollback->ring_len = gba->settings.rollback.frames;
+        rollback->ring = calloc(rollback->ring_len, sizeof(struct rollback_frame));
+        hs_assert(rollback->ring);
+
+        for (i = 0; i < rollback->ring_len; ++i) {
+            rollback->ring[i].frame = UINT64_MAX;
+        }
+        rollback->dirty = false;
+    }
+}
+
+/*
+** Hold back an input until the frame `deliver` starts.
+*/
+static
+void
+rollback_delay_input(
+    struct rollback *rollback,
+    uint64_t frame,
+    uint32_t keys,
+    uint64_t deliver
+) {
+    if (rollback->delayed_len == rollback->delayed_size) {
+        rollback->delayed_size = rollback->delayed_size ? rollback->delayed_size * 2 : 16;
+        rollback->delayed = realloc(rollback->delayed, rollback->delayed_size * sizeof(struct rollback_input));
+        hs_assert(rollback->delayed);
+    }
+
+    rollback->delayed[rollback->delayed_len++] = (struct rollback_input){
+        .frame = frame,
+        .keys = keys,
+        .deliver = deliver,
+    };
+}
+
+/*
+** Apply the inputs held back whose time has come, in the order they were received.
+*/
+static
+void
+rollback_deliver_inputs(
+    struct gba *gba
+) {
+    struct rollback *rollback;
+    uint32_t kept;
+    uint32_t i;
+
+    rollback = &gba->rollback;
+    kept = 0;
+    for (i = 0; i < rollback->delayed_len; ++i) {
+        struct rollback_input input;
+
+        input = rollback->delayed[i];
+        if (input.deliver <= rollback->frame) {
+            rollback_input(gba, input.frame, input.keys);
+        } else {
+            rollback->delayed[kept++] = input;
+        }
+    }
+    rollback->delayed_len = kept;
+}
+
+/*
+** Start a new frame: apply its input and save the state.
+**
+** Called by `gba_run()` once `rollback.frame_ready` is set, between two calls to `sched_run_for()`,
+** and while re-simulating.
+*/
+void
+rollback_frame(
+    struct gba *gba
+) {
+    struct rollback *rollback;
+    struct rollback_frame *slot;
+
+    rollback = &gba->rollback;
+    rollback->frame_ready = false;
+
+    ++rollback->frame;
+
+    if (!rollback->resimulating) {
+        atomic_store(&gba->shared_data.rollback.frame, rollback->frame);
+        rollback_latch(gba);
+    }
+
+    if (!rollback->enabled) {
+        return;
+    }
+
+    slot = &rollback->ring[rollback->frame % rollback->ring_len];
+
+    // When re-simulating, the input of the frame may have been corrected.
+    if (slot->frame != rollback->frame) {
+        slot->frame = rollback->frame;
+        slot->keys = rollback->keys;
+        slot->confirmed = false;
+    }
+
+    if (!slot->snapshot) {
+        slot->snapshot = snapshot_create();
+    }
+
+    gba_set_keys(gba, ROLLBACK_KEYS_ALL, slot->keys);
+    snapshot_save(gba, slot->snapshot);
+
+    if (!rollback->resimulating) {
+        rollback_deliver_inputs(gba);
+    }
+}
+
+/*
+** Record the keys pressed during `frame`, as a bitfield of `enum keys`.
+**
+** If that frame is over and ran with other keys, it is marked for `rollback_resimulate()`.
+** Inputs for frames that aren't in the ring anymore only affect the frames to come.
+*/
+void
+rollback_input(
+    struct gba *gba,
+    uint64_t frame,
+    uint32_t keys
+) {
+    struct rollback *rollback;
+    struct rollback_frame *slot;
+    uint64_t next;
+
+    rollback = &gba->rollback;
+
+    if (!rollback->enabled) {
+        gba_set_keys(gba, ROLLBACK_KEYS_ALL, keys);
+        return;
+    }
+
+    if (frame > rollback->frame) {
+        rollback_delay_input(rollback, frame, keys, frame);
+        return;
+    }
+
+    if (frame >= rollback->keys_frame) {
+        rollback->keys = keys;
+        rollback->keys_frame = frame;
+    }
+
+    slot = &rollback->ring[frame % rollback->ring_len];
+    if (slot->frame != frame) {
+        atomic_fetch_add(&gba->shared_data.rollback.late, 1);
+        return;
+    }
+
+    slot->confirmed = true;
+    if (slot->keys == keys) {
+        return;
+    }
+
+    // The frames after it that didn't receive their input yet are predicted to keep this one.
+    slot->keys = keys;
+    for (next = frame + 1; next <= rollback->frame; ++next) {
+        slot = &rollback->ring[next % rollback->ring_len];
+        if (slot->frame != next || slot->confirmed) {
+            break;
+        }
+        slot->keys = keys;
+    }
+
+    if (!rollback->dirty || frame < rollback->dirty_frame) {
+        rollback->dirty_frame = frame;
+    }
+    rollback->dirty = true;
+}
+
+/*
+** Set the state of the local keys in `mask` to the one of the matching bits of `pressed`, during
+** the frame running.
+**
+** They are held back for `gba_settings.rollback.delay` frames, to test rollback without a remote player.
+*/
+void
+rollback_local_keys(
+    struct gba *gba,
+    uint32_t mask,
+    uint32_t pressed
+) {
+    struct rollback *rollback;
+
+    rollback = &gba->rollback;
+    rollback->local_keys = (rollback->local_keys & ~mask) | (pressed & mask);
+
+    if (rollback->delay) {
+        rollback_delay_input(rollback, rollback->frame, rollback->local_keys, rollback->frame + rollback->delay);
+    } else {
+        rollback_input(gba, rollback->frame, rollback->local_keys);
+    }
+}
+
+/*
+** Go back to the oldest frame whose input was corrected and run again up to where the emulation was.
+*/
+void
+rollback_resimulate(
+    struct gba *gba
+) {
+    struct rollback *rollback;
+    struct rollback_frame *slot;
+    uint64_t target;
+    uint64_t depth;
+    uint64_t start;
+    uint32_t max_depth;
+
+    rollback = &gba->rollback;
+    rollback->dirty = false;
+
+    slot = &rollback->ring[rollback->dirty_frame % rollback->ring_len];
+    if (slot->frame != rollback->dirty_frame || !slot->snapshot) {
+        return;
+    }
+
+    start = hs_time();
+    target = gba->scheduler.cycles;
+    depth = rollback->frame - rollback->dirty_frame;
+
+    // Left alone if untouched since, so a mapped backup storage isn't rewritten.
+    snapshot_restore(gba, slot->snapshot, rollback->backup_frame >= rollback->dirty_frame);
+
+    // The pages hashed since the snapshot may not be written again by the new run.
+    digest_invalidate(gba);
+
+    rollback->present = rollback->frame;
+    rollback->frame = rollback->dirty_frame;
+    rollback->resimulating = true;
+
+    gba_set_keys(gba, ROLLBACK_KEYS_ALL, slot->keys);
+    snapshot_save(gba, slot->snapshot);
+
+    // Same steps as `gba_run()`, so that the frames start at the same cycles as the first time.
+    while (gba->scheduler.cycles < target) {
+        uint64_t cycles;
+
+        cycles = gba->scheduler.cycles;
+        sched_run_for(gba, min(target - cycles, (uint64_t)(GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH)));
+
+        if (rollback->frame_ready) {
+            rollback_frame(gba);
+        }
+
+        // The CPU is stopped, the rest wouldn't change anything.
+        if (gba->scheduler.cycles == cycles) {
+            break;
+        }
+    }
+
+    rollback->resimulating = false;
+
+    atomic_fetch_add(&gba->shared_data.rollback.rollbacks, 1);
+    atomic_fetch_add(&gba->shared_data.rollback.frames, (uint32_t)depth);
+    atomic_fetch_add(&gba->shared_data.rollback.time, hs_time() - start);
+
+    max_depth = atomic_load(&gba->shared_data.rollback.max_depth);
+    if (depth > max_depth) {
+        atomic_store(&gba->shared_data.rollback.max_depth, (uint32_t)depth);
+    }
+}
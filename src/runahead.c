@@ -0,0 +1,289 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+/*
+** Allocate the instance used to run ahead when `second_instance` is set.
+**
+** It never goes through `gba_state_reset()`: its state is copied from the real timeline
+** by `run_ahead_clone()` before each speculation.
+*/
+static
+struct gba *
+run_ahead_create_shadow(
+    struct gba const *gba
+) {
+    struct gba *shadow;
+
+    shadow = calloc(1, sizeof(struct gba));
+    hs_assert(shadow);
+
+    pthread_mutex_init(&shadow->shared_data.framebuffer.lock, NULL);
+    pthread_mutex_init(&shadow->shared_data.audio_rbuffer_mutex, NULL);
+    shadow->shared_data.event.read_fd = -1;
+    shadow->shared_data.event.write_fd = -1;
+
+    memcpy(shadow->memory.bios, gba->memory.bios, sizeof(shadow->memory.bios));
+
+    // The lines drawn by the shadow instance are compared with the published ones.
+    memcpy(shadow->shared_data.framebuffer.data, gba->shared_data.framebuffer.data, sizeof(shadow->shared_data.framebuffer.data));
+
+    return (shadow);
+}
+
+static
+void
+run_ahead_delete_shadow(
+    struct gba *shadow
+) {
+    if (shadow) {
+        free(shadow->scheduler.events);
+        free(shadow->shared_data.backup_storage.data);
+        pthread_mutex_destroy(&shadow->shared_data.framebuffer.lock);
+        pthread_mutex_destroy(&shadow->shared_data.audio_rbuffer_mutex);
+    }
+    free(shadow);
+}
+
+/*
+** Copy the state of the real timeline to the shadow instance.
+*/
+static
+void
+run_ahead_clone(
+    struct gba *shadow,
+    struct gba const *gba
+) {
+    shadow->settings = gba->settings;
+
+    snapshot_clone(shadow, gba);
+
+    // Another frame was published since the shadow instance last did (eg. run-ahead or `second_instance`
+    // was toggled off for a while), so its framebuffer no longer is the one the drawn lines must be compared with.
+    if (atomic_load(&gba->shared_data.framebuffer.version) != gba->run_ahead.shadow_version) {
+        memcpy(shadow->shared_data.framebuffer.data, gba->shared_data.framebuffer.data, sizeof(shadow->shared_data.framebuffer.data));
+    }
+
+    // The shadow instance borrows the cheats of the real timeline, whose ROM it shares.
+    shadow->cheats.active = gba->cheats.active;
+    atomic_store(&shadow->cheats.enabled, atomic_load(&gba->cheats.enabled));
+
+    shadow->run_ahead.enabled = true;
+    shadow->run_ahead.frames = gba->run_ahead.frames;
+    shadow->run_ahead.audio_from_real_timeline = gba->run_ahead.audio_from_real_timeline;
+}
+
+/*
+** Run the given instance until it completes `run_ahead.frames` frames.
+*/
+static
+void
+run_ahead_speculate(
+    struct gba *gba
+) {
+    struct run_ahead *run_ahead;
+
+    run_ahead = &gba->run_ahead;
+    run_ahead->speculating = true;
+    run_ahead->frames_done = 0;
+
+    while (run_ahead->frames_done < run_ahead->frames) {
+        uint64_t cycles;
+
+        cycles = gba->scheduler.cycles;
+        sched_run_for(gba, GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH);
+
+        // The CPU is stopped, there's nothing ahead to show.
+        if (gba->scheduler.cycles == cycles) {
+            break;
+        }
+    }
+
+    run_ahead->speculating = false;
+}
+
+/*
+** Publish the frame and the audio produced by the shadow instance.
+*/
+static
+void
+run_ahead_publish_shadow(
+    struct gba *gba,
+    struct gba *shadow
+) {
+    if (shadow->run_ahead.frames_done == shadow->run_ahead.frames) {
+        uint32_t changed;
+        size_t y;
+
+        atomic_fetch_add(&gba->shared_data.framebuffer.version, 1);
+        changed = 0;
+        gba_shared_framebuffer_lock(gba);
+        memcpy(gba->shared_data.framebuffer.data, shadow->shared_data.framebuffer.data, sizeof(gba->shared_data.framebuffer.data));
+        for (y = 0; y < GBA_SCREEN_HEIGHT; ++y) {
+            gba->shared_data.framebuffer.dirty_tiles[y] |= shadow->shared_data.framebuffer.dirty_tiles[y];
+            changed |= shadow->shared_data.framebuffer.dirty_tiles[y];
+        }
+        gba_shared_framebuffer_release(gba);
+        memset(shadow->shared_data.framebuffer.dirty_tiles, 0, sizeof(shadow->shared_data.framebuffer.dirty_tiles));
+        atomic_store(&gba->shared_data.framebuffer.dirty, true);
+        gba->run_ahead.shadow_version = atomic_fetch_add(&gba->shared_data.framebuffer.version, 1) + 1;
+        gba_shared_signal_event(gba, GBA_EVENT_FRAME);
+
+        if (gba->capture.enabled) {
+            capture_frame(gba, changed != 0);
+        }
+    }
+
+    if (shadow->shared_data.audio_rbuffer.size) {
+        struct apu_rbuffer *rbuffer;
+        size_t size;
+
+        rbuffer = &shadow->shared_data.audio_rbuffer;
+
+        pthread_mutex_lock(&gba->shared_data.audio_rbuffer_mutex);
+        while (rbuffer->size) {
+            uint32_t sample;
+
+            sample = apu_rbuffer_pop(rbuffer);
+            apu_rbuffer_push(&gba->shared_data.audio_rbuffer, (int16_t)(sample >> 16), (int16_t)sample);
+
+            if (gba->capture.enabled) {
+                capture_audio(gba, (int16_t)(sample >> 16), (int16_t)sample);
+            }
+        }
+        size = gba->shared_data.audio_rbuffer.size;
+        pthread_mutex_unlock(&gba->shared_data.audio_rbuffer_mutex);
+
+        if (size >= GBA_EVENT_AUDIO_BLOCK) {
+            gba_shared_signal_event(gba, GBA_EVENT_AUDIO);
+        }
+    }
+}
+
+/*
+** Latch the run-ahead settings for the frame the real timeline is starting.
+*/
+void
+run_ahead_latch(
+    struct gba *gba
+) {
+    struct run_ahead *run_ahead;
+
+    run_ahead = &gba->run_ahead;
+    run_ahead->enabled = (gba->settings.run_ahead.frames > 0);
+
+#ifdef WITH_DEBUGGER
+    // Breakpoints, watchpoints and the stepping modes must only see the real timeline.
+    run_ahead->enabled = run_ahead->enabled
+        && gba->debugger.run_mode == GBA_RUN_MODE_NORMAL
+        && !gba->debugger.breakpoints.len
+        && !gba->debugger.watchpoints.len
+    ;
+#endif
+
+    run_ahead->frames = gba->settings.run_ahead.frames;
+    run_ahead->audio_from_real_timeline = gba->settings.run_ahead.audio_from_real_timeline;
+    run_ahead->second_instance = gba->settings.run_ahead.second_instance;
+}
+
+/*
+** Run ahead of the frame the real timeline just completed and publish the result.
+**
+** Called by `gba_run()` once `run_ahead.frame_ready` is set, between two calls to `sched_run_for()`.
+*/
+void
+run_ahead_frame(
+    struct gba *gba
+) {
+    struct run_ahead *run_ahead;
+    uint64_t start;
+    uint64_t end;
+
+    run_ahead = &gba->run_ahead;
+    run_ahead->frame_ready = false;
+
+    if (!run_ahead->enabled) {
+        return;
+    }
+
+    start = hs_time();
+
+    if (run_ahead->second_instance) {
+        if (!run_ahead->shadow) {
+            run_ahead->shadow = run_ahead_create_shadow(gba);
+        }
+
+        run_ahead_clone(run_ahead->shadow, gba);
+        end = hs_time();
+        run_ahead->stats.save_time += end - start;
+        start = end;
+
+        run_ahead_speculate(run_ahead->shadow);
+        run_ahead_publish_shadow(gba, run_ahead->shadow);
+
+        end = hs_time();
+        run_ahead->stats.speculation_time += end - start;
+    } else {
+        if (!run_ahead->snapshot) {
+            run_ahead->snapshot = snapshot_create();
+        }
+
+        snapshot_save(gba, run_ahead->snapshot);
+        end = hs_time();
+        run_ahead->stats.save_time += end - start;
+        start = end;
+
+        run_ahead_speculate(gba);
+        end = hs_time();
+        run_ahead->stats.speculation_time += end - start;
+        start = end;
+
+        // Left alone if untouched, so a mapped backup storage isn't rewritten every frame.
+        snapshot_restore(gba, run_ahead->snapshot, run_ahead->backup_written);
+        run_ahead->backup_written = false;
+        end = hs_time();
+        run_ahead->stats.restore_time += end - start;
+    }
+
+    ++run_ahead->stats.frames;
+}
+
+/*
+** Release the snapshot and the shadow instance.
+*/
+void
+run_ahead_release(
+    struct gba *gba
+) {
+    snapshot_delete(gba->run_ahead.snapshot);
+    gba->run_ahead.snapshot = NULL;
+
+    run_ahead_delete_shadow(gba->run_ahead.shadow);
+    gba->run_ahead.shadow = NULL;
+}
+
+/*
+** Forget everything about the previous game.
+** The shadow instance is released since the BIOS may have changed.
+*/
+void
+run_ahead_reset(
+    struct gba *gba
+) {
+    run_ahead_release(gba);
+    memset(&gba->run_ahead, 0, sizeof(gba->run_ahead));
+}
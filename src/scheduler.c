@@ -18,9 +18,7 @@
 #include "gba/memory.h"
 
 void (*sched_event_callbacks[])(struct gba *gba, struct event_args args) = {
-    [SCHED_EVENT_FRAME_LIMITER] = sched_frame_limiter,
-    [SCHED_EVENT_PPU_HDRAW] = ppu_hdraw,
-    [SCHED_EVENT_PPU_HBLANK] = ppu_hblank,
+    [SCHED_EVENT_PPU_SCANLINE] = ppu_scanline,
     [SCHED_EVENT_TIMER_OVERFLOW] = timer_overflow,
     [SCHED_EVENT_APU_MODULES_STEP] = apu_modules_step,
     [SCHED_EVENT_APU_RESAMPLE] = apu_resample,
@@ -31,6 +29,7 @@ void (*sched_event_callbacks[])(struct gba *gba, struct event_args args) = {
     [SCHED_EVENT_DMA_ADD_PENDING] = mem_dma_add_to_pending,
     [SCHED_EVENT_IO_WRITE] = io_register_delayed_write,
     [SCHED_EVENT_CORE_UPDATE_IRQ_LINE] = core_update_irq_line,
+    [SCHED_EVENT_LINK_TRANSFER] = link_transfer_end,
 };
 
 void
@@ -144,6 +143,38 @@ sched_cancel_event(
     // TODO: update `scheduler->next_event`? Is it worth it?
 }
 
+/*
+** Return true if the core can't run in `core_run()`'s tight loop and must go through
+** `core_next()`, which handles IRQs, the halted and stopped states and breakpoints.
+**
+** These are levels rather than edges: as long as the IRQ line is raised, for example,
+** every instruction is executed by `core_next()` to catch the moment the CPSR unmasks it.
+*/
+static inline
+bool
+sched_core_needs_attention(
+    struct gba const *gba
+) {
+#ifdef WITH_DEBUGGER
+    if (gba->debugger.breakpoints.len) {
+        return (true);
+    }
+#endif
+
+    return (gba->core.irq_line || gba->core.state != CORE_RUN);
+}
+
+/*
+** Make `core_run()` return after the instruction being executed, so that `sched_run_for()`
+** re-evaluates what the core needs.
+*/
+void
+sched_raise_attention(
+    struct gba *gba
+) {
+    gba->scheduler.run_limit = 0;
+}
+
 void
 sched_run_for(
     struct gba *gba,
@@ -165,6 +196,12 @@ sched_run_for(
         uint64_t elapsed;
         uint64_t old_cycles;
 
+        if (likely(!sched_core_needs_attention(gba))) {
+            scheduler->run_limit = target;
+            core_run(gba);
+            continue;
+        }
+
         old_cycles = scheduler->cycles;
         core_next(gba);
         elapsed = scheduler->cycles - old_cycles;
@@ -184,13 +221,21 @@ sched_reset_frame_limiter(
 ) {
     gba->scheduler.accumulated_time = 0;
     gba->scheduler.time_last_frame = hs_time();
+    gba->scheduler.late = false;
 }
 
+/*
+** Called by the PPU at the start of each frame.
+*/
 void
 sched_frame_limiter(
-    struct gba *gba,
-    struct event_args args __unused
+    struct gba *gba
 ) {
+    // Frames run ahead of the real timeline, or run again, are free.
+    if (gba->run_ahead.speculating || gba->rollback.resimulating) {
+        return;
+    }
+
     if (gba->scheduler.time_per_frame) {
         uint64_t now;
 
@@ -202,6 +247,15 @@ sched_frame_limiter(
             hs_usleep(gba->scheduler.time_per_frame - gba->scheduler.accumulated_time);
         }
         gba->scheduler.accumulated_time -= gba->scheduler.time_per_frame;
+
+        // `accumulated_time` wraps below zero when we are ahead of time.
+        // A small delay is left to the next sleep, anything larger is for the adaptive frame skipping to catch up.
+        gba->scheduler.late = (int64_t)gba->scheduler.accumulated_time > (int64_t)(gba->scheduler.time_per_frame / SCHED_LATE_THRESHOLD);
+        if (gba->scheduler.late) {
+            atomic_fetch_add(&gba->shared_data.frame_skip.late, 1);
+        }
+    } else {
+        gba->scheduler.late = false;
     }
 }
 
@@ -0,0 +1,191 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+static_assert(offsetof(struct memory, iwram) == offsetof(struct memory, ewram) + EWRAM_SIZE);
+static_assert(RAM_SEARCH_SIZE % ISA_SEARCH_CHUNK == 0);
+
+struct ram_search {
+    uint32_t width;
+
+    // One bit per aligned element of `width` bytes, set while it is a candidate.
+    uint64_t *candidates;
+    size_t count;
+
+    // The RAM at the previous step.
+    uint8_t *prev;
+};
+
+/*
+** Start a search over elements of `width` (1, 2 or 4) bytes, all of them being candidates.
+** Return NULL if `width` is invalid.
+*/
+struct ram_search *
+ram_search_create(
+    uint32_t width,
+    uint8_t const *ram
+) {
+    struct ram_search *search;
+
+    if (width != 1 && width != 2 && width != 4) {
+        logln(HS_ERROR, "Invalid RAM search width %u.", width);
+        return (NULL);
+    }
+
+    search = calloc(1, sizeof(struct ram_search));
+    hs_assert(search);
+
+    search->width = width;
+    search->candidates = malloc(RAM_SEARCH_SIZE / 8);
+    search->prev = malloc(RAM_SEARCH_SIZE);
+    hs_assert(search->candidates && search->prev);
+
+    ram_search_reset(search, ram);
+    return (search);
+}
+
+void
+ram_search_delete(
+    struct ram_search *search
+) {
+    if (search) {
+        free(search->candidates);
+        free(search->prev);
+    }
+    free(search);
+}
+
+/*
+** Make all the elements candidates again.
+*/
+void
+ram_search_reset(
+    struct ram_search *search,
+    uint8_t const *ram
+) {
+    size_t bits;
+
+    bits = RAM_SEARCH_SIZE / search->width;
+    memset(search->candidates, 0, RAM_SEARCH_SIZE / 8);
+    memset(search->candidates, 0xFF, bits / 8);
+    search->count = bits;
+    memcpy(search->prev, ram, RAM_SEARCH_SIZE);
+}
+
+/*
+** Keep the candidates of `ram` meeting `cond`, and return how many are left.
+** `ram` becomes the reference of the next step.
+*/
+size_t
+ram_search_step(
+    struct ram_search *search,
+    uint8_t const *ram,
+    enum ram_search_conditions cond,
+    uint32_t value
+) {
+    uint8_t pattern[ISA_SEARCH_CHUNK];
+    uint8_t const *ref;
+    size_t ref_step;
+    enum isa_compare cmp;
+    size_t words;
+    size_t i;
+
+    // Conditions on a value compare each chunk with the same chunk-sized pattern.
+    if (cond <= RAM_SEARCH_LESS) {
+        for (i = 0; i < ISA_SEARCH_CHUNK; i += search->width) {
+            memcpy(pattern + i, &value, search->width);
+        }
+        ref = pattern;
+        ref_step = 0;
+    } else {
+        ref = search->prev;
+        ref_step = ISA_SEARCH_CHUNK;
+    }
+
+    switch (cond) {
+        case RAM_SEARCH_EQUAL:
+        case RAM_SEARCH_UNCHANGED:      cmp = ISA_CMP_EQ; break;
+        case RAM_SEARCH_NOT_EQUAL:
+        case RAM_SEARCH_CHANGED:        cmp = ISA_CMP_NE; break;
+        case RAM_SEARCH_GREATER:
+        case RAM_SEARCH_INCREASED:      cmp = ISA_CMP_GT; break;
+        case RAM_SEARCH_LESS:
+        case RAM_SEARCH_DECREASED:      cmp = ISA_CMP_LT; break;
+        default:                        panic(HS_ERROR, "Invalid RAM search condition %i.", cond);
+    }
+
+    isa.search_filter(search->candidates, ram, ref, ref_step, RAM_SEARCH_SIZE, search->width, cmp);
+    memcpy(search->prev, ram, RAM_SEARCH_SIZE);
+
+    search->count = 0;
+    words = RAM_SEARCH_SIZE / search->width / 64;
+    for (i = 0; i < words; ++i) {
+        search->count += __builtin_popcountll(search->candidates[i]);
+    }
+
+    return (search->count);
+}
+
+size_t
+ram_search_count(
+    struct ram_search const *search
+) {
+    return (search->count);
+}
+
+/*
+** Write the address of up to `max` candidates to `addrs`, skipping the first `start` ones,
+** and return how many were written.
+*/
+size_t
+ram_search_results(
+    struct ram_search const *search,
+    size_t start,
+    uint32_t *addrs,
+    size_t max
+) {
+    size_t words;
+    size_t n;
+    size_t i;
+
+    words = RAM_SEARCH_SIZE / search->width / 64;
+    n = 0;
+    for (i = 0; i < words && n < max; ++i) {
+        uint64_t word;
+
+        word = search->candidates[i];
+        if ((size_t)__builtin_popcountll(word) <= start) {
+            start -= __builtin_popcountll(word);
+            continue;
+        }
+
+        while (word && n < max) {
+            uint32_t offset;
+
+            offset = (uint32_t)((i * 64 + __builtin_ctzll(word)) * search->width);
+            word &= word - 1;
+
+            if (start) {
+                --start;
+                continue;
+            }
+
+            addrs[n++] = (offset < EWRAM_SIZE) ? EWRAM_START + offset : IWRAM_START + (offset - EWRAM_SIZE);
+        }
+    }
+    return (n);
+}
@@ -0,0 +1,210 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+/*
+** The part of `struct memory` the emulation can modify. The BIOS is left out.
+*/
+#define SNAPSHOT_MEMORY_OFFSET      offsetof(struct memory, ewram)
+#define SNAPSHOT_MEMORY_SIZE        (sizeof(struct memory) - SNAPSHOT_MEMORY_OFFSET)
+
+/*
+** A raw copy of the emulator's state.
+**
+** Unlike a quicksave, it is only ever restored in the process that took it, on an instance
+** running the same game, so none of the checks and conversions of `quickload()` are needed.
+*/
+struct snapshot {
+    struct core core;
+    struct io io;
+    struct ppu ppu;
+    struct apu apu;
+    struct gpio gpio;
+
+    uint64_t cycles;
+    uint64_t next_event;
+    struct scheduler_event *events;
+    size_t events_size;
+
+    uint8_t memory[SNAPSHOT_MEMORY_SIZE];
+
+    uint8_t *backup_storage;
+    size_t backup_storage_size;
+    bool backup_storage_dirty;
+};
+
+/*
+** Copy `size` bytes from `src` to `*dst`, reallocating `*dst` if its size, `*dst_size`, differs.
+*/
+static
+void
+snapshot_copy(
+    void **dst,
+    size_t *dst_size,
+    void const *src,
+    size_t size
+) {
+    if (*dst_size != size) {
+        free(*dst);
+        *dst = size ? malloc(size) : NULL;
+        hs_assert(!size || *dst);
+        *dst_size = size;
+    }
+
+    if (size) {
+        memcpy(*dst, src, size);
+    }
+}
+
+/*
+** Copy the scheduler's events of `src` to `dst`.
+*/
+static
+void
+snapshot_copy_events(
+    struct scheduler_event **dst,
+    size_t *dst_len,
+    struct scheduler_event const *src,
+    size_t len
+) {
+    size_t size;
+
+    size = *dst_len * sizeof(struct scheduler_event);
+    snapshot_copy((void **)dst, &size, src, len * sizeof(struct scheduler_event));
+    *dst_len = len;
+}
+
+struct snapshot *
+snapshot_create(
+    void
+) {
+    struct snapshot *snapshot;
+
+    snapshot = calloc(1, sizeof(struct snapshot));
+    hs_assert(snapshot);
+    return (snapshot);
+}
+
+void
+snapshot_delete(
+    struct snapshot *snapshot
+) {
+    if (snapshot) {
+        free(snapshot->events);
+        free(snapshot->backup_storage);
+    }
+    free(snapshot);
+}
+
+void
+snapshot_save(
+    struct gba const *gba,
+    struct snapshot *snapshot
+) {
+    snapshot->core = gba->core;
+    snapshot->io = gba->io;
+    snapshot->ppu = gba->ppu;
+    snapshot->apu = gba->apu;
+    snapshot->gpio = gba->gpio;
+
+    snapshot->cycles = gba->scheduler.cycles;
+    snapshot->next_event = gba->scheduler.next_event;
+    snapshot_copy_events(&snapshot->events, &snapshot->events_size, gba->scheduler.events, gba->scheduler.events_size);
+
+    memcpy(snapshot->memory, (uint8_t const *)&gba->memory + SNAPSHOT_MEMORY_OFFSET, SNAPSHOT_MEMORY_SIZE);
+
+    snapshot_copy(
+        (void **)&snapshot->backup_storage,
+        &snapshot->backup_storage_size,
+        gba->shared_data.backup_storage.data,
+        gba->shared_data.backup_storage.size
+    );
+    snapshot->backup_storage_dirty = atomic_load(&gba->shared_data.backup_storage.dirty);
+}
+
+/*
+** Restore the state saved in `snapshot`.
+**
+** The content of the backup storage is only restored if `backup_storage` is true, for callers
+** knowing it wasn't modified since the snapshot was taken.
+*/
+void
+snapshot_restore(
+    struct gba *gba,
+    struct snapshot const *snapshot,
+    bool backup_storage
+) {
+    struct rom_view rom;
+
+    gba->core = snapshot->core;
+    gba->io = snapshot->io;
+    gba->ppu = snapshot->ppu;
+    gba->apu = snapshot->apu;
+    gba->gpio = snapshot->gpio;
+
+    gba->scheduler.cycles = snapshot->cycles;
+    gba->scheduler.next_event = snapshot->next_event;
+    snapshot_copy_events(&gba->scheduler.events, &gba->scheduler.events_size, snapshot->events, snapshot->events_size);
+
+    // The ROM view may have been replaced by a patched copy since (see `cheat_frame()`).
+    rom = gba->memory.rom;
+    memcpy((uint8_t *)&gba->memory + SNAPSHOT_MEMORY_OFFSET, snapshot->memory, SNAPSHOT_MEMORY_SIZE);
+    gba->memory.rom = rom;
+
+    if (backup_storage) {
+        hs_assert(gba->shared_data.backup_storage.size == snapshot->backup_storage_size);
+        memcpy(gba->shared_data.backup_storage.data, snapshot->backup_storage, snapshot->backup_storage_size);
+    }
+    atomic_store(&gba->shared_data.backup_storage.dirty, snapshot->backup_storage_dirty);
+
+    // The waitstates and the variant of `core_run()` are derived from WAITCNT, which may differ.
+    mem_update_waitstates(gba);
+    core_select_variant(gba);
+}
+
+/*
+** Copy the state of `src` to `dst`, without going through a snapshot.
+**
+** `dst` must have been given the same BIOS as `src`. Its backup storage is reallocated if its size differs.
+*/
+void
+snapshot_clone(
+    struct gba *dst,
+    struct gba const *src
+) {
+    dst->core = src->core;
+    dst->io = src->io;
+    dst->ppu = src->ppu;
+    dst->apu = src->apu;
+    dst->gpio = src->gpio;
+
+    dst->scheduler.cycles = src->scheduler.cycles;
+    dst->scheduler.next_event = src->scheduler.next_event;
+    snapshot_copy_events(&dst->scheduler.events, &dst->scheduler.events_size, src->scheduler.events, src->scheduler.events_size);
+
+    memcpy((uint8_t *)&dst->memory + SNAPSHOT_MEMORY_OFFSET, (uint8_t const *)&src->memory + SNAPSHOT_MEMORY_OFFSET, SNAPSHOT_MEMORY_SIZE);
+
+    snapshot_copy(
+        (void **)&dst->shared_data.backup_storage.data,
+        &dst->shared_data.backup_storage.size,
+        src->shared_data.backup_storage.data,
+        src->shared_data.backup_storage.size
+    );
+
+    core_select_variant(dst);
+}
@@ -0,0 +1,503 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gba/gba.h"
+#include "gba/venv.h"
+
+struct venv {
+    // All the instances, in a single allocation.
+    struct gba *envs;
+    uint32_t len;
+
+    struct venv_config config;
+    size_t obs_size;
+
+    // The state every environment starts from, and the matching observation.
+    struct snapshot *initial;
+    uint8_t *initial_obs;
+
+    uint64_t *episode_frames;
+
+    // The step being run by the thread pool.
+    struct {
+        uint32_t const *actions;
+        uint32_t frames;
+        uint8_t *obs;
+        bool *dones;
+        bool reset;
+    } job;
+
+    struct {
+        pthread_t *threads;
+        uint32_t len;
+
+        pthread_mutex_t lock;
+        pthread_cond_t start;
+        pthread_cond_t done;
+
+        uint64_t generation;        // Incremented for each job.
+        uint32_t running;           // Threads still working on the current job.
+        bool exit;
+
+        atomic_uint next;           // Next environment to step.
+    } pool;
+};
+
+/*
+** Run the given instance until it publishes a new frame.
+*/
+static
+void
+venv_run_frame(
+    struct gba *gba
+) {
+    atomic_store(&gba->shared_data.framebuffer.dirty, false);
+
+    while (!atomic_load(&gba->shared_data.framebuffer.dirty)) {
+        uint64_t cycles;
+
+        cycles = gba->scheduler.cycles;
+        sched_run_for(gba, GBA_CYCLES_PER_PIXEL * GBA_SCREEN_REAL_WIDTH);
+
+        // The CPU is stopped and waits for a key press.
+        if (gba->scheduler.cycles == cycles) {
+            break;
+        }
+    }
+}
+
+/*
+** Write the observation of the given instance to `obs`.
+*/
+static
+void
+venv_observe(
+    struct venv const *venv,
+    struct gba *gba,
+    uint8_t *obs
+) {
+    uint32_t downscale;
+    uint32_t area;
+    size_t i;
+
+    downscale = venv->config.downscale;
+    area = downscale * downscale;
+
+    if (venv->config.frame_format != VENV_FRAME_NONE) {
+        uint16_t const *fb;
+        uint32_t y;
+
+        fb = gba->shared_data.framebuffer.data;
+        for (y = 0; y < GBA_SCREEN_HEIGHT; y += downscale) {
+            uint32_t x;
+
+            for (x = 0; x < GBA_SCREEN_WIDTH; x += downscale) {
+                uint32_t r;
+                uint32_t g;
+                uint32_t b;
+                uint32_t j;
+
+                // Average the block of pixels, each component going from 5 to 8 bits.
+                r = 0;
+                g = 0;
+                b = 0;
+                for (j = 0; j < area; ++j) {
+                    uint16_t c;
+
+                    c = fb[(y + j / downscale) * GBA_SCREEN_WIDTH + x + j % downscale];
+                    r += (c >> 0) & 0x1F;
+                    g += (c >> 5) & 0x1F;
+                    b += (c >> 10) & 0x1F;
+                }
+                r = r * 255 / (31 * area);
+                g = g * 255 / (31 * area);
+                b = b * 255 / (31 * area);
+
+                if (venv->config.frame_format == VENV_FRAME_GRAY8) {
+                    *obs++ = (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+                } else {
+                    *obs++ = (uint8_t)r;
+                    *obs++ = (uint8_t)g;
+                    *obs++ = (uint8_t)b;
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < venv->config.ram_len; ++i) {
+        *obs++ = mem_read8_raw(gba, venv->config.ram[i]);
+    }
+}
+
+/*
+** Bring the given environment back to its initial state.
+*/
+static
+void
+venv_reset_env(
+    struct venv *venv,
+    uint32_t idx,
+    uint8_t *obs
+) {
+    snapshot_restore(&venv->envs[idx], venv->initial, true);
+    venv->episode_frames[idx] = 0;
+
+    if (obs) {
+        memcpy(obs, venv->initial_obs, venv->obs_size);
+    }
+}
+
+static
+void
+venv_step_env(
+    struct venv *venv,
+    uint32_t idx
+) {
+    struct gba *gba;
+    uint8_t *obs;
+    bool done;
+    uint32_t i;
+
+    gba = &venv->envs[idx];
+    obs = venv->job.obs ? venv->job.obs + idx * venv->obs_size : NULL;
+
+    if (venv->job.reset) {
+        venv_reset_env(venv, idx, obs);
+        return;
+    }
+
+    gba_set_keys(gba, (1u << KEY_MAX) - 1, venv->job.actions[idx]);
+
+    for (i = 0; i < venv->job.frames; ++i) {
+        venv_run_frame(gba);
+    }
+
+    venv->episode_frames[idx] += venv->job.frames;
+    done = (venv->config.episode_frames && venv->episode_frames[idx] >= venv->config.episode_frames)
+        || (venv->config.done && venv->config.done(venv->config.arg, gba, idx))
+    ;
+
+    if (done) {
+        venv_reset_env(venv, idx, obs);
+    } else if (obs) {
+        venv_observe(venv, gba, obs);
+    }
+
+    if (venv->job.dones) {
+        venv->job.dones[idx] = done;
+    }
+}
+
+/*
+** Step environments until there's none left in the current job.
+*/
+static
+void
+venv_work(
+    struct venv *venv
+) {
+    uint32_t idx;
+
+    while ((idx = atomic_fetch_add(&venv->pool.next, 1)) < venv->len) {
+        venv_step_env(venv, idx);
+    }
+}
+
+static
+void *
+venv_worker(
+    void *arg
+) {
+    struct venv *venv;
+    uint64_t generation;
+
+    venv = arg;
+    generation = 0;
+
+    pthread_mutex_lock(&venv->pool.lock);
+    while (true) {
+        while (!venv->pool.exit && venv->pool.generation == generation) {
+            pthread_cond_wait(&venv->pool.start, &venv->pool.lock);
+        }
+
+        if (venv->pool.exit) {
+            break;
+        }
+
+        generation = venv->pool.generation;
+        pthread_mutex_unlock(&venv->pool.lock);
+
+        venv_work(venv);
+
+        pthread_mutex_lock(&venv->pool.lock);
+        if (!--venv->pool.running) {
+            pthread_cond_signal(&venv->pool.done);
+        }
+    }
+    pthread_mutex_unlock(&venv->pool.lock);
+
+    return (NULL);
+}
+
+/*
+** Run the job described by `venv->job` on all the environments and wait for its completion.
+** The calling thread takes part in the work.
+*/
+static
+void
+venv_run_job(
+    struct venv *venv
+) {
+    atomic_store(&venv->pool.next, 0);
+
+    pthread_mutex_lock(&venv->pool.lock);
+    venv->pool.running = venv->pool.len;
+    ++venv->pool.generation;
+    pthread_cond_broadcast(&venv->pool.start);
+    pthread_mutex_unlock(&venv->pool.lock);
+
+    venv_work(venv);
+
+    pthread_mutex_lock(&venv->pool.lock);
+    while (venv->pool.running) {
+        pthread_cond_wait(&venv->pool.done, &venv->pool.lock);
+    }
+    pthread_mutex_unlock(&venv->pool.lock);
+}
+
+/*
+** Create `config->len` environments running the game described by `launch`.
+**
+** The backup storage, digest, capture, run-ahead and speed settings of `launch` are ignored: each
+** environment has its own backup storage in memory and runs as fast as possible.
+**
+** Return NULL if the configuration is invalid.
+*/
+struct venv *
+venv_create(
+    struct launch_config const *launch,
+    struct venv_config const *config
+) {
+    struct launch_config env_launch;
+    struct venv *venv;
+    size_t frame_size;
+    uint32_t threads;
+    uint32_t i;
+
+    if (
+           !config->len
+        || (config->frame_format != VENV_FRAME_NONE && (
+               !config->downscale
+            || config->downscale > 8
+            || GBA_SCREEN_WIDTH % config->downscale
+            || GBA_SCREEN_HEIGHT % config->downscale
+        ))
+    ) {
+        logln(HS_ERROR, "Invalid vector environment configuration.");
+        return (NULL);
+    }
+
+    venv = calloc(1, sizeof(struct venv));
+    hs_assert(venv);
+
+    venv->len = config->len;
+    venv->config = *config;
+
+    if (config->ram_len) {
+        uint32_t *ram;
+
+        ram = calloc(config->ram_len, sizeof(uint32_t));
+        hs_assert(ram);
+        memcpy(ram, config->ram, config->ram_len * sizeof(uint32_t));
+        venv->config.ram = ram;
+    }
+
+    frame_size = 0;
+    if (config->frame_format != VENV_FRAME_NONE) {
+        frame_size = (GBA_SCREEN_WIDTH / config->downscale) * (GBA_SCREEN_HEIGHT / config->downscale);
+        frame_size *= (config->frame_format == VENV_FRAME_RGB24) ? 3 : 1;
+    }
+    venv->obs_size = frame_size + config->ram_len;
+
+    env_launch = *launch;
+    env_launch.backup_storage.data = NULL;
+    env_launch.backup_storage.fd = -1;
+    memset(&env_launch.backup_storage.persist, 0, sizeof(env_launch.backup_storage.persist));
+    memset(&env_launch.digest, 0, sizeof(env_launch.digest));
+    env_launch.capture.video_fd = -1;
+    env_launch.capture.audio_fd = -1;
+    env_launch.settings.fast_forward = true;
+    env_launch.settings.run_ahead.frames = 0;
+    env_launch.settings.enable_frame_skipping = false;
+
+    // Without frames in the observations, skip the rendering of (almost) all of them.
+    if (config->frame_format == VENV_FRAME_NONE) {
+        env_launch.settings.enable_frame_skipping = true;
+        env_launch.settings.adaptive_frame_skipping = false;
+        env_launch.settings.frame_skip_counter = UINT32_MAX;
+    }
+
+    venv->envs = calloc(venv->len, sizeof(struct gba));
+    venv->episode_frames = calloc(venv->len, sizeof(uint64_t));
+    venv->initial_obs = calloc(1, venv->obs_size ? venv->obs_size : 1);
+    hs_assert(venv->envs && venv->episode_frames && venv->initial_obs);
+
+    for (i = 0; i < venv->len; ++i) {
+        struct gba *gba;
+
+        gba = &venv->envs[i];
+        gba_init(gba);
+        gba_state_reset(gba, &env_launch);
+
+        // Nobody reads the notifications of these instances.
+        channel_lock(&gba->channels.notifications);
+        channel_clear(&gba->channels.notifications);
+        channel_release(&gba->channels.notifications);
+#ifdef WITH_DEBUGGER
+        channel_lock(&gba->channels.debug);
+        channel_clear(&gba->channels.debug);
+        channel_release(&gba->channels.debug);
+#endif
+    }
+
+    venv->initial = snapshot_create();
+    snapshot_save(&venv->envs[0], venv->initial);
+    venv_observe(venv, &venv->envs[0], venv->initial_obs);
+
+    // Thread pool
+    threads = config->threads;
+    if (!threads) {
+        long cpus;
+
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+    threads = min(threads, venv->len);
+
+    pthread_mutex_init(&venv->pool.lock, NULL);
+    pthread_cond_init(&venv->pool.start, NULL);
+    pthread_cond_init(&venv->pool.done, NULL);
+
+    venv->pool.len = threads - 1;
+    venv->pool.threads = calloc(venv->pool.len ? venv->pool.len : 1, sizeof(pthread_t));
+    hs_assert(venv->pool.threads);
+
+    for (i = 0; i < venv->pool.len; ++i) {
+        hs_assert(!pthread_create(&venv->pool.threads[i], NULL, venv_worker, venv));
+    }
+
+    return (venv);
+}
+
+void
+venv_delete(
+    struct venv *venv
+) {
+    uint32_t i;
+
+    if (!venv) {
+        return;
+    }
+
+    pthread_mutex_lock(&venv->pool.lock);
+    venv->pool.exit = true;
+    pthread_cond_broadcast(&venv->pool.start);
+    pthread_mutex_unlock(&venv->pool.lock);
+
+    for (i = 0; i < venv->pool.len; ++i) {
+        pthread_join(venv->pool.threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&venv->pool.lock);
+    pthread_cond_destroy(&venv->pool.start);
+    pthread_cond_destroy(&venv->pool.done);
+
+    for (i = 0; i < venv->len; ++i) {
+        gba_release(&venv->envs[i]);
+    }
+
+    snapshot_delete(venv->initial);
+    free((void *)venv->config.ram);
+    free(venv->pool.threads);
+    free(venv->initial_obs);
+    free(venv->episode_frames);
+    free(venv->envs);
+    free(venv);
+}
+
+/*
+** Size of the observation of one environment, in bytes.
+** The observations passed to `venv_step()` and `venv_reset()` are `len` times this size.
+*/
+size_t
+venv_observation_size(
+    struct venv const *venv
+) {
+    return (venv->obs_size);
+}
+
+/*
+** Return the instance behind the given environment, e.g. to read more of its state
+** between two steps.
+*/
+struct gba *
+venv_env(
+    struct venv *venv,
+    uint32_t idx
+) {
+    hs_assert(idx < venv->len);
+    return (&venv->envs[idx]);
+}
+
+/*
+** Bring all the environments back to their initial state, writing their observation to
+** `obs` if it isn't NULL.
+*/
+void
+venv_reset(
+    struct venv *venv,
+    uint8_t *obs
+) {
+    memset(&venv->job, 0, sizeof(venv->job));
+    venv->job.obs = obs;
+    venv->job.reset = true;
+    venv_run_job(venv);
+}
+
+/*
+** Hold the keys in `actions[i]` (bit `n` stands for key `n` of `enum keys`) and run `frames`
+** frames on each environment `i`, then write its observation to `obs` and whether its
+** episode ended to `dones`. Both can be NULL.
+**
+** Environments whose episode ended are reset, and their observation is the initial one.
+*/
+void
+venv_step(
+    struct venv *venv,
+    uint32_t const *actions,
+    uint32_t frames,
+    uint8_t *obs,
+    bool *dones
+) {
+    venv->job.actions = actions;
+    venv->job.frames = frames;
+    venv->job.obs = obs;
+    venv->job.dones = dones;
+    venv->job.reset = false;
+    venv_run_job(venv);
+}
@@ -0,0 +1,274 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+static struct {
+    uint32_t start;
+    uint32_t size;
+    size_t offset;
+} const watch_regions[] = {
+    { EWRAM_START,  EWRAM_SIZE,     offsetof(struct memory, ewram) },
+    { IWRAM_START,  IWRAM_SIZE,     offsetof(struct memory, iwram) },
+    { PALRAM_START, PALRAM_SIZE,    offsetof(struct memory, palram) },
+    { VRAM_START,   VRAM_SIZE,      offsetof(struct memory, vram) },
+    { OAM_START,    OAM_SIZE,       offsetof(struct memory, oam) },
+};
+
+/*
+** Return the offset in `struct memory` of the given range, or -1 if it isn't entirely
+** contained in one of the watchable regions. Mirrors aren't accepted.
+*/
+static
+ssize_t
+watch_range_offset(
+    struct watch_range const *range
+) {
+    size_t i;
+
+    for (i = 0; i < array_length(watch_regions); ++i) {
+        if (
+               range->addr >= watch_regions[i].start
+            && range->addr - watch_regions[i].start < watch_regions[i].size
+            && range->size <= watch_regions[i].size - (range->addr - watch_regions[i].start)
+        ) {
+            return (watch_regions[i].offset + (range->addr - watch_regions[i].start));
+        }
+    }
+    return (-1);
+}
+
+/*
+** Copy the watch list to the given buffer and lay out its content.
+**
+** The watch's lock must be held.
+*/
+static
+void
+watch_buffer_prepare(
+    struct memory_watch const *watch,
+    struct watch_buffer *buffer
+) {
+    size_t size;
+    size_t i;
+
+    buffer->ranges = realloc(buffer->ranges, watch->len * sizeof(*buffer->ranges));
+    buffer->offsets = realloc(buffer->offsets, watch->len * sizeof(*buffer->offsets));
+    hs_assert(!watch->len || (buffer->ranges && buffer->offsets));
+
+    size = 0;
+    for (i = 0; i < watch->len; ++i) {
+        buffer->ranges[i] = watch->ranges[i];
+        buffer->offsets[i] = size;
+        size += watch->ranges[i].size;
+    }
+
+    buffer->data = realloc(buffer->data, size ? size : 1);
+    hs_assert(buffer->data);
+
+    buffer->len = watch->len;
+    buffer->size = size;
+    buffer->generation = watch->generation;
+}
+
+/*
+** Replace the watch list. An empty list stops the gathering.
+**
+** The views acquired before remain valid until the next call to `watch_acquire()`.
+** Return false, leaving the watch list untouched, if a range isn't entirely within EWRAM,
+** IWRAM, PALRAM, VRAM or OAM.
+*/
+bool
+watch_set(
+    struct gba *gba,
+    struct watch_range const *ranges,
+    size_t len
+) {
+    struct memory_watch *watch;
+    struct watch_range *copy;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        if (!ranges[i].size || watch_range_offset(&ranges[i]) < 0) {
+            logln(HS_ERROR, "Invalid watch range 0x%08x-0x%08x.", ranges[i].addr, ranges[i].addr + ranges[i].size);
+            return (false);
+        }
+    }
+
+    copy = NULL;
+    if (len) {
+        copy = malloc(len * sizeof(*copy));
+        hs_assert(copy);
+        memcpy(copy, ranges, len * sizeof(*copy));
+    }
+
+    watch = &gba->shared_data.watch;
+
+    pthread_mutex_lock(&watch->lock);
+    free(watch->ranges);
+    watch->ranges = copy;
+    watch->len = len;
+    ++watch->generation;
+    watch->frame = 0;
+    watch->fresh = false;
+    atomic_store(&watch->enabled, len > 0);
+    pthread_mutex_unlock(&watch->lock);
+
+    return (true);
+}
+
+/*
+** Fill `view` with the latest content gathered by the emulator.
+**
+** The view remains valid until the next call to this function, which must always be made
+** from the same thread. Return true if it's a new frame since the previous call.
+*/
+bool
+watch_acquire(
+    struct gba *gba,
+    struct watch_view *view
+) {
+    struct memory_watch *watch;
+    struct watch_buffer const *buffer;
+    bool fresh;
+
+    watch = &gba->shared_data.watch;
+
+    pthread_mutex_lock(&watch->lock);
+    fresh = watch->fresh;
+    if (fresh) {
+        uint32_t tmp;
+
+        tmp = watch->front;
+        watch->front = watch->ready;
+        watch->ready = tmp;
+        watch->fresh = false;
+    }
+    pthread_mutex_unlock(&watch->lock);
+
+    buffer = &watch->buffers[watch->front];
+    view->frame = buffer->frame;
+    view->ranges = buffer->ranges;
+    view->offsets = buffer->offsets;
+    view->len = buffer->len;
+    view->data = buffer->data;
+    view->size = buffer->size;
+
+    return (fresh);
+}
+
+/*
+** Return a pointer to the content of `[addr; addr + size)` in the given view, or NULL if
+** it isn't entirely within one of the watched ranges.
+*/
+void const *
+watch_view_ptr(
+    struct watch_view const *view,
+    uint32_t addr,
+    uint32_t size
+) {
+    size_t i;
+
+    for (i = 0; i < view->len; ++i) {
+        struct watch_range const *range;
+
+        range = &view->ranges[i];
+        if (addr >= range->addr && addr - range->addr < range->size && size <= range->size - (addr - range->addr)) {
+            return (view->data + view->offsets[i] + (addr - range->addr));
+        }
+    }
+    return (NULL);
+}
+
+void
+watch_init(
+    struct gba *gba
+) {
+    struct memory_watch *watch;
+
+    watch = &gba->shared_data.watch;
+    pthread_mutex_init(&watch->lock, NULL);
+    atomic_init(&watch->enabled, false);
+    watch->back = 0;
+    watch->ready = 1;
+    watch->front = 2;
+}
+
+void
+watch_release(
+    struct gba *gba
+) {
+    struct memory_watch *watch;
+    size_t i;
+
+    watch = &gba->shared_data.watch;
+    for (i = 0; i < array_length(watch->buffers); ++i) {
+        free(watch->buffers[i].ranges);
+        free(watch->buffers[i].offsets);
+        free(watch->buffers[i].data);
+    }
+    free(watch->ranges);
+    memset(watch->buffers, 0, sizeof(watch->buffers));
+    watch->ranges = NULL;
+    watch->len = 0;
+    atomic_store(&watch->enabled, false);
+}
+
+/*
+** Gather the watched ranges and make them available to `watch_acquire()`.
+**
+** Called at the start of each VBlank of the real timeline when `enabled` is set.
+*/
+void
+watch_gather(
+    struct gba *gba
+) {
+    struct memory_watch *watch;
+    struct watch_buffer *buffer;
+    size_t i;
+
+    watch = &gba->shared_data.watch;
+
+    pthread_mutex_lock(&watch->lock);
+    buffer = &watch->buffers[watch->back];
+    if (buffer->generation != watch->generation) {
+        watch_buffer_prepare(watch, buffer);
+    }
+    buffer->frame = ++watch->frame;
+    pthread_mutex_unlock(&watch->lock);
+
+    // The ranges were checked by `watch_set()`.
+    for (i = 0; i < buffer->len; ++i) {
+        memcpy(
+            buffer->data + buffer->offsets[i],
+            (uint8_t const *)&gba->memory + watch_range_offset(&buffer->ranges[i]),
+            buffer->ranges[i].size
+        );
+    }
+
+    pthread_mutex_lock(&watch->lock);
+
+    // Drop the frame if the watch list changed in the meantime.
+    if (buffer->generation == watch->generation) {
+        uint32_t tmp;
+
+        tmp = watch->back;
+        watch->back = watch->ready;
+        watch->ready = tmp;
+        watch->fresh = true;
+    }
+    pthread_mutex_unlock(&watch->lock);
+}
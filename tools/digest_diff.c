@@ -0,0 +1,138 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+/*
+** Compare two state digest logs and report the first frame where they diverge.
+**
+** Usage: digest_diff <expected.log> <actual.log>
+**
+** Exits with 0 if both logs are identical, 1 if they diverge and 2 if one of them
+** can't be read.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gba/digest.h"
+
+#define EXIT_DIVERGE        1
+#define EXIT_INVALID        2
+
+static FILE *
+open_log(
+    char const *path
+) {
+    struct digest_log_header header;
+    FILE *file;
+
+    file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "digest_diff: %s: can't open the file.\n", path);
+        exit(EXIT_INVALID);
+    }
+
+    if (
+           fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, DIGEST_MAGIC, sizeof(header.magic))
+    ) {
+        fprintf(stderr, "digest_diff: %s: not a digest log.\n", path);
+        exit(EXIT_INVALID);
+    }
+
+    if (
+           header.version != DIGEST_VERSION
+        || header.components != DIGEST_COMPONENT_LEN
+        || header.record_size != sizeof(struct digest_record)
+    ) {
+        fprintf(stderr, "digest_diff: %s: unsupported digest log (version %" PRIu32 ").\n", path, header.version);
+        exit(EXIT_INVALID);
+    }
+
+    return (file);
+}
+
+int
+main(
+    int argc,
+    char *argv[]
+) {
+    struct digest_record expected;
+    struct digest_record actual;
+    FILE *expected_file;
+    FILE *actual_file;
+    uint64_t frames;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <expected.log> <actual.log>\n", argv[0]);
+        return (EXIT_INVALID);
+    }
+
+    expected_file = open_log(argv[1]);
+    actual_file = open_log(argv[2]);
+
+    frames = 0;
+    while (true) {
+        bool has_expected;
+        bool has_actual;
+        size_t i;
+
+        has_expected = fread(&expected, sizeof(expected), 1, expected_file) == 1;
+        has_actual = fread(&actual, sizeof(actual), 1, actual_file) == 1;
+
+        if (!has_expected && !has_actual) {
+            break;
+        }
+
+        if (has_expected != has_actual) {
+            printf(
+                "Logs have a different length: %s stops after %" PRIu64 " frames.\n",
+                has_expected ? argv[2] : argv[1],
+                frames
+            );
+            return (EXIT_DIVERGE);
+        }
+
+        if (!memcmp(&expected, &actual, sizeof(expected))) {
+            ++frames;
+            continue;
+        }
+
+        printf("First divergence at frame %" PRIu32 " (record %" PRIu64 ")\n", expected.frame, frames);
+        if (expected.frame != actual.frame) {
+            printf("  %-16s %" PRIu32 " != %" PRIu32 "\n", "frame", expected.frame, actual.frame);
+        }
+        if (expected.cycles != actual.cycles) {
+            printf("  %-16s %" PRIu64 " != %" PRIu64 "\n", "cycles", expected.cycles, actual.cycles);
+        }
+
+        // Components are listed in the order they are laid out in `enum digest_components`.
+        for (i = 0; i < DIGEST_COMPONENT_LEN; ++i) {
+            if (expected.hashes[i] != actual.hashes[i]) {
+                printf(
+                    "  %-16s %016" PRIx64 " != %016" PRIx64 "\n",
+                    digest_component_names[i],
+                    expected.hashes[i],
+                    actual.hashes[i]
+                );
+            }
+        }
+        return (EXIT_DIVERGE);
+    }
+
+    printf("Logs are identical (%" PRIu64 " frames).\n", frames);
+
+    fclose(expected_file);
+    fclose(actual_file);
+    return (EXIT_SUCCESS);
+}
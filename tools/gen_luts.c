@@ -0,0 +1,250 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+/*
+** Build-time generator of the ARM/Thumb decoding lookup tables.
+**
+** This program runs on the host while building the emulator. It decodes the
+** masks listed in `src/core/{arm,thumb}/insns.h`, checks that no two
+** instructions collide, and prints on its standard output a C file defining
+** `arm_lut`, `cond_lut` and `thumb_lut` as constant tables.
+**
+** It doesn't depend on the rest of the emulator on purpose: it must be
+** buildable with the host's compiler even when cross-compiling the library.
+*/
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define array_length(array)     (sizeof(array) / sizeof(*(array)))
+
+#define ARM_LUT_SIZE            4096
+#define COND_LUT_SIZE           256
+#define THUMB_LUT_SIZE          256
+
+struct insn {
+    char const *name;
+    char const *mask;
+    char const *op;
+};
+
+struct decoded_insn {
+    uint32_t mask;
+    uint32_t value;
+};
+
+static struct insn const arm_insns[] = {
+#define ARM_INSN(name, mask, op)    { (name), (mask), #op },
+#include "../src/core/arm/insns.h"
+#undef ARM_INSN
+};
+
+static struct insn const thumb_insns[] = {
+#define THUMB_INSN(name, mask, op)  { (name), (mask), #op },
+#include "../src/core/thumb/insns.h"
+#undef THUMB_INSN
+};
+
+static void
+die(
+    char const *fmt,
+    ...
+) {
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stderr, "gen_luts: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
+
+/*
+** Decode the user-friendly string masks of `insns` into `decoded`, and ensure
+** no two instructions can match the same op-code.
+*/
+static void
+decode_insns(
+    struct insn const *insns,
+    struct decoded_insn *decoded,
+    size_t len,
+    size_t bits
+) {
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        char const *c;
+        size_t k;
+        size_t j;
+
+        decoded[i].mask = 0;
+        decoded[i].value = 0;
+
+        k = 0; // Counter of non-separator characters of the mask
+        for (c = insns[i].mask; *c; ++c) {
+            if (*c == '_') { // Skip separators
+                continue;
+            }
+
+            decoded[i].mask <<= 1;
+            decoded[i].value <<= 1;
+
+            if (*c == '0' || *c == '1') {
+                decoded[i].mask |= 1;
+                decoded[i].value |= (uint32_t)(*c - '0');
+            }
+            ++k;
+        }
+
+        if (k != bits) {
+            die("instruction \"%s\" doesn't have a length of %zu bits.", insns[i].name, bits);
+        }
+
+        /*
+        ** Ensure we don't have a collision with an existing instruction.
+        **
+        ** To do that, we must verify that there's at least one difference between
+        ** the instruction we want to add and all other instructions.
+        **
+        ** By difference, we mean at least one bit in common in the mask of both
+        ** instructions that maps to different values.
+        */
+        for (j = 0; j < i; ++j) {
+            if (!(((decoded[i].value ^ decoded[j].value) & decoded[i].mask) & decoded[j].mask)) {
+                die("instruction \"%s\" collides with \"%s\".", insns[i].name, insns[j].name);
+            }
+        }
+    }
+}
+
+/*
+** Find the instruction matching `op` once restricted to the bits in `lut_mask`.
+**
+** Several matches means the LUT is too small and ambiguous.
+*/
+static char const *
+lookup(
+    struct insn const *insns,
+    struct decoded_insn const *decoded,
+    size_t len,
+    uint32_t op,
+    uint32_t lut_mask
+) {
+    char const *match;
+    size_t j;
+
+    match = NULL;
+    for (j = 0; j < len; ++j) {
+        if ((op & decoded[j].mask & lut_mask) == (decoded[j].value & lut_mask)) {
+            if (match) {
+                die("op-codes matching \"%s\" also match \"%s\", the LUT is ambiguous.", insns[j].name, match);
+            }
+            match = insns[j].op;
+        }
+    }
+    return (match);
+}
+
+static bool
+eval_cond(
+    uint32_t i
+) {
+    bool o;
+    bool c;
+    bool z;
+    bool n;
+
+    o = (i >> 4) & 1;
+    c = (i >> 5) & 1;
+    z = (i >> 6) & 1;
+    n = (i >> 7) & 1;
+
+    switch (i & 0xF) {
+        case 0x0: return (z);                   // EQ
+        case 0x1: return (!z);                  // NE
+        case 0x2: return (c);                   // CS
+        case 0x3: return (!c);                  // CC
+        case 0x4: return (n);                   // MI
+        case 0x5: return (!n);                  // PL
+        case 0x6: return (o);                   // VS
+        case 0x7: return (!o);                  // VC
+        case 0x8: return (c && !z);             // HI
+        case 0x9: return (!c || z);             // LS
+        case 0xA: return (n == o);              // GE
+        case 0xB: return (n != o);              // LT
+        case 0xC: return (!z && (n == o));      // GT
+        case 0xD: return (z || (n != o));       // LE
+        case 0xE: return (true);                // AL
+        default:  return (false);
+    }
+}
+
+int
+main(
+    void
+) {
+    struct decoded_insn arm_decoded[array_length(arm_insns)];
+    struct decoded_insn thumb_decoded[array_length(thumb_insns)];
+    uint32_t i;
+
+    decode_insns(arm_insns, arm_decoded, array_length(arm_insns), 32);
+    decode_insns(thumb_insns, thumb_decoded, array_length(thumb_insns), 16);
+
+    printf("/*\n** This file was generated by tools/gen_luts.c, do not edit it manually.\n*/\n\n");
+    printf("#include \"gba/gba.h\"\n");
+    printf("#include \"gba/core/arm.h\"\n");
+    printf("#include \"gba/core/thumb.h\"\n\n");
+
+    /*
+    ** The ARM LUT is indexed by bits 20-27 and 4-7 of the op-code.
+    */
+    printf("void (* const arm_lut[%u])(struct gba *gba, uint32_t op) = {\n", ARM_LUT_SIZE);
+    for (i = 0; i < ARM_LUT_SIZE; ++i) {
+        char const *op;
+
+        op = lookup(arm_insns, arm_decoded, array_length(arm_insns), ((i & 0xFF0) << 16) | ((i & 0xF) << 4), 0x0FF000F0);
+        if (op) {
+            printf("    [0x%03x] = %s,\n", i, op);
+        }
+    }
+    printf("};\n\n");
+
+    /*
+    ** The condition LUT is indexed by the NZCV flags (bits 4-7) and the condition of the instruction (bits 0-3).
+    */
+    printf("bool const cond_lut[%u] = {\n", COND_LUT_SIZE);
+    for (i = 0; i < COND_LUT_SIZE; ++i) {
+        printf("%s%u,%s", (i % 16) ? " " : "    ", eval_cond(i), (i % 16 == 15) ? "\n" : "");
+    }
+    printf("};\n\n");
+
+    /*
+    ** The Thumb LUT is indexed by the 8 upper bits of the op-code.
+    */
+    printf("void (* const thumb_lut[%u])(struct gba *gba, uint16_t op) = {\n", THUMB_LUT_SIZE);
+    for (i = 0; i < THUMB_LUT_SIZE; ++i) {
+        char const *op;
+
+        op = lookup(thumb_insns, thumb_decoded, array_length(thumb_insns), i << 8, 0xFF00);
+        if (op) {
+            printf("    [0x%02x] = %s,\n", i, op);
+        }
+    }
+    printf("};\n");
+
+    return (EXIT_SUCCESS);
+}
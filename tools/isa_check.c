@@ -0,0 +1,331 @@
+/******************************************************************************\
+**
+**  This file is part of the Hades GBA Emulator, and is made available under
+**  the terms of the GNU General Public License version 2.
+**
+**  Copyright (C) 2021-2024 - The Hades Authors
+**
+\******************************************************************************/
+/*
+** Modifications by Korbin Deary (kdeary).
+** Licensed under the same terms as the Hades emulator (GNU GPLv2).
+*/
+
+/*
+** Cross-check the SIMD kernels supported by the host against the scalar ones (see include/gba/isa.h).
+**
+** Usage: isa_check [iterations]
+**
+** Each kernel is run on the same pseudo-random inputs, including unaligned buffers and
+** lengths that aren't a multiple of the vector width, and its output must be identical to
+** the scalar one. Exits with 0 if all of them agree and 1 otherwise.
+*/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gba/gba.h"
+
+#define EXIT_MISMATCH       1
+
+#define DEFAULT_ITERATIONS  2000
+
+// Largest buffer given to `run_length` and `search_filter`, in bytes.
+#define MAX_SIZE            (16 * ISA_SEARCH_CHUNK)
+
+// Largest buffer given to `hash64_batch`, in bytes: a digest page and a partial stripe.
+#define MAX_HASH_SIZE       (4096 + 31)
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+/*
+** xorshift64*, so the inputs are the same on every host.
+*/
+static
+uint64_t
+rng(
+    void
+) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (rng_state * 0x2545F4914F6CDD1Dull);
+}
+
+/*
+** Fill `data` with bytes that are mostly equal to a few values, so that both long runs
+** and every comparison result show up.
+*/
+static
+void
+fill_biased(
+    uint8_t *data,
+    size_t size
+) {
+    uint8_t base;
+    size_t i;
+
+    base = (uint8_t)rng();
+    for (i = 0; i < size; ++i) {
+        switch (rng() % 8) {
+            case 0:     data[i] = (uint8_t)rng(); break;
+            case 1:     data[i] = base + 1; break;
+            case 2:     data[i] = base - 1; break;
+            default:    data[i] = base; break;
+        }
+    }
+}
+
+static
+uint64_t
+check_scanline_to_rgb555(
+    struct isa_kernels const *kernels,
+    struct isa_kernels const *scalar,
+    uint64_t iterations
+) {
+    struct rich_color src[GBA_SCREEN_WIDTH + 1];
+    uint16_t expected[GBA_SCREEN_WIDTH + 1];
+    uint16_t actual[GBA_SCREEN_WIDTH + 1];
+    uint64_t mismatches;
+    uint64_t it;
+
+    mismatches = 0;
+    for (it = 0; it < iterations; ++it) {
+        size_t offset;
+        size_t len;
+        size_t i;
+
+        for (i = 0; i < sizeof(src); ++i) {
+            ((uint8_t *)src)[i] = (uint8_t)rng();
+        }
+
+        offset = rng() % 2;
+        len = rng() % (GBA_SCREEN_WIDTH + 1 - offset);
+
+        // Poison the destinations so that writing past `len` is caught too.
+        memset(expected, 0xA5, sizeof(expected));
+        memset(actual, 0xA5, sizeof(actual));
+
+        scalar->scanline_to_rgb555(expected + offset, src + offset, len);
+        kernels->scanline_to_rgb555(actual + offset, src + offset, len);
+
+        mismatches += !!memcmp(expected, actual, sizeof(expected));
+    }
+    return (mismatches);
+}
+
+static
+uint64_t
+check_run_length(
+    struct isa_kernels const *kernels,
+    struct isa_kernels const *scalar,
+    uint64_t iterations
+) {
+    uint8_t data[MAX_SIZE + 1];
+    uint64_t mismatches;
+    uint64_t it;
+
+    mismatches = 0;
+    for (it = 0; it < iterations; ++it) {
+        size_t offset;
+        size_t size;
+        size_t max;
+
+        fill_biased(data, sizeof(data));
+
+        // Make the run long enough to go through the vector loops.
+        memset(data, data[0], rng() % sizeof(data));
+
+        offset = rng() % 2;
+        size = 1 + rng() % (MAX_SIZE - 1);
+        max = 1 + rng() % (MAX_SIZE + 1);
+
+        mismatches += (kernels->run_length(data + offset, size, max) != scalar->run_length(data + offset, size, max));
+    }
+    return (mismatches);
+}
+
+static
+uint64_t
+check_search_filter(
+    struct isa_kernels const *kernels,
+    struct isa_kernels const *scalar,
+    uint64_t iterations,
+    size_t width,
+    enum isa_compare cmp
+) {
+    uint8_t cur[MAX_SIZE + 1];
+    uint8_t ref[MAX_SIZE + 1];
+    uint64_t bitmap[MAX_SIZE / 64];
+    uint64_t expected[MAX_SIZE / 64];
+    uint64_t actual[MAX_SIZE / 64];
+    uint64_t mismatches;
+    uint64_t it;
+
+    mismatches = 0;
+    for (it = 0; it < iterations; ++it) {
+        size_t ref_step;
+        size_t offset;
+        size_t size;
+        size_t i;
+
+        fill_biased(cur, sizeof(cur));
+        memcpy(ref, cur, sizeof(ref));
+        for (i = 0; i < sizeof(ref); ++i) {
+            if (!(rng() % 4)) {
+                ref[i] = (uint8_t)rng();
+            }
+        }
+
+        // Some elements are already filtered out, and some whole chunks too.
+        for (i = 0; i < array_length(bitmap); ++i) {
+            bitmap[i] = (rng() % 4) ? (rng() | rng()) : 0;
+        }
+
+        ref_step = (rng() % 2) ? ISA_SEARCH_CHUNK : 0;
+        offset = rng() % 2;
+        size = ISA_SEARCH_CHUNK * (1 + rng() % (MAX_SIZE / ISA_SEARCH_CHUNK));
+
+        memcpy(expected, bitmap, sizeof(bitmap));
+        memcpy(actual, bitmap, sizeof(bitmap));
+
+        scalar->search_filter(expected, cur + offset, ref + offset, ref_step, size, width, cmp);
+        kernels->search_filter(actual, cur + offset, ref + offset, ref_step, size, width, cmp);
+
+        mismatches += !!memcmp(expected, actual, sizeof(expected));
+    }
+    return (mismatches);
+}
+
+static
+uint64_t
+check_hash64_batch(
+    struct isa_kernels const *kernels,
+    struct isa_kernels const *scalar,
+    uint64_t iterations
+) {
+    static uint8_t pool[2 * MAX_HASH_SIZE];
+    uint8_t const *data[ISA_HASH_BATCH];
+    uint64_t expected[ISA_HASH_BATCH + 1];
+    uint64_t actual[ISA_HASH_BATCH + 1];
+    uint64_t seeds[ISA_HASH_BATCH];
+    uint64_t mismatches;
+    uint64_t it;
+
+    mismatches = 0;
+    for (it = 0; it < iterations; ++it) {
+        size_t count;
+        size_t size;
+        size_t i;
+
+        for (i = 0; i < sizeof(pool); ++i) {
+            pool[i] = (uint8_t)rng();
+        }
+
+        // Half of the sizes skip the stripes entirely or barely go through them.
+        count = 1 + rng() % ISA_HASH_BATCH;
+        size = (rng() % 2) ? rng() % 100 : rng() % (MAX_HASH_SIZE + 1);
+
+        // Buffers may overlap and aren't aligned.
+        for (i = 0; i < count; ++i) {
+            data[i] = pool + rng() % (sizeof(pool) - size + 1);
+            seeds[i] = (rng() % 2) ? rng() : i;
+        }
+
+        // Poison the destinations so that writing past `count` is caught too.
+        memset(expected, 0xA5, sizeof(expected));
+        memset(actual, 0xA5, sizeof(actual));
+
+        scalar->hash64_batch(expected, data, seeds, count, size);
+        kernels->hash64_batch(actual, data, seeds, count, size);
+
+        mismatches += !!memcmp(expected, actual, sizeof(expected));
+    }
+    return (mismatches);
+}
+
+static
+bool
+report(
+    enum isa_levels level,
+    char const *kernel,
+    uint64_t mismatches,
+    uint64_t iterations
+) {
+    printf("%-8s %-32s %s", isa_names[level], kernel, mismatches ? "MISMATCH" : "ok");
+    if (mismatches) {
+        printf(" (%" PRIu64 "/%" PRIu64 ")", mismatches, iterations);
+    }
+    printf("\n");
+    return (!mismatches);
+}
+
+int
+main(
+    int argc,
+    char *argv[]
+) {
+    static char const * const cmp_names[] = {
+        [ISA_CMP_EQ] = "eq",
+        [ISA_CMP_NE] = "ne",
+        [ISA_CMP_GT] = "gt",
+        [ISA_CMP_LT] = "lt",
+    };
+    static size_t const widths[] = { 1, 2, 4 };
+    struct isa_kernels const *scalar;
+    enum isa_levels level;
+    uint64_t iterations;
+    bool ok;
+
+    iterations = (argc > 1) ? strtoull(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    if (!iterations) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return (EXIT_FAILURE);
+    }
+
+    scalar = isa_level_kernels(ISA_SCALAR);
+    ok = true;
+
+    for (level = ISA_SCALAR + 1; level < ISA_LEN; ++level) {
+        struct isa_kernels const *kernels;
+        size_t w;
+        size_t c;
+
+        kernels = isa_level_kernels(level);
+        if (!kernels) {
+            printf("%-8s not supported by this host or build, skipped\n", isa_names[level]);
+            continue;
+        }
+
+        if (kernels->scanline_to_rgb555) {
+            ok &= report(level, "scanline_to_rgb555", check_scanline_to_rgb555(kernels, scalar, iterations), iterations);
+        }
+
+        if (kernels->run_length) {
+            ok &= report(level, "run_length", check_run_length(kernels, scalar, iterations), iterations);
+        }
+
+        if (kernels->hash64_batch) {
+            ok &= report(level, "hash64_batch", check_hash64_batch(kernels, scalar, iterations), iterations);
+        }
+
+        if (kernels->search_filter) {
+            for (w = 0; w < array_length(widths); ++w) {
+                for (c = 0; c < array_length(cmp_names); ++c) {
+                    char name[32];
+
+                    snprintf(name, sizeof(name), "search_filter (width %zu, %s)", widths[w], cmp_names[c]);
+                    ok &= report(
+                        level,
+                        name,
+                        check_search_filter(kernels, scalar, iterations, widths[w], (enum isa_compare)c),
+                        iterations
+                    );
+                }
+            }
+        }
+    }
+
+    return (ok ? EXIT_SUCCESS : EXIT_MISMATCH);
+}